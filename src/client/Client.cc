@@ -44,6 +44,7 @@ using namespace std;
 #include "messages/MClientReply.h"
 #include "messages/MClientCaps.h"
 #include "messages/MClientCapRelease.h"
+#include "messages/MClientCapsBatch.h"
 #include "messages/MClientLease.h"
 #include "messages/MClientSnap.h"
 
@@ -112,7 +113,7 @@ dir_result_t::dir_result_t(Inode *in)
 Client::Client(Messenger *m, MonClient *mc)
   : Dispatcher(m->cct), cct(m->cct), logger(NULL), timer(m->cct, client_lock), 
     ino_invalidate_cb(NULL),
-    tick_event(NULL),
+    tick_event(NULL), cap_batch_event(NULL),
     monclient(mc), messenger(m), whoami(m->get_myname().num()),
     initialized(false), mounted(false), unmounting(false),
     local_osd(-1), local_osd_epoch(0),
@@ -122,7 +123,11 @@ Client::Client(Messenger *m, MonClient *mc)
     object_size(0),
     file_replication(0),
     preferred_pg(-1),
-    client_lock("Client::client_lock")
+    client_lock("Client::client_lock"),
+    objecter_lock("Client::objecter_lock"),
+    objecter_timer(m->cct, objecter_lock),
+    objecter_finisher(m->cct),
+    objecter_ready(false)
 {
   monclient->set_messenger(m);
 
@@ -148,9 +153,10 @@ Client::Client(Messenger *m, MonClient *mc)
   // osd interfaces
   osdmap = new OSDMap;     // initially blank.. see mount()
   mdsmap = new MDSMap;
-  objecter = new Objecter(cct, messenger, monclient, osdmap, client_lock, timer);
+  objecter = new Objecter(cct, messenger, monclient, osdmap, objecter_lock, objecter_timer);
   objecter->set_client_incarnation(0);  // client always 0, for now.
-  writeback_handler = new ObjecterWriteback(objecter);
+  writeback_handler = new ObjecterWriteback(objecter, &objecter_lock,
+					    &objecter_finisher, &client_lock);
   objectcacher = new ObjectCacher(cct, "libcephfs", *writeback_handler, client_lock,
 				  client_flush_set_callback,    // all commit callback
 				  (void*)this);
@@ -271,6 +277,7 @@ int Client::init()
   assert(!initialized);
 
   timer.init();
+  objecter_finisher.start();
 
   objectcacher->start();
 
@@ -281,7 +288,11 @@ int Client::init()
   if (r < 0)
     return r;
 
+  objecter_lock.Lock();
+  objecter_timer.init();
   objecter->init();
+  objecter_ready = true;
+  objecter_lock.Unlock();
 
   monclient->set_want_keys(CEPH_ENTITY_TYPE_MDS | CEPH_ENTITY_TYPE_OSD);
   monclient->sub_want("mdsmap", 0, 0);
@@ -294,6 +305,12 @@ int Client::init()
   plb.add_fl_avg(l_c_wrlat, "wrlat");
   plb.add_fl_avg(l_c_owrlat, "owrlat");
   plb.add_fl_avg(l_c_ordlat, "ordlat");
+  plb.add_u64_counter(l_c_lookup_cached, "lookup_cached");
+  plb.add_u64_counter(l_c_lookup_mds, "lookup_mds");
+  plb.add_u64_counter(l_c_getattr_cached, "getattr_cached");
+  plb.add_u64_counter(l_c_getattr_mds, "getattr_mds");
+  plb.add_u64_counter(l_c_readdir_prefetch, "readdir_prefetch");
+  plb.add_u64_counter(l_c_readdir_prefetch_hit, "readdir_prefetch_hit");
   logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(logger);
 
@@ -311,8 +328,13 @@ void Client::shutdown()
   assert(initialized);
   initialized = false;
   timer.shutdown();
+  objecter_lock.Lock();
+  objecter_ready = false;
+  objecter_timer.shutdown();
   objecter->shutdown();
+  objecter_lock.Unlock();
   client_lock.Unlock();
+  objecter_finisher.stop();  // also outside of client_lock; it takes it
   monclient->shutdown();
   messenger->shutdown();
 
@@ -776,6 +798,7 @@ Inode* Client::insert_trace(MetaRequest *request, int mds)
     // only open dir if we're actually adding stuff to it!
     Dir *dir = in->open_dir();
     assert(dir);
+    dir->readdir_stamp = ceph_clock_now(cct);
     
     // dirstat
     DirStat dst(p);
@@ -809,8 +832,7 @@ Inode* Client::insert_trace(MetaRequest *request, int mds)
       // remove any skipped names
       while (pd != dir->dentry_map.end() && pd->first < dname) {
 	if (pd->first < dname &&
-	    diri->dirfragtree[ceph_str_hash_linux(pd->first.c_str(),
-						  pd->first.length())] == fg) {  // do not remove items in earlier frags
+	    diri->dirfragtree[diri->hash_dentry_name(pd->first)] == fg) {  // do not remove items in earlier frags
 	  ldout(cct, 15) << "insert_trace  unlink '" << pd->first << "'" << dendl;
 	  Dentry *dn = pd->second;
 	  pd++;
@@ -859,8 +881,7 @@ Inode* Client::insert_trace(MetaRequest *request, int mds)
     // remove trailing names
     if (end) {
       while (pd != dir->dentry_map.end()) {
-	if (diri->dirfragtree[ceph_str_hash_linux(pd->first.c_str(),
-						  pd->first.length())] == fg) {
+	if (diri->dirfragtree[diri->hash_dentry_name(pd->first)] == fg) {
 	  ldout(cct, 15) << "insert_trace  unlink '" << pd->first << "'" << dendl;
 	  Dentry *dn = pd->second;
 	  pd++;
@@ -903,9 +924,7 @@ int Client::choose_target_mds(MetaRequest *req)
     in = req->inode;
     ldout(cct, 20) << "choose_target_mds starting with req->inode " << *in << dendl;
     if (req->path.depth()) {
-      hash = ceph_str_hash(in->dir_layout.dl_dir_hash,
-			   req->path[0].data(),
-			   req->path[0].length());
+      hash = in->hash_dentry_name(req->path[0]);
       ldout(cct, 20) << "choose_target_mds inode dir hash is " << (int)in->dir_layout.dl_dir_hash
 	       << " on " << req->path[0]
 	       << " => " << hash << dendl;
@@ -917,9 +936,7 @@ int Client::choose_target_mds(MetaRequest *req)
       ldout(cct, 20) << "choose_target_mds starting with req->dentry inode " << *in << dendl;
     } else {
       in = req->dentry->dir->parent_inode;
-      hash = ceph_str_hash(in->dir_layout.dl_dir_hash,
-			   req->dentry->name.data(),
-			   req->dentry->name.length());
+      hash = in->hash_dentry_name(req->dentry->name);
       ldout(cct, 20) << "choose_target_mds dentry dir hash is " << (int)in->dir_layout.dl_dir_hash
 	       << " on " << req->dentry->name
 	       << " => " << hash << dendl;
@@ -1241,8 +1258,11 @@ void Client::handle_client_session(MClientSession *m)
 
   case CEPH_SESSION_CLOSE:
     mount_cond.Signal();
-    if (mds_session)
+    if (mds_session) {
       remove_session_caps(mds_session);
+      if (mds_session->caps_batch)
+	mds_session->caps_batch->put();
+    }
     kick_requests(from, true);
     delete mds_session;
     mds_sessions.erase(from);
@@ -1302,6 +1322,9 @@ void Client::send_request(MetaRequest *request, int mds)
 
   mds_sessions[mds]->requests.push_back(&request->item);
 
+  // any queued cap updates must reach the mds ahead of the request
+  flush_cap_batch(mds_sessions[mds]);
+
   ldout(cct, 10) << "send_request " << *r << " to mds." << mds << dendl;
   messenger->send_message(r, mdsmap->get_inst(mds));
 }
@@ -1465,26 +1488,23 @@ void Client::handle_client_reply(MClientReply *reply)
 
 bool Client::ms_dispatch(Message *m)
 {
+  switch (m->get_type()) {
+    // osd traffic only needs the objecter
+  case CEPH_MSG_OSD_OPREPLY:
+  case CEPH_MSG_OSD_MAP:
+  case CEPH_MSG_STATFS_REPLY:
+    return ms_dispatch_objecter(m);
+  }
+
   client_lock.Lock();
   if (!initialized) {
     ldout(cct, 10) << "inactive, discarding " << *m << dendl;
     m->put();
+    client_lock.Unlock();
     return true;
   }
 
   switch (m->get_type()) {
-    // osd
-  case CEPH_MSG_OSD_OPREPLY:
-    objecter->handle_osd_op_reply((MOSDOpReply*)m);
-    break;
-  case CEPH_MSG_OSD_MAP:
-    objecter->handle_osd_map((class MOSDMap*)m);
-    break;
-  case CEPH_MSG_STATFS_REPLY:
-    objecter->handle_fs_stats_reply((MStatfsReply*)m);
-    break;
-
-    
     // mounting and mds sessions
   case CEPH_MSG_MDS_MAP:
     handle_mds_map((MMDSMap*)m);
@@ -1512,6 +1532,7 @@ bool Client::ms_dispatch(Message *m)
     break;
 
   default:
+    client_lock.Unlock();
     return false;
   }
 
@@ -1535,6 +1556,30 @@ bool Client::ms_dispatch(Message *m)
   return true;
 }
 
+bool Client::ms_dispatch_objecter(Message *m)
+{
+  Mutex::Locker l(objecter_lock);
+  if (!objecter_ready) {
+    ldout(cct, 10) << "objecter inactive, discarding " << *m << dendl;
+    m->put();
+    return true;
+  }
+
+  switch (m->get_type()) {
+  case CEPH_MSG_OSD_OPREPLY:
+    objecter->handle_osd_op_reply((MOSDOpReply*)m);
+    break;
+  case CEPH_MSG_OSD_MAP:
+    objecter->handle_osd_map((class MOSDMap*)m);
+    break;
+  case CEPH_MSG_STATFS_REPLY:
+    objecter->handle_fs_stats_reply((MStatfsReply*)m);
+    break;
+  default:
+    assert(0);
+  }
+  return true;
+}
 
 void Client::handle_mds_map(MMDSMap* m)
 {
@@ -1597,6 +1642,17 @@ void Client::send_reconnect(int mds)
 
   assert(mds_sessions.count(mds));
 
+  // queued cap messages were meant for the old mds instance; the
+  // reconnect carries our wanted caps and kick_flushing_caps() resends
+  // any dirty metadata.
+  MetaSession *session = mds_sessions[mds];
+  if (session->caps_batch) {
+    ldout(cct, 10) << " dropping " << session->caps_batch->caps.size()
+		   << " queued cap messages" << dendl;
+    session->caps_batch->put();
+    session->caps_batch = NULL;
+  }
+
   // i have an open session.
   hash_set<inodeno_t> did_snaprealm;
   for (hash_map<vinodeno_t, Inode*>::iterator p = inode_map.begin();
@@ -2038,7 +2094,7 @@ void Client::send_cap(Inode *in, int mds, Cap *cap, int used, int want, int reta
     in->requested_max_size = in->wanted_max_size;
     ldout(cct, 15) << "auth cap, setting max_size = " << in->requested_max_size << dendl;
   }
-  messenger->send_message(m, mdsmap->get_inst(mds));
+  send_cap_message(cap->session, m);
 }
 
 
@@ -2269,7 +2325,7 @@ void Client::flush_snaps(Inode *in, bool all_again, CapSnap *again)
     capsnap->atime.encode_timeval(&m->head.atime);
     m->head.time_warp_seq = capsnap->time_warp_seq;
 
-    messenger->send_message(m, mdsmap->get_inst(mds));
+    send_cap_message(in->auth_cap->session, m);
   }
 }
 
@@ -2614,6 +2670,8 @@ void Client::flush_caps()
     ++p;
     check_caps(in, true);
   }
+
+  flush_cap_batches();
 }
 
 void Client::flush_caps(Inode *in, int mds)
@@ -2630,6 +2688,9 @@ void Client::flush_caps(Inode *in, int mds)
 
 void Client::wait_sync_caps(uint64_t want)
 {
+  // don't make the waiter sit out the batching window
+  flush_cap_batches();
+
  retry:
   ldout(cct, 10) << "wait_sync_caps want " << want << " (last is " << last_flush_seq << ", "
 	   << num_flushing_caps << " total flushing)" << dendl;
@@ -3228,9 +3289,11 @@ int Client::mount(const std::string &mount_root)
 
   tick(); // start tick
   
+  objecter_lock.Lock();
   ldout(cct, 2) << "mounted: have osdmap " << osdmap->get_epoch() 
 	  << " and mdsmap " << mdsmap->get_epoch() 
 	  << dendl;
+  objecter_lock.Unlock();
 
   
   // hack: get+pin root inode.
@@ -3291,6 +3354,9 @@ void Client::unmount()
   if (tick_event)
     timer.cancel_event(tick_event);
   tick_event = 0;
+  if (cap_batch_event)
+    timer.cancel_event(cap_batch_event);
+  cap_batch_event = 0;
 
   if (cwd)
     put_inode(cwd);
@@ -3394,12 +3460,88 @@ public:
   }
 };
 
+class C_C_CapBatch : public Context {
+  Client *client;
+public:
+  C_C_CapBatch(Client *c) : client(c) {}
+  void finish(int r) {
+    client->cap_batch_event = 0;
+    client->flush_cap_batches();
+  }
+};
+
+/*
+ * Cap messages to an mds that understands MClientCapsBatch are queued
+ * on the session and go out together once client_caps_batch_max of
+ * them pile up or client_caps_batch_interval passes, whichever comes
+ * first.  Anything else we send the mds (requests, releases) flushes
+ * the queue first so the mds sees everything in the order we issued it.
+ */
+void Client::send_cap_message(MetaSession *s, MClientCaps *m)
+{
+  int max = cct->_conf->client_caps_batch_max;
+  int mds = s->mds_num;
+  entity_inst_t inst = mdsmap->get_inst(mds);
+
+  if (max > 1) {
+    Connection *con = messenger->get_connection(inst);
+    bool can_batch = con && con->has_feature(CEPH_FEATURE_CAPBATCH);
+    if (con)
+      con->put();
+    if (can_batch) {
+      if (!s->caps_batch)
+	s->caps_batch = new MClientCapsBatch;
+      s->caps_batch->caps.push_back(m);
+      ldout(cct, 20) << "send_cap_message queued " << *m << " for mds." << mds
+		     << ", " << s->caps_batch->caps.size() << " pending" << dendl;
+      if ((int)s->caps_batch->caps.size() >= max) {
+	flush_cap_batch(s);
+      } else if (!cap_batch_event) {
+	cap_batch_event = new C_C_CapBatch(this);
+	timer.add_event_after(cct->_conf->client_caps_batch_interval, cap_batch_event);
+      }
+      return;
+    }
+  }
+
+  flush_cap_batch(s);
+  messenger->send_message(m, inst);
+}
+
+void Client::flush_cap_batch(MetaSession *s)
+{
+  if (!s->caps_batch)
+    return;
+  MClientCapsBatch *b = s->caps_batch;
+  s->caps_batch = NULL;
+  ldout(cct, 10) << "flush_cap_batch " << b->caps.size() << " cap messages to mds."
+		 << s->mds_num << dendl;
+  if (b->caps.size() == 1) {
+    // not worth the wrapper
+    MClientCaps *m = b->caps.front();
+    b->caps.clear();
+    b->put();
+    messenger->send_message(m, mdsmap->get_inst(s->mds_num));
+    return;
+  }
+  messenger->send_message(b, mdsmap->get_inst(s->mds_num));
+}
+
+void Client::flush_cap_batches()
+{
+  for (map<int,MetaSession*>::iterator p = mds_sessions.begin();
+       p != mds_sessions.end();
+       p++)
+    flush_cap_batch(p->second);
+}
+
 void Client::flush_cap_releases()
 {
   // send any cap releases
   for (map<int,MetaSession*>::iterator p = mds_sessions.begin();
        p != mds_sessions.end();
        p++) {
+    flush_cap_batch(p->second);
     if (p->second->release && mdsmap->is_up(p->first)) {
       messenger->send_message(p->second->release, mdsmap->get_inst(p->first));
       p->second->release = 0;
@@ -3486,6 +3628,7 @@ int Client::_do_lookup(Inode *dir, const char *name, Inode **target)
 int Client::_lookup(Inode *dir, const string& dname, Inode **target)
 {
   int r = 0;
+  bool prefetched = false;
 
   if (!dir->is_dir()) {
     r = -ENOTDIR;
@@ -3516,6 +3659,7 @@ int Client::_lookup(Inode *dir, const string& dname, Inode **target)
     goto done;
   }
 
+ relookup:
   if (dir->dir &&
       dir->dir->dentries.count(dname)) {
     Dentry *dn = dir->dir->dentries[dname];
@@ -3537,7 +3681,7 @@ int Client::_lookup(Inode *dir, const string& dname, Inode **target)
 	// make trim_caps() behave.
 	dir->try_touch_cap(dn->lease_mds);
 	touch_dn(dn);
-	goto done;
+	goto hit;
       }
       ldout(cct, 20) << " bad lease, cap_ttl " << s->cap_ttl << ", cap_gen " << s->cap_gen
 	       << " vs lease_gen " << dn->lease_gen << dendl;
@@ -3547,7 +3691,13 @@ int Client::_lookup(Inode *dir, const string& dname, Inode **target)
 	dn->cap_shared_gen == dir->shared_gen) {
       *target = dn->inode;
       touch_dn(dn);
-      goto done;
+      goto hit;
+    }
+
+    // we listed this dir not long ago; refresh it and its neighbors at once
+    if (!prefetched && _readdir_prefetch(dir, dname) == 0) {
+      prefetched = true;
+      goto relookup;
     }
   } else {
     // can we conclude ENOENT locally?
@@ -3558,7 +3708,14 @@ int Client::_lookup(Inode *dir, const string& dname, Inode **target)
     }
   }
 
+  logger->inc(l_c_lookup_mds);
   r = _do_lookup(dir, dname.c_str(), target);
+  goto done;
+
+ hit:
+  logger->inc(l_c_lookup_cached);
+  if (prefetched)
+    logger->inc(l_c_readdir_prefetch_hit);
 
  done:
   if (r < 0)
@@ -3867,8 +4024,32 @@ int Client::_getattr(Inode *in, int mask, int uid, int gid)
   bool yes = in->caps_issued_mask(mask);
 
   ldout(cct, 10) << "_getattr mask " << ccap_string(mask) << " issued=" << yes << dendl;
-  if (yes)
+  if (yes) {
+    logger->inc(l_c_getattr_cached);
     return 0;
+  }
+
+  // the readdir reply carries caps for every entry, so if we listed
+  // the parent recently, refetching it serves this and the siblings.
+  // don't bother if that already failed to get us these caps.
+  if (in->snapid == CEPH_NOSNAP && !in->dn_set.empty() &&
+      !(in->prefetch_missed & mask)) {
+    Dentry *dn = in->get_first_parent();
+    in->get();
+    int r = _readdir_prefetch(dn->dir->parent_inode, dn->name);
+    yes = in->caps_issued_mask(mask);
+    if (r == 0 && !yes)
+      in->prefetch_missed |= mask & ~in->caps_issued();
+    put_inode(in);
+    if (r == 0 && yes) {
+      ldout(cct, 10) << "_getattr satisfied by readdir prefetch" << dendl;
+      logger->inc(l_c_getattr_cached);
+      logger->inc(l_c_readdir_prefetch_hit);
+      return 0;
+    }
+  }
+
+  logger->inc(l_c_getattr_mds);
 
   MetaRequest *req = new MetaRequest(CEPH_MDS_OP_GETATTR);
   filepath path;
@@ -3879,6 +4060,8 @@ int Client::_getattr(Inode *in, int mask, int uid, int gid)
   
   int res = make_request(req, uid, gid);
   ldout(cct, 10) << "_getattr result=" << res << dendl;
+  if (res == 0 && in->caps_issued_mask(mask))
+    in->prefetch_missed &= ~mask;  // the mds hands these out again
   return res;
 }
 
@@ -4278,6 +4461,88 @@ void Client::_readdir_drop_dirp_buffer(dir_result_t *dirp)
   }
 }
 
+/*
+ * A lookup or getattr that missed on an entry of a dir we listed
+ * recently is usually one of many (ls -l, find).  Fetch the chunk of
+ * the entry's frag starting at it instead: one reply refreshes the
+ * dentry leases and inode caps for it and the entries that follow.
+ * If that doesn't leave the entry leased, back off for a while.
+ * Returns 0 if we fetched.
+ */
+int Client::_readdir_prefetch(Inode *diri, const string& dname)
+{
+  Dir *dir = diri->dir;
+  if (!cct->_conf->client_readdir_prefetch ||
+      !dir || diri->snapid != CEPH_NOSNAP ||
+      dir->readdir_stamp == utime_t())
+    return -1;
+
+  utime_t now = ceph_clock_now(cct);
+  if ((double)(now - dir->readdir_stamp) > cct->_conf->client_readdir_prefetch_window ||
+      dir->prefetch_backoff > now)
+    return -1;
+
+  // start right after our predecessor, if it came from the same frag
+  frag_t fg = diri->dirfragtree[diri->hash_dentry_name(dname)];
+  string start;
+  uint64_t offset = 0;
+  map<string,Dentry*>::iterator p = dir->dentry_map.find(dname);
+  if (p != dir->dentry_map.end() && p != dir->dentry_map.begin()) {
+    --p;
+    Dentry *prev = p->second;
+    if (prev->offset >> 32 == fg.value() &&
+	(prev->offset & 0xffffffff) >= 2) {
+      start = p->first;
+      offset = (prev->offset & 0xffffffff) + 1;
+    }
+  }
+
+  ldout(cct, 10) << "_readdir_prefetch " << *diri << " fg " << fg << " for '" << dname
+		 << "' start '" << start << "' offset " << offset << dendl;
+  logger->inc(l_c_readdir_prefetch);
+
+  MetaRequest *req = new MetaRequest(CEPH_MDS_OP_READDIR);
+  filepath path;
+  diri->make_nosnap_relative_path(path);
+  req->set_filepath(path);
+  req->inode = diri;
+  req->head.args.readdir.frag = fg;
+  req->head.args.readdir.max_entries = cct->_conf->client_readdir_prefetch_max;
+  if (start.length()) {
+    req->path2.set_path(start.c_str());
+    req->readdir_start = start;
+  }
+  req->readdir_offset = offset;
+  req->readdir_frag = fg;
+
+  diri->get();
+  int r = make_request(req, -1, -1);
+
+  for (unsigned i = 0; i < req->readdir_result.size(); i++)
+    put_inode(req->readdir_result[i].second);
+  req->readdir_result.clear();
+
+  // did it get us anywhere?
+  if (diri->dir) {
+    bool leased = false;
+    if (diri->dir->dentries.count(dname)) {
+      Dentry *dn = diri->dir->dentries[dname];
+      leased = (dn->lease_mds >= 0 && dn->lease_ttl > now) ||
+	(diri->caps_issued_mask(CEPH_CAP_FILE_SHARED) &&
+	 dn->cap_shared_gen == diri->shared_gen);
+    }
+    if (!leased) {
+      ldout(cct, 10) << "_readdir_prefetch didn't get a lease on '" << dname
+		     << "', backing off" << dendl;
+      diri->dir->prefetch_backoff = ceph_clock_now(cct);
+      diri->dir->prefetch_backoff += cct->_conf->client_readdir_prefetch_window;
+    }
+  }
+  put_inode(diri);
+
+  return r < 0 ? r : 0;
+}
+
 int Client::_readdir_get_frag(dir_result_t *dirp)
 {
   // get the current frag.
@@ -5163,10 +5428,12 @@ int Client::_read_sync(Fh *f, uint64_t off, uint64_t len, bufferlist *bl)
     bufferlist tbl;
     
     int wanted = left;
+    objecter_lock.Lock();
     filer->read_trunc(in->ino, &in->layout, in->snapid,
 		      pos, left, &tbl, 0,
 		      in->truncate_size, in->truncate_seq,
-		      onfinish);
+		      objecter_wrap(onfinish));
+    objecter_lock.Unlock();
     while (!done)
       cond.Wait(client_lock);
 
@@ -5258,7 +5525,10 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
   if ((uint64_t)(offset+size) > mdsmap->get_max_filesize()) //too large!
     return -EFBIG;
 
-  if (osdmap->test_flag(CEPH_OSDMAP_FULL))
+  objecter_lock.Lock();
+  bool full = osdmap->test_flag(CEPH_OSDMAP_FULL);
+  objecter_lock.Unlock();
+  if (full)
     return -ENOSPC;
 
   //ldout(cct, 7) << "write fh " << fh << " size " << size << " offset " << offset << dendl;
@@ -5331,10 +5601,12 @@ int Client::_write(Fh *f, int64_t offset, uint64_t size, const char *buf)
     unsafe_sync_write++;
     get_cap_ref(in, CEPH_CAP_FILE_BUFFER);  // released by onsafe callback
     
+    objecter_lock.Lock();
     filer->write_trunc(in->ino, &in->layout, in->snaprealm->get_snap_context(),
 		       offset, size, bl, ceph_clock_now(cct), 0,
 		       in->truncate_size, in->truncate_seq,
-		       onfinish, onsafe);
+		       objecter_wrap(onfinish), objecter_wrap(onsafe));
+    objecter_lock.Unlock();
     
     while (!done)
       cond.Wait(client_lock);
@@ -5533,7 +5805,9 @@ int Client::statfs(const char *path, struct statvfs *stbuf)
   bool done;
   int rval;
 
+  objecter_lock.Lock();
   objecter->get_fs_stats(stats, new C_SafeCond(&lock, &cond, &done, &rval));
+  objecter_lock.Unlock();
 
   client_lock.Unlock();
   lock.Lock();
@@ -6806,7 +7080,7 @@ int Client::describe_layout(int fd, ceph_file_layout *lp)
 
 int Client::get_pool_replication(int64_t pool)
 {
-  Mutex::Locker lock(client_lock);
+  Mutex::Locker lock(objecter_lock);
   if (!osdmap->have_pg_pool(pool))
     return -ENOENT;
   return osdmap->get_pg_pool(pool)->get_size();
@@ -6826,6 +7100,7 @@ int Client::get_file_stripe_address(int fd, loff_t offset, vector<entity_addr_t>
   assert(extents.size() == 1);
 
   // now we have the object and its 'layout'
+  Mutex::Locker olock(objecter_lock);
   pg_t pg = osdmap->object_locator_to_pg(extents[0].oid, extents[0].oloc);
   vector<int> osds;
   osdmap->pg_to_acting_osds(pg, osds);
@@ -6863,6 +7138,7 @@ int Client::enumerate_layout(int fd, vector<ObjectExtent>& result,
 int Client::get_local_osd()
 {
   Mutex::Locker lock(client_lock);
+  Mutex::Locker olock(objecter_lock);
 
   if (osdmap->get_epoch() != local_osd_epoch) {
     local_osd = osdmap->find_osd_on_ip(messenger->get_myaddr());
@@ -6881,14 +7157,14 @@ int Client::get_local_osd()
 void Client::ms_handle_connect(Connection *con)
 {
   ldout(cct, 10) << "ms_handle_connect on " << con->get_peer_addr() << dendl;
-  Mutex::Locker l(client_lock);
+  Mutex::Locker l(objecter_lock);
   objecter->ms_handle_connect(con);
 }
 
 bool Client::ms_handle_reset(Connection *con) 
 {
   ldout(cct, 0) << "ms_handle_reset on " << con->get_peer_addr() << dendl;
-  Mutex::Locker l(client_lock);
+  Mutex::Locker l(objecter_lock);
   objecter->ms_handle_reset(con);
   return false;
 }
@@ -6896,7 +7172,7 @@ bool Client::ms_handle_reset(Connection *con)
 void Client::ms_handle_remote_reset(Connection *con) 
 {
   ldout(cct, 0) << "ms_handle_remote_reset on " << con->get_peer_addr() << dendl;
-  Mutex::Locker l(client_lock);
+  Mutex::Locker l(objecter_lock);
   objecter->ms_handle_remote_reset(con);
 }
 
@@ -6910,7 +7186,7 @@ bool Client::ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool
 
 void Client::set_filer_flags(int flags)
 {
-  Mutex::Locker l(client_lock);
+  Mutex::Locker l(objecter_lock);
   assert(flags == 0 ||
 	 flags == CEPH_OSD_FLAG_LOCALIZE_READS);
   objecter->add_global_op_flags(flags);
@@ -6918,7 +7194,7 @@ void Client::set_filer_flags(int flags)
 
 void Client::clear_filer_flags(int flags)
 {
-  Mutex::Locker l(client_lock);
+  Mutex::Locker l(objecter_lock);
   assert(flags == CEPH_OSD_FLAG_LOCALIZE_READS);
   objecter->clear_global_op_flag(flags);
 }
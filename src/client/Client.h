@@ -42,6 +42,7 @@ using namespace __gnu_cxx;
 
 #include "common/Mutex.h"
 #include "common/Timer.h"
+#include "common/Finisher.h"
 
 #include "osdc/ObjectCacher.h"
 
@@ -76,6 +77,12 @@ enum {
   l_c_owrlat,
   l_c_ordlat,
   l_c_wrlat,
+  l_c_lookup_cached,
+  l_c_lookup_mds,
+  l_c_getattr_cached,
+  l_c_getattr_mds,
+  l_c_readdir_prefetch,
+  l_c_readdir_prefetch_hit,
   l_c_last,
 };
 
@@ -201,6 +208,13 @@ class Client : public Dispatcher {
   void renew_caps();
   void renew_caps(int s);
   void flush_cap_releases();
+
+  // cap message coalescing
+  Context *cap_batch_event;
+  void send_cap_message(MetaSession *s, MClientCaps *m);
+  void flush_cap_batch(MetaSession *s);
+  void flush_cap_batches();
+  friend class C_C_CapBatch;
 public:
   void tick();
 
@@ -304,6 +318,20 @@ protected:
   //  - protects Client and buffer cache both!
   Mutex                  client_lock;
 
+  // the Objecter (and the osdmap it maintains) has its own lock, so
+  // that OSD replies and map updates don't contend with metadata
+  // operations and cached i/o.  lock ordering is client_lock ->
+  // objecter_lock; completions that need client_lock are bounced
+  // through objecter_finisher.
+  Mutex                  objecter_lock;
+  SafeTimer              objecter_timer;
+  Finisher               objecter_finisher;
+  bool                   objecter_ready;
+
+  Context *objecter_wrap(Context *c) {
+    return new C_OnFinisher(new C_Lock(&client_lock, c), &objecter_finisher);
+  }
+
   // helpers
   void wake_inode_waiters(int mds);
   void wait_on_list(list<Cond*>& ls);
@@ -352,6 +380,7 @@ protected:
   // friends
   friend class SyntheticClient;
   bool ms_dispatch(Message *m);
+  bool ms_dispatch_objecter(Message *m);
 
   void ms_handle_connect(Connection *con);
   bool ms_handle_reset(Connection *con);
@@ -461,6 +490,7 @@ private:
   void _readdir_next_frag(dir_result_t *dirp);
   void _readdir_rechoose_frag(dir_result_t *dirp);
   int _readdir_get_frag(dir_result_t *dirp);
+  int _readdir_prefetch(Inode *diri, const string& dname);
   int _readdir_cache_cb(dir_result_t *dirp, add_dirent_cb_t cb, void *p);
   void _closedir(dir_result_t *dirp);
 
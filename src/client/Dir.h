@@ -10,6 +10,8 @@ class Dir {
   map<string, Dentry*> dentry_map;
   uint64_t release_count;
   uint64_t max_offset;
+  utime_t readdir_stamp;     // last time readdir results landed here
+  utime_t prefetch_backoff;  // no readdir prefetch until then
 
   Dir(Inode* in) : release_count(0), max_offset(2) { parent_inode = in; }
 
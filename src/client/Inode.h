@@ -127,6 +127,7 @@ class Inode {
   utime_t hold_caps_until;
   xlist<Inode*>::item cap_item, flushing_cap_item;
   tid_t last_flush_tid;
+  int prefetch_missed;  // caps a readdir prefetch didn't get us
 
   SnapRealm *snaprealm;
   xlist<Inode*>::item snaprealm_item;
@@ -161,6 +162,14 @@ class Inode {
   void make_long_path(filepath& p);
   void make_nosnap_relative_path(filepath& p);
 
+  // same as CInode::hash_dentry_name
+  unsigned hash_dentry_name(const string &dn) {
+    int which = dir_layout.dl_dir_hash;
+    if (!which)
+      which = CEPH_STR_HASH_LINUX;
+    return ceph_str_hash(which, dn.data(), dn.length());
+  }
+
   void get() { 
     _ref++; 
     lsubdout(cct, mds, 15) << "inode.get on " << this << " " <<  ino << '.' << snapid
@@ -195,6 +204,7 @@ class Inode {
       snap_caps(0), snap_cap_refs(0),
       exporting_issued(0), exporting_mds(-1), exporting_mseq(0),
       cap_item(this), flushing_cap_item(this), last_flush_tid(0),
+      prefetch_missed(0),
       snaprealm(0), snaprealm_item(this), snapdir_parent(0),
       oset((void *)this, layout->fl_pg_pool, ino),
       reported_size(0), wanted_max_size(0), requested_max_size(0),
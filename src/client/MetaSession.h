@@ -11,6 +11,7 @@ class Inode;
 class CapSnap;
 class MetaRequest;
 class MClientCapRelease;
+class MClientCapsBatch;
 
 struct MetaSession {
   int mds_num;
@@ -30,9 +31,10 @@ struct MetaSession {
   xlist<MetaRequest*> unsafe_requests;
 
   MClientCapRelease *release;
+  MClientCapsBatch *caps_batch;  // cap messages waiting to be sent
   
   MetaSession() : mds_num(-1), seq(0), cap_gen(0), cap_renew_seq(0), num_caps(0),
-		 closing(false), was_stale(false), release(NULL) {}
+		 closing(false), was_stale(false), release(NULL), caps_batch(NULL) {}
 };
 
 #endif
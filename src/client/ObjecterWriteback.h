@@ -3,37 +3,60 @@
 #ifndef CEPH_OSDC_OBJECTERWRITEBACKHANDLER_H
 #define CEPH_OSDC_OBJECTERWRITEBACKHANDLER_H
 
+#include "common/Cond.h"
+#include "common/Finisher.h"
 #include "osdc/Objecter.h"
 #include "osdc/WritebackHandler.h"
 
+/**
+ * The Objecter runs under its own lock, separate from the lock that
+ * protects the ObjectCacher.  Requests take the objecter lock (so the
+ * cache lock always nests outside it), and completions are bounced
+ * through a Finisher that retakes the cache lock.
+ */
 class ObjecterWriteback : public WritebackHandler {
  public:
-  ObjecterWriteback(Objecter *o) : m_objecter(o) {}
+  ObjecterWriteback(Objecter *o, Mutex *objecter_lock,
+		    Finisher *fin, Mutex *cache_lock)
+    : m_objecter(o), m_objecter_lock(objecter_lock),
+      m_finisher(fin), m_cache_lock(cache_lock) {}
   virtual ~ObjecterWriteback() {}
 
   virtual tid_t read(const object_t& oid, const object_locator_t& oloc,
 		     uint64_t off, uint64_t len, snapid_t snapid,
 		     bufferlist *pbl, uint64_t trunc_size,  __u32 trunc_seq,
 		     Context *onfinish) {
+    Mutex::Locker l(*m_objecter_lock);
     return m_objecter->read_trunc(oid, oloc, off, len, snapid, pbl, 0,
-				  trunc_size, trunc_seq, onfinish);
+				  trunc_size, trunc_seq, wrap(onfinish));
   }
 
   virtual tid_t write(const object_t& oid, const object_locator_t& oloc,
 		      uint64_t off, uint64_t len, const SnapContext& snapc,
 		      const bufferlist &bl, utime_t mtime, uint64_t trunc_size,
 		      __u32 trunc_seq, Context *oncommit) {
+    Mutex::Locker l(*m_objecter_lock);
     return m_objecter->write_trunc(oid, oloc, off, len, snapc, bl, mtime, 0,
-				   trunc_size, trunc_seq, NULL, oncommit);
+				   trunc_size, trunc_seq, NULL, wrap(oncommit));
   }
 
   virtual tid_t lock(const object_t& oid, const object_locator_t& oloc, int op,
 		     int flags, Context *onack, Context *oncommit) {
-    return m_objecter->lock(oid, oloc, op, flags, onack, oncommit);
+    Mutex::Locker l(*m_objecter_lock);
+    return m_objecter->lock(oid, oloc, op, flags, wrap(onack), wrap(oncommit));
   }
 
  private:
+  Context *wrap(Context *c) {
+    if (!c)
+      return NULL;
+    return new C_OnFinisher(new C_Lock(m_cache_lock, c), m_finisher);
+  }
+
   Objecter *m_objecter;
+  Mutex *m_objecter_lock;
+  Finisher *m_finisher;
+  Mutex *m_cache_lock;
 };
 
 #endif
@@ -1674,7 +1674,9 @@ int SyntheticClient::dump_placement(string& fn) {
   for (vector<ObjectExtent>::iterator i = extents.begin(); 
        i != extents.end(); ++i) {
     
+    client->objecter_lock.Lock();
     int osd = client->osdmap->get_pg_primary(client->osdmap->object_locator_to_pg(i->oid, i->oloc));
+    client->objecter_lock.Unlock();
 
     // run through all the buffer extents
     for (map<uint64_t, uint64_t>::iterator j = i ->buffer_extents.begin();
@@ -1955,6 +1957,7 @@ int SyntheticClient::overload_osd_0(int n, int size, int wrsize) {
 int SyntheticClient::check_first_primary(int fh) {
   vector<ObjectExtent> extents;
   client->enumerate_layout(fh, extents, 1, 0);  
+  Mutex::Locker l(client->objecter_lock);
   return client->osdmap->get_pg_primary(client->osdmap->object_locator_to_pg(extents.begin()->oid,
 									     extents.begin()->oloc));
 }
@@ -2214,11 +2217,11 @@ int SyntheticClient::create_objects(int nobj, int osize, int inflight)
     dout(10) << "writing " << oid << dendl;
     
     starts.push_back(ceph_clock_now(g_ceph_context));
-    client->client_lock.Lock();
+    client->objecter_lock.Lock();
     client->objecter->write(oid, oloc, 0, osize, snapc, bl, ceph_clock_now(g_ceph_context), 0,
 			    new C_Ref(lock, cond, &unack),
 			    new C_Ref(lock, cond, &unsafe));
-    client->client_lock.Unlock();
+    client->objecter_lock.Unlock();
 
     lock.Lock();
     while (unack > inflight) {
@@ -2309,7 +2312,7 @@ int SyntheticClient::object_rw(int nobj, int osize, int wrpc,
     object_locator_t oloc(CEPH_DATA_RULE);
     SnapContext snapc;
     
-    client->client_lock.Lock();
+    client->objecter_lock.Lock();
     utime_t start = ceph_clock_now(g_ceph_context);
     if (write) {
       dout(10) << "write to " << oid << dendl;
@@ -2337,7 +2340,7 @@ int SyntheticClient::object_rw(int nobj, int osize, int wrpc,
       client->objecter->read(oid, oloc, 0, osize, CEPH_NOSNAP, &inbl, 0,
 			     new C_Ref(lock, cond, &unack));
     }
-    client->client_lock.Unlock();
+    client->objecter_lock.Unlock();
 
     lock.Lock();
     while (unack > 0) {
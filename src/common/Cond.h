@@ -108,4 +108,25 @@ public:
   }
 };
 
+/**
+ * Complete a context while holding a lock; used to hand completions
+ * from a layer with its own lock back to the layer that owns the
+ * context (usually via C_OnFinisher, so no lock is ever nested).
+ */
+class C_Lock : public Context {
+  Mutex *lock;
+  Context *fin;
+public:
+  C_Lock(Mutex *l, Context *c) : lock(l), fin(c) {}
+  ~C_Lock() {
+    delete fin;
+  }
+  void finish(int r) {
+    lock->Lock();
+    fin->complete(r);
+    fin = NULL;
+    lock->Unlock();
+  }
+};
+
 #endif
@@ -110,6 +110,9 @@ OPTION(mon_osd_full_ratio, OPT_FLOAT, .95) // what % full makes an OSD "full"
 OPTION(mon_osd_nearfull_ratio, OPT_FLOAT, .85) // what % full makes an OSD near full
 OPTION(mon_globalid_prealloc, OPT_INT, 100)   // how many globalids to prealloc
 OPTION(mon_osd_report_timeout, OPT_INT, 900)    // grace period before declaring unresponsive OSDs dead
+OPTION(mon_osd_cache_size, OPT_INT, 10)  // recent encoded osdmaps (inc and full) kept in memory
+OPTION(mon_osd_map_share_fanout, OPT_INT, 1)  // osds told about each new epoch as soon as it commits
+OPTION(mon_cached_replies, OPT_INT, 16)  // read-only command replies kept per service until the next commit; 0 to disable
 OPTION(mon_force_standby_active, OPT_BOOL, true) // should mons force standby-replay mds to be active
 OPTION(mon_min_osdmap_epochs, OPT_INT, 500)
 OPTION(mon_max_pgmap_epochs, OPT_INT, 500)
@@ -120,6 +123,7 @@ OPTION(mon_slurp_bytes, OPT_INT, 256*1024)    // limit size of slurp messages
 OPTION(paxos_max_join_drift, OPT_INT, 10)       // max paxos iterations before we must first slurp
 OPTION(paxos_propose_interval, OPT_DOUBLE, 1.0)  // gather updates for this long before proposing a map update
 OPTION(paxos_min_wait, OPT_DOUBLE, 0.05)  // min time to gather updates for after period of inactivity
+OPTION(paxos_coalesce_proposals, OPT_BOOL, true)  // propose other services' waiting updates along with any proposal
 OPTION(paxos_observer_timeout, OPT_DOUBLE, 5*60) // gather updates for this long before proposing a map update
 OPTION(clock_offset, OPT_DOUBLE, 0) // how much to offset the system clock in Clock.cc
 OPTION(auth_supported, OPT_STR, "none")
@@ -131,10 +135,15 @@ OPTION(client_cache_size, OPT_INT, 16384)
 OPTION(client_cache_mid, OPT_FLOAT, .75)
 OPTION(client_cache_stat_ttl, OPT_INT, 0) // seconds until cached stat results become invalid
 OPTION(client_cache_readdir_ttl, OPT_INT, 1)  // 1 second only
+OPTION(client_readdir_prefetch, OPT_BOOL, true) // refetch a listed dir instead of one lookup/getattr per entry
+OPTION(client_readdir_prefetch_window, OPT_DOUBLE, 30) // seconds after a readdir that we'll do so
+OPTION(client_readdir_prefetch_max, OPT_INT, 1024) // entries per prefetch
 OPTION(client_use_random_mds, OPT_BOOL, false)
 OPTION(client_mount_timeout, OPT_DOUBLE, 30.0)
 OPTION(client_unmount_timeout, OPT_DOUBLE, 10.0)
 OPTION(client_tick_interval, OPT_DOUBLE, 1.0)
+OPTION(client_caps_batch_max, OPT_INT, 128)  // max cap messages coalesced per mds; 0 to send each on its own
+OPTION(client_caps_batch_interval, OPT_DOUBLE, .01) // seconds a cap message may wait for others to join its batch
 OPTION(client_trace, OPT_STR, "")
 OPTION(client_readahead_min, OPT_LONGLONG, 128*1024)  // readahead at _least_ this much.
 OPTION(client_readahead_max_bytes, OPT_LONGLONG, 0)  //8 * 1024*1024
@@ -155,6 +164,7 @@ OPTION(objecter_mon_retry_interval, OPT_DOUBLE, 5.0)
 OPTION(objecter_timeout, OPT_DOUBLE, 10.0)    // before we ask for a map
 OPTION(objecter_inflight_op_bytes, OPT_U64, 1024*1024*100) // max in-flight data (both directions)
 OPTION(objecter_inflight_ops, OPT_U64, 1024)               // max in-flight ios
+OPTION(rados_finisher_threads, OPT_INT, 1)  // librados aio completion threads; ordering is kept per object
 OPTION(journaler_allow_split_entries, OPT_BOOL, true)
 OPTION(journaler_write_head_interval, OPT_INT, 15)
 OPTION(journaler_prefetch_periods, OPT_INT, 10)   // * journal object size
@@ -164,6 +174,7 @@ OPTION(journaler_batch_max, OPT_U64, 0)  // max bytes we'll delay flushing; disa
 OPTION(mds_max_file_size, OPT_U64, 1ULL << 40)
 OPTION(mds_cache_size, OPT_INT, 100000)
 OPTION(mds_cache_mid, OPT_FLOAT, .7)
+OPTION(mds_cache_memory_limit, OPT_U64, 0) // bytes; trim the cache to this as well as mds_cache_size (0 = no limit)
 OPTION(mds_mem_max, OPT_INT, 1048576)        // KB
 OPTION(mds_dir_commit_ratio, OPT_FLOAT, .5)
 OPTION(mds_dir_max_commit_size, OPT_INT, 90) // MB
@@ -180,10 +191,15 @@ OPTION(mds_dirstat_min_interval, OPT_FLOAT, 1)    // try to avoid propagating mo
 OPTION(mds_scatter_nudge_interval, OPT_FLOAT, 5)  // how quickly dirstat changes propagate up the hierarchy
 OPTION(mds_client_prealloc_inos, OPT_INT, 1000)
 OPTION(mds_early_reply, OPT_BOOL, true)
-OPTION(mds_use_tmap, OPT_BOOL, true)        // use trivialmap for dir updates
+OPTION(mds_use_tmap, OPT_BOOL, false)        // store dirfrags as trivialmap (legacy) instead of omap
+OPTION(mds_dir_keys_per_op, OPT_INT, 16384)  // max dentries read per op when fetching an omap dirfrag
+OPTION(mds_fetch_decode_threads, OPT_INT, 2)  // threads decoding fetched dirfrags outside mds_lock (0 = decode inline)
+OPTION(mds_fetch_decode_min_keys, OPT_INT, 64)  // only hand off fetched chunks with at least this many dentries
+OPTION(mds_sessionmap_keys_per_op, OPT_INT, 1024)  // max sessions read per op from the sessionmap object
 OPTION(mds_default_dir_hash, OPT_INT, CEPH_STR_HASH_RJENKINS)
 OPTION(mds_log, OPT_BOOL, true)
 OPTION(mds_log_skip_corrupt_events, OPT_BOOL, false)
+OPTION(mds_log_replay_decode_ahead, OPT_INT, 1000)  // max events read and decoded ahead of replay
 OPTION(mds_log_max_events, OPT_INT, -1)
 OPTION(mds_log_max_segments, OPT_INT, 30)  // segment size defined by FileLayout, above
 OPTION(mds_log_max_expiring, OPT_INT, 20)
@@ -199,6 +215,8 @@ OPTION(mds_bal_split_bits, OPT_INT, 3)
 OPTION(mds_bal_merge_size, OPT_INT, 50)
 OPTION(mds_bal_merge_rd, OPT_FLOAT, 1000)
 OPTION(mds_bal_merge_wr, OPT_FLOAT, 1000)
+OPTION(mds_bal_split_load_fraction, OPT_FLOAT, .3)  // split a dirfrag carrying more than this share of our auth load (0 = off)
+OPTION(mds_bal_split_min_load, OPT_FLOAT, 100)     // ...but only once our auth meta load is at least this
 OPTION(mds_bal_interval, OPT_INT, 10)           // seconds
 OPTION(mds_bal_fragment_interval, OPT_INT, 5)      // seconds
 OPTION(mds_bal_idle_threshold, OPT_FLOAT, 0)
@@ -213,6 +231,7 @@ OPTION(mds_bal_midchunk, OPT_FLOAT, .3)       // any sub bigger than this taken
 OPTION(mds_bal_minchunk, OPT_FLOAT, .001)     // never take anything smaller than this
 OPTION(mds_bal_target_removal_min, OPT_INT, 5) // min balance iterations before old target is removed
 OPTION(mds_bal_target_removal_max, OPT_INT, 10) // max balance iterations before old target is removed
+OPTION(mds_max_exports_in_flight, OPT_INT, 8)   // subtrees the migrator exports concurrently
 OPTION(mds_replay_interval, OPT_FLOAT, 1.0) // time to wait before starting replay again
 OPTION(mds_shutdown_check, OPT_INT, 0)
 OPTION(mds_thrash_exports, OPT_INT, 0)
@@ -268,6 +287,7 @@ OPTION(osd_pool_default_pg_num, OPT_INT, 8)
 OPTION(osd_pool_default_pgp_num, OPT_INT, 8)
 OPTION(osd_map_cache_max, OPT_INT, 250)
 OPTION(osd_map_message_max, OPT_INT, 100)  // max maps per MOSDMap message
+OPTION(osd_map_share_fanout, OPT_INT, 0)  // heartbeat peers we pass each new epoch on to; 0 to wait for the next ping
 OPTION(osd_op_threads, OPT_INT, 2)    // 0 == no threading
 OPTION(osd_disk_threads, OPT_INT, 1)
 OPTION(osd_recovery_threads, OPT_INT, 1)
@@ -275,6 +295,7 @@ OPTION(osd_recover_clone_overlap, OPT_BOOL, true)   // preserve clone_overlap du
 OPTION(osd_backfill_scan_min, OPT_INT, 64)
 OPTION(osd_backfill_scan_max, OPT_INT, 512)
 OPTION(osd_op_thread_timeout, OPT_INT, 30)
+OPTION(osd_subop_reply_batch_max, OPT_INT, 64)  // max sub op replies coalesced per peer; 0 to send each on its own
 OPTION(osd_backlog_thread_timeout, OPT_INT, 60*60*1)
 OPTION(osd_recovery_thread_timeout, OPT_INT, 30)
 OPTION(osd_snap_trim_thread_timeout, OPT_INT, 60*60*1)
@@ -298,7 +319,10 @@ OPTION(osd_preserve_trimmed_log, OPT_BOOL, true)
 OPTION(osd_auto_mark_unfound_lost, OPT_BOOL, false)
 OPTION(osd_recovery_delay_start, OPT_FLOAT, 15)
 OPTION(osd_recovery_max_active, OPT_INT, 5)
+OPTION(osd_recovery_op_latency_target, OPT_FLOAT, 0)  // back recovery off while avg client op latency (seconds) is above this; 0 = always run osd_recovery_max_active
 OPTION(osd_recovery_max_chunk, OPT_U64, 1<<20)  // max size of push chunk
+OPTION(osd_recovery_push_pipeline, OPT_INT, 4)  // push chunks of one object in flight to a peer
+OPTION(osd_recovery_push_batch_max, OPT_INT, 16)  // max small objects pushed per message; 1 to push each on its own
 OPTION(osd_recovery_forget_lost_objects, OPT_BOOL, false)   // off for now
 OPTION(osd_max_scrubs, OPT_INT, 1)
 OPTION(osd_scrub_load_threshold, OPT_FLOAT, 0.5)
@@ -324,6 +348,7 @@ OPTION(filestore_xattr_use_omap, OPT_BOOL, false)
 OPTION(filestore_max_inline_xattr_size, OPT_U32, 512)
 // for more than filestore_max_inline_xattrs attrs
 OPTION(filestore_max_inline_xattrs, OPT_U32, 2)
+OPTION(filestore_omap_header_cache_size, OPT_INT, 1024) // decoded omap headers kept in memory
 
 OPTION(filestore_max_sync_interval, OPT_DOUBLE, 5)    // seconds
 OPTION(filestore_min_sync_interval, OPT_DOUBLE, .01)  // seconds
@@ -343,11 +368,16 @@ OPTION(filestore_queue_max_ops, OPT_INT, 500)
 OPTION(filestore_queue_max_bytes, OPT_INT, 100 << 20)
 OPTION(filestore_queue_committing_max_ops, OPT_INT, 500)        // this is ON TOP of filestore_queue_max_*
 OPTION(filestore_queue_committing_max_bytes, OPT_INT, 100 << 20) //  "
+OPTION(filestore_queue_throttle_low, OPT_DOUBLE, .3)       // start delaying new ops at this journal/queue fill
+OPTION(filestore_queue_throttle_high, OPT_DOUBLE, .9)      // ...and delay them the most here
+OPTION(filestore_queue_throttle_max_delay, OPT_DOUBLE, .01) // seconds; 0 disables
 OPTION(filestore_op_threads, OPT_INT, 2)
+OPTION(filestore_parallel_apply, OPT_BOOL, true) // apply a sequencer's ops on disjoint objects concurrently
 OPTION(filestore_op_thread_timeout, OPT_INT, 60)
 OPTION(filestore_op_thread_suicide_timeout, OPT_INT, 180)
 OPTION(filestore_commit_timeout, OPT_FLOAT, 600)
 OPTION(filestore_fiemap_threshold, OPT_INT, 4096)
+OPTION(filestore_readv_max_gap, OPT_INT, 128 << 10) // read through holes up to this size to cover several extents with one preadv
 OPTION(filestore_merge_threshold, OPT_INT, 10)
 OPTION(filestore_split_multiple, OPT_INT, 2)
 OPTION(filestore_update_collections, OPT_BOOL, false)
@@ -101,6 +101,41 @@ ssize_t safe_pread_exact(int fd, void *buf, size_t count, off_t offset)
 	return 0;
 }
 
+ssize_t safe_preadv(int fd, struct iovec *iov, int iovcnt, off_t offset)
+{
+	ssize_t r;
+	size_t cnt = 0;
+
+	while (iovcnt > 0) {
+#if defined(DARWIN)
+		r = pread(fd, iov->iov_base, iov->iov_len, offset + cnt);
+#else
+		r = preadv(fd, iov, iovcnt, offset + cnt);
+#endif
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (r == 0 && iov->iov_len) {
+			// EOF
+			return cnt;
+		}
+
+		cnt += r;
+		while (iovcnt > 0 && (size_t)r >= iov->iov_len) {
+			r -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (r) {
+			iov->iov_base = (char *)iov->iov_base + r;
+			iov->iov_len -= r;
+		}
+	}
+	return cnt;
+}
+
 ssize_t safe_pwrite(int fd, const void *buf, size_t count, off_t offset)
 {
 	int r;
@@ -17,6 +17,7 @@
 
 #include "common/compiler_extensions.h"
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,13 @@ extern "C" {
   ssize_t safe_pwrite(int fd, const void *buf, size_t count, off_t offset)
       WARN_UNUSED_RESULT;
 
+  /*
+   * Read into several buffers starting at offset, like preadv().  A
+   * short count means EOF.  The iovec array is consumed as we go.
+   */
+  ssize_t safe_preadv(int fd, struct iovec *iov, int iovcnt, off_t offset)
+      WARN_UNUSED_RESULT;
+
   /*
    * Same as the above functions, but return -EDOM unless exactly the requested
    * number of bytes can be read.
@@ -19,6 +19,9 @@
 #define CEPH_FEATURE_OSDREPLYMUX    (1<<12)
 #define CEPH_FEATURE_OSDENC         (1<<13)
 #define CEPH_FEATURE_OMAP           (1<<14)
+#define CEPH_FEATURE_CAPBATCH       (1<<15)
+#define CEPH_FEATURE_SUBOPREPLYBATCH (1<<16)
+#define CEPH_FEATURE_SUBOPBATCH     (1<<17)
 
 /*
  * Features supported.  Should be everything above.
@@ -38,6 +41,9 @@
 	 CEPH_FEATURE_PGPOOL3 |		 \
 	 CEPH_FEATURE_OSDREPLYMUX |	 \
 	 CEPH_FEATURE_OSDENC |		 \
-	 CEPH_FEATURE_OMAP)
+	 CEPH_FEATURE_OMAP |		 \
+	 CEPH_FEATURE_CAPBATCH |	 \
+	 CEPH_FEATURE_SUBOPREPLYBATCH | \
+	 CEPH_FEATURE_SUBOPBATCH)
 
 #endif
@@ -114,6 +114,7 @@ struct ceph_dir_layout {
 #define CEPH_MSG_CLIENT_LEASE           0x311
 #define CEPH_MSG_CLIENT_SNAP            0x312
 #define CEPH_MSG_CLIENT_CAPRELEASE      0x313
+#define CEPH_MSG_CLIENT_CAPS_BATCH      0x314
 
 /* pool ops */
 #define CEPH_MSG_POOLOP_REPLY           48
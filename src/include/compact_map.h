@@ -0,0 +1,163 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMPACT_MAP_H
+#define CEPH_COMPACT_MAP_H
+
+#include <map>
+
+#include "include/types.h"
+
+/*
+ * A std::map that costs one pointer until something is put in it.
+ *
+ * Meant for members of objects we keep millions of (CInode) that are
+ * empty nearly all the time.  The map is allocated on first insert and
+ * freed again by clear(); erase() leaves it allocated so that
+ * iterators stay valid while erasing in a loop.  Iterators are plain
+ * std::map iterators, and an unallocated map hands out those of a
+ * shared empty map, so it must not be modified through them.
+ */
+template <class Key, class T>
+class compact_map {
+public:
+  typedef std::map<Key, T> map_type;
+  typedef typename map_type::key_type key_type;
+  typedef typename map_type::mapped_type mapped_type;
+  typedef typename map_type::value_type value_type;
+  typedef typename map_type::size_type size_type;
+  typedef typename map_type::iterator iterator;
+  typedef typename map_type::const_iterator const_iterator;
+  typedef typename map_type::reverse_iterator reverse_iterator;
+  typedef typename map_type::const_reverse_iterator const_reverse_iterator;
+
+private:
+  map_type *m;
+
+  static map_type& empty_map() {
+    static map_type e;
+    return e;
+  }
+  map_type& alloc() {
+    if (!m)
+      m = new map_type;
+    return *m;
+  }
+
+public:
+  compact_map() : m(0) {}
+  compact_map(const compact_map& o) : m(0) {
+    if (!o.empty())
+      m = new map_type(*o.m);
+  }
+  ~compact_map() {
+    delete m;
+  }
+
+  compact_map& operator=(const compact_map& o) {
+    if (this != &o) {
+      if (o.empty())
+	clear();
+      else
+	alloc() = *o.m;
+    }
+    return *this;
+  }
+  compact_map& operator=(const map_type& o) {
+    if (o.empty())
+      clear();
+    else
+      alloc() = o;
+    return *this;
+  }
+
+  /// read-only view as a std::map, for code that wants one
+  const map_type& get() const {
+    return m ? *m : empty_map();
+  }
+  operator const map_type&() const {
+    return get();
+  }
+
+  bool empty() const { return !m || m->empty(); }
+  size_type size() const { return m ? m->size() : 0; }
+
+  iterator begin() { return m ? m->begin() : empty_map().begin(); }
+  iterator end() { return m ? m->end() : empty_map().end(); }
+  const_iterator begin() const { return get().begin(); }
+  const_iterator end() const { return get().end(); }
+  reverse_iterator rbegin() { return m ? m->rbegin() : empty_map().rbegin(); }
+  reverse_iterator rend() { return m ? m->rend() : empty_map().rend(); }
+  const_reverse_iterator rbegin() const { return get().rbegin(); }
+  const_reverse_iterator rend() const { return get().rend(); }
+
+  size_type count(const Key& k) const { return m ? m->count(k) : 0; }
+  iterator find(const Key& k) { return m ? m->find(k) : empty_map().end(); }
+  const_iterator find(const Key& k) const { return get().find(k); }
+  iterator lower_bound(const Key& k) {
+    return m ? m->lower_bound(k) : empty_map().end();
+  }
+  const_iterator lower_bound(const Key& k) const { return get().lower_bound(k); }
+  iterator upper_bound(const Key& k) {
+    return m ? m->upper_bound(k) : empty_map().end();
+  }
+  const_iterator upper_bound(const Key& k) const { return get().upper_bound(k); }
+
+  T& operator[](const Key& k) { return alloc()[k]; }
+  std::pair<iterator,bool> insert(const value_type& v) { return alloc().insert(v); }
+
+  void erase(iterator p) { m->erase(p); }
+  size_type erase(const Key& k) { return m ? m->erase(k) : 0; }
+  void clear() {
+    delete m;
+    m = 0;
+  }
+  void swap(compact_map& o) {
+    map_type *t = m;
+    m = o.m;
+    o.m = t;
+  }
+  void swap(map_type& o) {
+    if (o.empty() && empty())
+      return;
+    alloc().swap(o);
+  }
+
+  void encode(bufferlist& bl) const {
+    ::encode(get(), bl);
+  }
+  void decode(bufferlist::iterator& p) {
+    map_type t;
+    ::decode(t, p);
+    clear();
+    swap(t);
+  }
+};
+
+template<class Key, class T>
+inline void encode(const compact_map<Key,T>& m, bufferlist& bl) {
+  m.encode(bl);
+}
+template<class Key, class T>
+inline void decode(compact_map<Key,T>& m, bufferlist::iterator& p) {
+  m.decode(p);
+}
+
+template<class Key, class T>
+inline std::ostream& operator<<(std::ostream& out, const compact_map<Key,T>& m)
+{
+  return out << m.get();
+}
+
+#endif
@@ -0,0 +1,155 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_COMPACT_SET_H
+#define CEPH_COMPACT_SET_H
+
+#include <set>
+
+#include "include/types.h"
+
+/*
+ * A std::set that costs one pointer until something is put in it.
+ * See compact_map.h; the same rules apply.
+ */
+template <class T>
+class compact_set {
+public:
+  typedef std::set<T> set_type;
+  typedef typename set_type::key_type key_type;
+  typedef typename set_type::value_type value_type;
+  typedef typename set_type::size_type size_type;
+  typedef typename set_type::iterator iterator;
+  typedef typename set_type::const_iterator const_iterator;
+  typedef typename set_type::reverse_iterator reverse_iterator;
+  typedef typename set_type::const_reverse_iterator const_reverse_iterator;
+
+private:
+  set_type *s;
+
+  static set_type& empty_set() {
+    static set_type e;
+    return e;
+  }
+  set_type& alloc() {
+    if (!s)
+      s = new set_type;
+    return *s;
+  }
+
+public:
+  compact_set() : s(0) {}
+  compact_set(const compact_set& o) : s(0) {
+    if (!o.empty())
+      s = new set_type(*o.s);
+  }
+  ~compact_set() {
+    delete s;
+  }
+
+  compact_set& operator=(const compact_set& o) {
+    if (this != &o) {
+      if (o.empty())
+	clear();
+      else
+	alloc() = *o.s;
+    }
+    return *this;
+  }
+  compact_set& operator=(const set_type& o) {
+    if (o.empty())
+      clear();
+    else
+      alloc() = o;
+    return *this;
+  }
+
+  /// read-only view as a std::set, for code that wants one
+  const set_type& get() const {
+    return s ? *s : empty_set();
+  }
+  operator const set_type&() const {
+    return get();
+  }
+
+  bool empty() const { return !s || s->empty(); }
+  size_type size() const { return s ? s->size() : 0; }
+
+  iterator begin() { return s ? s->begin() : empty_set().begin(); }
+  iterator end() { return s ? s->end() : empty_set().end(); }
+  const_iterator begin() const { return get().begin(); }
+  const_iterator end() const { return get().end(); }
+  reverse_iterator rbegin() { return s ? s->rbegin() : empty_set().rbegin(); }
+  reverse_iterator rend() { return s ? s->rend() : empty_set().rend(); }
+  const_reverse_iterator rbegin() const { return get().rbegin(); }
+  const_reverse_iterator rend() const { return get().rend(); }
+
+  size_type count(const T& v) const { return s ? s->count(v) : 0; }
+  iterator find(const T& v) { return s ? s->find(v) : empty_set().end(); }
+  const_iterator find(const T& v) const { return get().find(v); }
+  iterator lower_bound(const T& v) {
+    return s ? s->lower_bound(v) : empty_set().end();
+  }
+  const_iterator lower_bound(const T& v) const { return get().lower_bound(v); }
+  iterator upper_bound(const T& v) {
+    return s ? s->upper_bound(v) : empty_set().end();
+  }
+  const_iterator upper_bound(const T& v) const { return get().upper_bound(v); }
+
+  std::pair<iterator,bool> insert(const T& v) { return alloc().insert(v); }
+
+  void erase(iterator p) { s->erase(p); }
+  size_type erase(const T& v) { return s ? s->erase(v) : 0; }
+  void clear() {
+    delete s;
+    s = 0;
+  }
+  void swap(compact_set& o) {
+    set_type *t = s;
+    s = o.s;
+    o.s = t;
+  }
+  void swap(set_type& o) {
+    if (o.empty() && empty())
+      return;
+    alloc().swap(o);
+  }
+
+  void encode(bufferlist& bl) const {
+    ::encode(get(), bl);
+  }
+  void decode(bufferlist::iterator& p) {
+    set_type t;
+    ::decode(t, p);
+    clear();
+    swap(t);
+  }
+};
+
+template<class T>
+inline void encode(const compact_set<T>& s, bufferlist& bl) {
+  s.encode(bl);
+}
+template<class T>
+inline void decode(compact_set<T>& s, bufferlist::iterator& p) {
+  s.decode(p);
+}
+
+template<class T>
+inline std::ostream& operator<<(std::ostream& out, const compact_set<T>& s)
+{
+  return out << s.get();
+}
+
+#endif
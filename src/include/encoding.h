@@ -455,6 +455,29 @@ inline void decode(std::vector<T>& v, bufferlist::iterator& p)
     decode(v[i], p);
 }
 
+// vector (shared pointers)
+template<class T>
+inline void encode(const std::vector<std::tr1::shared_ptr<T> >& v, bufferlist& bl)
+{
+  __u32 n = v.size();
+  encode(n, bl);
+  for (typename std::vector<std::tr1::shared_ptr<T> >::const_iterator p = v.begin(); p != v.end(); ++p)
+    encode(**p, bl);
+}
+template<class T>
+inline void decode(std::vector<std::tr1::shared_ptr<T> >& v, bufferlist::iterator& p)
+{
+  __u32 n;
+  decode(n, p);
+  v.clear();
+  v.reserve(n);
+  while (n--) {
+    std::tr1::shared_ptr<T> e(new T);
+    decode(*e, p);
+    v.push_back(e);
+  }
+}
+
 template<class T>
 inline void encode_nohead(const std::vector<T>& v, bufferlist& bl)
 {
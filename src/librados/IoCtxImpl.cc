@@ -644,7 +644,7 @@ int librados::IoCtxImpl::aio_operate_read(const object_t &oid,
 					  ::ObjectOperation *o,
 					  AioCompletionImpl *c, bufferlist *pbl)
 {
-  Context *onack = new C_aio_Ack(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
 
   c->io = this;
   c->pbl = pbl;
@@ -664,8 +664,8 @@ int librados::IoCtxImpl::aio_operate(const object_t& oid,
   if (snap_seq != CEPH_NOSNAP)
     return -EROFS;
 
-  Context *onack = new C_aio_Ack(c);
-  Context *oncommit = new C_aio_Safe(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
+  Context *oncommit = new C_aio_Safe(c, client->get_finisher(oid));
 
   c->io = this;
   queue_aio_write(c);
@@ -680,7 +680,7 @@ int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  bufferlist *pbl, size_t len, uint64_t off)
 {
 
-  Context *onack = new C_aio_Ack(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
   eversion_t ver;
 
   c->io = this;
@@ -696,7 +696,7 @@ int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 int librados::IoCtxImpl::aio_read(const object_t oid, AioCompletionImpl *c,
 				  char *buf, size_t len, uint64_t off)
 {
-  Context *onack = new C_aio_Ack(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
 
   c->io = this;
   c->buf = buf;
@@ -717,7 +717,7 @@ int librados::IoCtxImpl::aio_sparse_read(const object_t oid,
 					 uint64_t off)
 {
 
-  C_aio_sparse_read_Ack *onack = new C_aio_sparse_read_Ack(c);
+  C_aio_sparse_read_Ack *onack = new C_aio_sparse_read_Ack(c, client->get_finisher(oid));
   onack->m = m;
   onack->data_bl = data_bl;
   eversion_t ver;
@@ -746,8 +746,8 @@ int librados::IoCtxImpl::aio_write(const object_t &oid, AioCompletionImpl *c,
   c->io = this;
   queue_aio_write(c);
 
-  Context *onack = new C_aio_Ack(c);
-  Context *onsafe = new C_aio_Safe(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
+  Context *onsafe = new C_aio_Safe(c, client->get_finisher(oid));
 
   Mutex::Locker l(*lock);
   objecter->write(oid, oloc,
@@ -769,8 +769,8 @@ int librados::IoCtxImpl::aio_append(const object_t &oid, AioCompletionImpl *c,
   c->io = this;
   queue_aio_write(c);
 
-  Context *onack = new C_aio_Ack(c);
-  Context *onsafe = new C_aio_Safe(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
+  Context *onsafe = new C_aio_Safe(c, client->get_finisher(oid));
 
   Mutex::Locker l(*lock);
   objecter->append(oid, oloc,
@@ -793,8 +793,8 @@ int librados::IoCtxImpl::aio_write_full(const object_t &oid,
   c->io = this;
   queue_aio_write(c);
 
-  Context *onack = new C_aio_Ack(c);
-  Context *onsafe = new C_aio_Safe(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
+  Context *onsafe = new C_aio_Safe(c, client->get_finisher(oid));
 
   Mutex::Locker l(*lock);
   objecter->write_full(oid, oloc,
@@ -1008,7 +1008,7 @@ int librados::IoCtxImpl::aio_exec(const object_t& oid, AioCompletionImpl *c,
 				  const char *cls, const char *method,
 				  bufferlist& inbl, bufferlist *outbl)
 {
-  Context *onack = new C_aio_Ack(c);
+  Context *onack = new C_aio_Ack(c, client->get_finisher(oid));
 
   c->io = this;
 
@@ -1477,9 +1477,18 @@ void librados::IoCtxImpl::set_notify_timeout(uint32_t timeout)
   notify_timeout = timeout;
 }
 
+/*
+ * aio acks and commits mark the completion and wake waiters right here,
+ * from the objecter.  Only the user callbacks go to a finisher, picked
+ * by object so that everything for one object (ack before commit, op
+ * after op) is called back in order.  A callback may therefore wait on
+ * another aio without holding up the thread that completes it.
+ */
+
 ///////////////////////////// C_aio_Ack ////////////////////////////////
 
-librados::IoCtxImpl::C_aio_Ack::C_aio_Ack(AioCompletionImpl *_c) : c(_c)
+librados::IoCtxImpl::C_aio_Ack::C_aio_Ack(AioCompletionImpl *_c, Finisher *f)
+  : c(_c), finisher(f)
 {
   c->get();
 }
@@ -1500,17 +1509,17 @@ void librados::IoCtxImpl::C_aio_Ack::finish(int r)
     *c->pbl = c->bl;
   }
 
-  if (c->callback_complete) {
-    c->io->client->finisher.queue(new C_AioComplete(c));
-  }
+  if (c->callback_complete)
+    finisher->queue(new C_AioComplete(c));
 
   c->put_unlock();
 }
 
 /////////////////////// C_aio_sparse_read_Ack //////////////////////////
 
-librados::IoCtxImpl::C_aio_sparse_read_Ack::C_aio_sparse_read_Ack(AioCompletionImpl *_c)
-  : c(_c)
+librados::IoCtxImpl::C_aio_sparse_read_Ack::C_aio_sparse_read_Ack(AioCompletionImpl *_c,
+								 Finisher *f)
+  : c(_c), finisher(f)
 {
   c->get();
 }
@@ -1528,16 +1537,16 @@ void librados::IoCtxImpl::C_aio_sparse_read_Ack::finish(int r)
     ::decode(*data_bl, iter);
   }
 
-  if (c->callback_complete) {
-    c->io->client->finisher.queue(new C_AioComplete(c));
-  }
+  if (c->callback_complete)
+    finisher->queue(new C_AioComplete(c));
 
   c->put_unlock();
 }
 
 //////////////////////////// C_aio_Safe ////////////////////////////////
 
-librados::IoCtxImpl::C_aio_Safe::C_aio_Safe(AioCompletionImpl *_c) : c(_c)
+librados::IoCtxImpl::C_aio_Safe::C_aio_Safe(AioCompletionImpl *_c, Finisher *f)
+  : c(_c), finisher(f)
 {
   c->get();
 }
@@ -1552,9 +1561,8 @@ void librados::IoCtxImpl::C_aio_Safe::finish(int r)
   c->safe = true;
   c->cond.Signal();
 
-  if (c->callback_safe) {
-    c->io->client->finisher.queue(new C_AioSafe(c));
-  }
+  if (c->callback_safe)
+    finisher->queue(new C_AioSafe(c));
 
   c->io->complete_aio_write(c);
 
@@ -27,6 +27,7 @@
 #include "osd/osd_types.h"
 #include "osdc/Objecter.h"
 
+class Finisher;
 class RadosClient;
 
 struct librados::IoCtxImpl {
@@ -141,7 +142,8 @@ struct librados::IoCtxImpl {
 
   struct C_aio_Ack : public Context {
     librados::AioCompletionImpl *c;
-    C_aio_Ack(AioCompletionImpl *_c);
+    Finisher *finisher;
+    C_aio_Ack(AioCompletionImpl *_c, Finisher *f);
     void finish(int r);
   };
 
@@ -149,13 +151,15 @@ struct librados::IoCtxImpl {
     AioCompletionImpl *c;
     bufferlist *data_bl;
     std::map<uint64_t,uint64_t> *m;
-    C_aio_sparse_read_Ack(AioCompletionImpl *_c);
+    Finisher *finisher;
+    C_aio_sparse_read_Ack(AioCompletionImpl *_c, Finisher *f);
     void finish(int r);
   };
 
   struct C_aio_Safe : public Context {
     AioCompletionImpl *c;
-    C_aio_Safe(AioCompletionImpl *_c);
+    Finisher *finisher;
+    C_aio_Safe(AioCompletionImpl *_c, Finisher *f);
     void finish(int r);
   };
 
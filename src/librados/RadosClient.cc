@@ -62,10 +62,16 @@ librados::RadosClient::RadosClient(CephContext *cct_)
     messenger(NULL),
     objecter(NULL),
     lock("radosclient"),
-    timer(cct, lock),
-    finisher(cct),
+    objecter_lock("radosclient::objecter_lock"),
+    objecter_timer(cct, objecter_lock),
+    objecter_ready(false),
     max_watch_cookie(0)
 {
+  int n = conf->rados_finisher_threads;
+  if (n < 1)
+    n = 1;
+  for (int i = 0; i < n; i++)
+    finishers.push_back(new Finisher(cct));
 }
 
 int64_t librados::RadosClient::lookup_pool(const char *name) {
@@ -82,7 +88,7 @@ const char *librados::RadosClient::get_pool_name(int64_t pool_id)
 
 int librados::RadosClient::pool_get_auid(uint64_t pool_id, unsigned long long *auid)
 {
-  Mutex::Locker l(lock);
+  Mutex::Locker l(objecter_lock);
   const pg_pool_t *pg = osdmap.get_pg_pool(pool_id);
   if (!pg)
     return -ENOENT;
@@ -92,7 +98,7 @@ int librados::RadosClient::pool_get_auid(uint64_t pool_id, unsigned long long *a
 
 int librados::RadosClient::pool_get_name(uint64_t pool_id, std::string *s)
 {
-  Mutex::Locker l(lock);
+  Mutex::Locker l(objecter_lock);
   const char *str = osdmap.get_pool_name(pool_id);
   if (!s)
     return -ENOENT;
@@ -135,7 +141,7 @@ int librados::RadosClient::connect()
   ldout(cct, 1) << "starting objecter" << dendl;
 
   err = -ENOMEM;
-  objecter = new Objecter(cct, messenger, &monclient, &osdmap, lock, timer);
+  objecter = new Objecter(cct, messenger, &monclient, &osdmap, objecter_lock, objecter_timer);
   if (!objecter)
     goto out;
   objecter->set_balanced_budget();
@@ -166,18 +172,22 @@ int librados::RadosClient::connect()
 
   lock.Lock();
 
-  timer.init();
+  for (unsigned i = 0; i < finishers.size(); i++)
+    finishers[i]->start();
+
+  objecter_lock.Lock();
+  objecter_timer.init();
 
   objecter->set_client_incarnation(0);
   objecter->init();
+  objecter_ready = true;
   monclient.renew_subs();
 
   while (osdmap.get_epoch() == 0) {
     ldout(cct, 1) << "waiting for osdmap" << dendl;
-    cond.Wait(lock);
+    cond.Wait(objecter_lock);
   }
-
-  finisher.start();
+  objecter_lock.Unlock();
 
   state = CONNECTED;
 
@@ -199,15 +209,21 @@ void librados::RadosClient::shutdown()
     lock.Unlock();
     return;
   }
-  if (state == CONNECTED) {
-    finisher.stop();
-  }
+  bool was_connected = (state == CONNECTED);
   monclient.shutdown();
-  if (objecter && state == CONNECTED)
+  objecter_lock.Lock();
+  objecter_ready = false;
+  if (objecter && was_connected)
     objecter->shutdown();
+  objecter_timer.shutdown();   // will drop+retake objecter_lock
+  objecter_lock.Unlock();
   state = DISCONNECTED;
-  timer.shutdown();   // will drop+retake lock
   lock.Unlock();
+  if (was_connected) {
+    // after the objecter, so nothing queues behind the stop
+    for (unsigned i = 0; i < finishers.size(); i++)
+      finishers[i]->stop();
+  }
   if (messenger) {
     messenger->shutdown();
     messenger->wait();
@@ -233,6 +249,8 @@ librados::RadosClient::~RadosClient()
     delete messenger;
   if (objecter)
     delete objecter;
+  for (unsigned i = 0; i < finishers.size(); i++)
+    delete finishers[i];
   common_destroy_context(cct);
   cct = NULL;
 }
@@ -243,7 +261,7 @@ int librados::RadosClient::create_ioctx(const char *name, IoCtxImpl **io)
   if (poolid < 0)
     return (int)poolid;
 
-  *io = new librados::IoCtxImpl(this, objecter, &lock, poolid, name,
+  *io = new librados::IoCtxImpl(this, objecter, &objecter_lock, poolid, name,
 				CEPH_NOSNAP);
   return 0;
 }
@@ -252,6 +270,18 @@ bool librados::RadosClient::ms_dispatch(Message *m)
 {
   bool ret;
 
+  switch (m->get_type()) {
+    // osd traffic (and watch events, which come from osds) only needs
+    // the objecter
+  case CEPH_MSG_OSD_OPREPLY:
+  case CEPH_MSG_OSD_MAP:
+  case MSG_GETPOOLSTATSREPLY:
+  case CEPH_MSG_STATFS_REPLY:
+  case CEPH_MSG_POOLOP_REPLY:
+  case CEPH_MSG_WATCH_NOTIFY:
+    return ms_dispatch_objecter(m);
+  }
+
   lock.Lock();
   if (state == DISCONNECTED) {
     ldout(cct, 10) << "disconnected, discarding " << *m << dendl;
@@ -264,30 +294,16 @@ bool librados::RadosClient::ms_dispatch(Message *m)
   return ret;
 }
 
-void librados::RadosClient::ms_handle_connect(Connection *con)
-{
-  Mutex::Locker l(lock);
-  objecter->ms_handle_connect(con);
-}
-
-bool librados::RadosClient::ms_handle_reset(Connection *con)
+bool librados::RadosClient::ms_dispatch_objecter(Message *m)
 {
-  Mutex::Locker l(lock);
-  objecter->ms_handle_reset(con);
-  return false;
-}
-
-void librados::RadosClient::ms_handle_remote_reset(Connection *con)
-{
-  Mutex::Locker l(lock);
-  objecter->ms_handle_remote_reset(con);
-}
-
+  Mutex::Locker l(objecter_lock);
+  if (!objecter_ready) {
+    ldout(cct, 10) << "objecter inactive, discarding " << *m << dendl;
+    m->put();
+    return true;
+  }
 
-bool librados::RadosClient::_dispatch(Message *m)
-{
   switch (m->get_type()) {
-  // OSD
   case CEPH_MSG_OSD_OPREPLY:
     objecter->handle_osd_op_reply((class MOSDOpReply*)m);
     break;
@@ -299,9 +315,6 @@ bool librados::RadosClient::_dispatch(Message *m)
     objecter->handle_get_pool_stats_reply((MGetPoolStatsReply*)m);
     break;
 
-  case CEPH_MSG_MDS_MAP:
-    break;
-
   case CEPH_MSG_STATFS_REPLY:
     objecter->handle_fs_stats_reply((MStatfsReply*)m);
     break;
@@ -313,6 +326,39 @@ bool librados::RadosClient::_dispatch(Message *m)
   case CEPH_MSG_WATCH_NOTIFY:
     watch_notify((MWatchNotify *)m);
     break;
+  default:
+    assert(0);
+  }
+
+  return true;
+}
+
+void librados::RadosClient::ms_handle_connect(Connection *con)
+{
+  Mutex::Locker l(objecter_lock);
+  objecter->ms_handle_connect(con);
+}
+
+bool librados::RadosClient::ms_handle_reset(Connection *con)
+{
+  Mutex::Locker l(objecter_lock);
+  objecter->ms_handle_reset(con);
+  return false;
+}
+
+void librados::RadosClient::ms_handle_remote_reset(Connection *con)
+{
+  Mutex::Locker l(objecter_lock);
+  objecter->ms_handle_remote_reset(con);
+}
+
+
+bool librados::RadosClient::_dispatch(Message *m)
+{
+  switch (m->get_type()) {
+  case CEPH_MSG_MDS_MAP:
+    break;
+
   default:
     return false;
   }
@@ -322,7 +368,7 @@ bool librados::RadosClient::_dispatch(Message *m)
 
 int librados::RadosClient::pool_list(std::list<std::string>& v)
 {
-  Mutex::Locker l(lock);
+  Mutex::Locker l(objecter_lock);
   for (map<int64_t,pg_pool_t>::const_iterator p = osdmap.get_pools().begin();
        p != osdmap.get_pools().end();
        p++)
@@ -337,9 +383,9 @@ int librados::RadosClient::get_pool_stats(std::list<string>& pools,
   Cond cond;
   bool done;
 
-  lock.Lock();
+  objecter_lock.Lock();
   objecter->get_pool_stats(pools, &result, new C_SafeCond(&mylock, &cond, &done));
-  lock.Unlock();
+  objecter_lock.Unlock();
 
   mylock.Lock();
   while (!done)
@@ -354,9 +400,9 @@ int librados::RadosClient::get_fs_stats(ceph_statfs& stats)
   Mutex mylock ("RadosClient::get_fs_stats::mylock");
   Cond cond;
   bool done;
-  lock.Lock();
+  objecter_lock.Lock();
   objecter->get_fs_stats(stats, new C_SafeCond(&mylock, &cond, &done));
-  lock.Unlock();
+  objecter_lock.Unlock();
 
   mylock.Lock();
   while (!done) cond.Wait(mylock);
@@ -373,11 +419,11 @@ int librados::RadosClient::pool_create(string& name, unsigned long long auid,
   Mutex mylock ("RadosClient::pool_create::mylock");
   Cond cond;
   bool done;
-  lock.Lock();
+  objecter_lock.Lock();
   objecter->create_pool(name,
 			new C_SafeCond(&mylock, &cond, &done, &reply),
 			auid, crush_rule);
-  lock.Unlock();
+  objecter_lock.Unlock();
 
   mylock.Lock();
   while(!done)
@@ -390,7 +436,7 @@ int librados::RadosClient::pool_create_async(string& name, PoolAsyncCompletionIm
 					     unsigned long long auid,
 					     __u8 crush_rule)
 {
-  Mutex::Locker l(lock);
+  Mutex::Locker l(objecter_lock);
   objecter->create_pool(name,
 			new C_PoolAsync_Safe(c),
 			auid, crush_rule);
@@ -406,10 +452,10 @@ int librados::RadosClient::pool_delete(const char *name)
   Mutex mylock("RadosClient::pool_delete::mylock");
   Cond cond;
   bool done;
-  lock.Lock();
+  objecter_lock.Lock();
   int reply = 0;
   objecter->delete_pool(tmp_pool_id, new C_SafeCond(&mylock, &cond, &done, &reply));
-  lock.Unlock();
+  objecter_lock.Unlock();
 
   mylock.Lock();
   while (!done) cond.Wait(mylock);
@@ -423,7 +469,7 @@ int librados::RadosClient::pool_delete_async(const char *name, PoolAsyncCompleti
   if (tmp_pool_id < 0)
     return -ENOENT;
 
-  Mutex::Locker l(lock);
+  Mutex::Locker l(objecter_lock);
   objecter->delete_pool(tmp_pool_id, new C_PoolAsync_Safe(c));
 
   return 0;
@@ -434,14 +480,14 @@ void librados::RadosClient::register_watcher(WatchContext *wc,
 					     librados::WatchCtx *ctx,
 					     uint64_t *cookie)
 {
-  assert(lock.is_locked());
+  assert(objecter_lock.is_locked());
   *cookie = ++max_watch_cookie;
   watchers[*cookie] = wc;
 }
 
 void librados::RadosClient::unregister_watcher(uint64_t cookie)
 {
-  assert(lock.is_locked());
+  assert(objecter_lock.is_locked());
   map<uint64_t, WatchContext *>::iterator iter = watchers.find(cookie);
   if (iter != watchers.end()) {
     WatchContext *ctx = iter->second;
@@ -454,7 +500,7 @@ void librados::RadosClient::unregister_watcher(uint64_t cookie)
 
 void librados::RadosClient::watch_notify(MWatchNotify *m)
 {
-  assert(lock.is_locked());
+  assert(objecter_lock.is_locked());
   WatchContext *wc = NULL;
   map<uint64_t, WatchContext *>::iterator iter = watchers.find(m->cookie);
   if (iter != watchers.end())
@@ -15,10 +15,12 @@
 #define CEPH_LIBRADOS_RADOSCLIENT_H
 
 #include "common/Cond.h"
+#include "common/Finisher.h"
 #include "common/Mutex.h"
 #include "common/Timer.h"
 #include "include/rados/librados.h"
 #include "include/rados/librados.hpp"
+#include "include/ceph_hash.h"
 #include "mon/MonClient.h"
 #include "msg/Dispatcher.h"
 #include "osd/OSDMap.h"
@@ -51,6 +53,7 @@ private:
 
   bool _dispatch(Message *m);
   bool ms_dispatch(Message *m);
+  bool ms_dispatch_objecter(Message *m);
 
   bool ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool force_new);
   void ms_handle_connect(Connection *con);
@@ -59,12 +62,25 @@ private:
 
   Objecter *objecter;
 
-  Mutex lock;
-  Cond cond;
-  SafeTimer timer;
+  Mutex lock;   // connection state
+
+  // the objecter, osdmap and watchers live under their own lock, so op
+  // submission and replies don't contend with the rest of the client
+  Mutex objecter_lock;
+  Cond cond;    // osdmap arrival, with objecter_lock
+  SafeTimer objecter_timer;
+  bool objecter_ready;
+
+  // aio completions; an object always maps to the same finisher
+  vector<Finisher*> finishers;
 
 public:
-  Finisher finisher;
+  Finisher *get_finisher(const object_t& oid) {
+    if (finishers.size() == 1)
+      return finishers[0];
+    return finishers[ceph_str_hash_linux(oid.name.c_str(), oid.name.length()) %
+		     finishers.size()];
+  }
 
   RadosClient(CephContext *cct_);
   ~RadosClient();
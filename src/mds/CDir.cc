@@ -305,6 +305,7 @@ CDentry* CDir::add_null_dentry(const string& dname,
   if (is_auth()) 
     dn->state_set(CDentry::STATE_AUTH);
   cache->lru.lru_insert_mid(dn);
+  cache->adjust_cache_bytes(sizeof(CDentry) + dname.length());
 
   dn->dir = this;
   dn->version = get_projected_version();
@@ -346,6 +347,7 @@ CDentry* CDir::add_primary_dentry(const string& dname, CInode *in,
   if (is_auth()) 
     dn->state_set(CDentry::STATE_AUTH);
   cache->lru.lru_insert_mid(dn);
+  cache->adjust_cache_bytes(sizeof(CDentry) + dname.length());
 
   dn->dir = this;
   dn->version = get_projected_version();
@@ -391,6 +393,7 @@ CDentry* CDir::add_remote_dentry(const string& dname, inodeno_t ino, unsigned ch
   if (is_auth()) 
     dn->state_set(CDentry::STATE_AUTH);
   cache->lru.lru_insert_mid(dn);
+  cache->adjust_cache_bytes(sizeof(CDentry) + dname.length());
 
   dn->dir = this;
   dn->version = get_projected_version();
@@ -453,6 +456,7 @@ void CDir::remove_dentry(CDentry *dn)
   // remove from list
   assert(items.count(dn->key()) == 1);
   items.erase(dn->key());
+  cache->adjust_cache_bytes(-(int64_t)(sizeof(CDentry) + dn->name.length()));
 
   // clean?
   if (dn->is_dirty())
@@ -1301,19 +1305,6 @@ void CDir::last_put()
 // -----------------------
 // FETCH
 
-class C_Dir_Fetch : public Context {
- protected:
-  CDir *dir;
-  string want_dn;
- public:
-  bufferlist bl;
-
-  C_Dir_Fetch(CDir *d, const string& w) : dir(d), want_dn(w) { }
-  void finish(int result) {
-    dir->_fetched(bl, want_dn);
-  }
-};
-
 void CDir::fetch(Context *c, bool ignore_authpinnability)
 {
   string want;
@@ -1346,8 +1337,29 @@ void CDir::fetch(Context *c, const string& want_dn, bool ignore_authpinnability)
 
   if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_f);
 
+  if (g_conf->mds_use_tmap)
+    _tmap_fetch(want_dn);
+  else
+    _omap_fetch(want_dn, string());
+}
+
+class C_Dir_TMAP_Fetched : public Context {
+ protected:
+  CDir *dir;
+  string want_dn;
+ public:
+  bufferlist bl;
+
+  C_Dir_TMAP_Fetched(CDir *d, const string& w) : dir(d), want_dn(w) { }
+  void finish(int result) {
+    dir->_tmap_fetched(bl, want_dn);
+  }
+};
+
+void CDir::_tmap_fetch(const string& want_dn)
+{
   // start by reading the first hunk of it
-  C_Dir_Fetch *fin = new C_Dir_Fetch(this, want_dn);
+  C_Dir_TMAP_Fetched *fin = new C_Dir_TMAP_Fetched(this, want_dn);
   object_t oid = get_ondisk_object();
   object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
   ObjectOperation rd;
@@ -1355,10 +1367,161 @@ void CDir::fetch(Context *c, const string& want_dn, bool ignore_authpinnability)
   cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
 }
 
-void CDir::_fetched(bufferlist &bl, const string& want_dn)
+class C_Dir_OMAP_Fetched : public Context {
+ public:
+  CDir::omap_chunk_t *chunk;
+  int ret1, ret2;
+
+  C_Dir_OMAP_Fetched(CDir *d, const string& w, const string& s) :
+    chunk(new CDir::omap_chunk_t(d, w, s)), ret1(0), ret2(0) { }
+  void finish(int r) {
+    if (r >= 0) r = ret1;
+    if (r >= 0) r = ret2;
+    chunk->r = r;
+    MDCache *cache = chunk->dir->cache;
+    if (r >= 0 && cache->fetch_decode_offload(chunk->omap.size())) {
+      // decode the dentries without holding mds_lock
+      cache->fetch_wq.queue(chunk);
+    } else {
+      chunk->dir->_omap_fetched(chunk);
+      delete chunk;
+    }
+  }
+};
+
+/**
+ * Read the next chunk of an omap dirfrag.
+ *
+ * The fnode lives in the omap header; dentries are read at most
+ * mds_dir_keys_per_op at a time so that a huge directory never has to
+ * be pulled over in a single message.
+ */
+void CDir::_omap_fetch(const string& want_dn, const string& start_after)
+{
+  C_Dir_OMAP_Fetched *fin = new C_Dir_OMAP_Fetched(this, want_dn, start_after);
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
+  ObjectOperation rd;
+  rd.omap_get_header(&fin->chunk->hdrbl, &fin->ret1);
+  rd.omap_get_vals(start_after, "", g_conf->mds_dir_keys_per_op, &fin->chunk->omap, &fin->ret2);
+  cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
+}
+
+class C_Dir_OMAP_FetchedKeys : public Context {
+ protected:
+  CDir *dir;
+  set<string> keys;
+  Context *fin;
+ public:
+  bufferlist hdrbl;
+  map<string, bufferlist> omap;
+  int ret1, ret2;
+
+  C_Dir_OMAP_FetchedKeys(CDir *d, const set<string>& k, Context *c) :
+    dir(d), keys(k), fin(c), ret1(0), ret2(0) { }
+  void finish(int r) {
+    if (r >= 0) r = ret1;
+    if (r >= 0) r = ret2;
+    dir->_omap_fetched_keys(hdrbl, omap, keys, fin, r);
+  }
+};
+
+/**
+ * fetch_keys -- load only the given dentry keys (plus the fnode)
+ *
+ * Used on a lookup miss in an incomplete omap dirfrag, so that we don't
+ * have to read the whole directory to find (or rule out) one name.  With
+ * an empty key set this just probes the on-disk format.  Legacy tmap
+ * objects fall back to a full fetch.
+ */
+void CDir::fetch_keys(Context *c, const set<string>& keys)
+{
+  dout(10) << "fetch_keys " << keys << " on " << *this << dendl;
+
+  assert(is_auth());
+  assert(!is_complete());
+  assert(!g_conf->mds_use_tmap);
+
+  if (!can_auth_pin()) {
+    dout(7) << "fetch_keys waiting for authpinnable" << dendl;
+    add_waiter(WAIT_UNFREEZE, c);
+    return;
+  }
+
+  // a full fetch is already on its way; just wait for that.
+  if (state_test(CDir::STATE_FETCHING)) {
+    dout(7) << "already fetching; waiting" << dendl;
+    if (c) add_waiter(WAIT_COMPLETE, c);
+    return;
+  }
+
+  auth_pin(this);
+  if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_fk);
+
+  C_Dir_OMAP_FetchedKeys *fin = new C_Dir_OMAP_FetchedKeys(this, keys, c);
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
+  ObjectOperation rd;
+  rd.omap_get_header(&fin->hdrbl, &fin->ret1);
+  rd.omap_get_vals_by_keys(keys, &fin->omap, &fin->ret2);
+  cache->mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, fin);
+}
+
+/**
+ * Decode the fnode stored as the dirfrag header, and adopt it if we are
+ * a fresh CDir with no prior state.
+ */
+bool CDir::_decode_fnode(bufferlist& hdrbl, fnode_t *got_fnode)
+{
+  bufferlist::iterator hp = hdrbl.begin();
+  try {
+    ::decode(*got_fnode, hp);
+  } catch (const buffer::error &err) {
+    derr << "Corrupt fnode header in " << dirfrag() << ": " << err.what() << dendl;
+    return false;
+  }
+
+  // take the loaded fnode?
+  // only if we are a fresh CDir* with no prior state.
+  if (get_version() == 0) {
+    assert(!is_projected());
+    assert(!state_test(STATE_COMMITTING));
+    fnode = *got_fnode;
+    projected_version = committing_version = committed_version = got_fnode->version;
+
+    if (state_test(STATE_REJOINUNDEF)) {
+      assert(cache->mds->is_rejoin());
+      state_clear(STATE_REJOINUNDEF);
+      cache->opened_undef_dirfrag(this);
+    }
+  }
+  return true;
+}
+
+/**
+ * purge stale snaps?
+ *  * only if we have past_parents open!
+ */
+const set<snapid_t> *CDir::_get_purge_snaps()
+{
+  SnapRealm *realm = inode->find_snaprealm();
+  if (!realm->have_past_parents_open()) {
+    dout(10) << " no snap purge, one or more past parents NOT open" << dendl;
+    return 0;
+  }
+  if (fnode.snap_purged_thru < realm->get_last_destroyed()) {
+    dout(10) << " snap_purged_thru " << fnode.snap_purged_thru
+	     << " < " << realm->get_last_destroyed()
+	     << ", snap purge based on " << realm->get_snaps() << dendl;
+    return &realm->get_snaps();
+  }
+  return 0;
+}
+
+void CDir::_tmap_fetched(bufferlist &bl, const string& want_dn)
 {
   LogClient &clog = cache->mds->clog;
-  dout(10) << "_fetched " << bl.length() 
+  dout(10) << "_tmap_fetched " << bl.length() 
 	   << " bytes for " << *this
 	   << " want_dn=" << want_dn
 	   << dendl;
@@ -1368,7 +1531,7 @@ void CDir::_fetched(bufferlist &bl, const string& want_dn)
 
   // empty?!?
   if (bl.length() == 0) {
-    dout(0) << "_fetched missing object for " << *this << dendl;
+    dout(0) << "_tmap_fetched missing object for " << *this << dendl;
     clog.error() << "dir " << ino() << "." << dirfrag()
 	  << " object missing on disk; some files may be lost\n";
 
@@ -1390,252 +1553,391 @@ void CDir::_fetched(bufferlist &bl, const string& want_dn)
   
   bufferlist header;
   ::decode(header, p);
-  bufferlist::iterator hp = header.begin();
   fnode_t got_fnode;
-  ::decode(got_fnode, hp);
+  bool ok = _decode_fnode(header, &got_fnode);
+  assert(ok);
 
   __u32 n;
   ::decode(n, p);
 
-  dout(10) << "_fetched version " << got_fnode.version
+  dout(10) << "_tmap_fetched version " << got_fnode.version
 	   << ", " << len << " bytes, " << n << " keys"
 	   << dendl;
-  
 
-  // take the loaded fnode?
-  // only if we are a fresh CDir* with no prior state.
-  if (get_version() == 0) {
-    assert(!is_projected());
-    assert(!state_test(STATE_COMMITTING));
-    fnode = got_fnode;
-    projected_version = committing_version = committed_version = got_fnode.version;
+  const set<snapid_t> *snaps = _get_purge_snaps();
+  bool purged_any = false;
 
-    if (state_test(STATE_REJOINUNDEF)) {
-      assert(cache->mds->is_rejoin());
-      state_clear(STATE_REJOINUNDEF);
-      cache->opened_undef_dirfrag(this);
+  //int num_new_inodes_loaded = 0;
+  for (unsigned i=0; i<n; i++) {
+    string key;
+    ::decode(key, p);
+    bufferlist dndata;
+    ::decode(dndata, p);
+
+    bool stale;
+    _load_dentry(key, dndata, snaps, want_dn, got_fnode.version, &stale);
+    if (stale)
+      purged_any = true;
+  }
+  if (!p.end()) {
+    clog.warn() << "dir " << dirfrag() << " has "
+	<< bl.length() - p.get_off() << " extra bytes\n";
+  }
+
+  //cache->mds->logger->inc("newin", num_new_inodes_loaded);
+  //hack_num_accessed = 0;
+
+  if (snaps)
+    fnode.snap_purged_thru = inode->find_snaprealm()->get_last_destroyed();
+  if (purged_any)
+    log_mark_dirty();
+
+  // mark complete, !fetching
+  state_set(STATE_COMPLETE);
+  state_clear(STATE_FETCHING);
+  auth_unpin(this);
+
+  // kick waiters
+  finish_waiting(WAIT_COMPLETE, 0);
+}
+
+void CDir::_omap_fetched(omap_chunk_t *chunk)
+{
+  LogClient &clog = cache->mds->clog;
+  bufferlist& hdrbl = chunk->hdrbl;
+  map<string, bufferlist>& omap = chunk->omap;
+  const string& want_dn = chunk->want_dn;
+  const string& start_after = chunk->start_after;
+  int r = chunk->r;
+  dout(10) << "_omap_fetched " << omap.size() << " keys after '" << start_after
+	   << "' for " << *this << " want_dn=" << want_dn << " r=" << r
+	   << (chunk->decoded ? " (predecoded)" : "") << dendl;
+
+  assert(is_auth());
+  assert(!is_frozen());
+
+  if (r < 0 || hdrbl.length() == 0) {
+    if (start_after.length()) {
+      // the header vanished between chunks; the dir was removed under us.
+      dout(0) << "_omap_fetched header went missing for " << *this << dendl;
+      clog.error() << "dir " << ino() << "." << dirfrag()
+		   << " omap header missing mid-fetch; some files may be lost\n";
+      log_mark_dirty();
+      state_set(STATE_COMPLETE);
+      state_clear(STATE_FETCHING);
+      auth_unpin(this);
+      finish_waiting(WAIT_COMPLETE, 0);
+      return;
     }
+    // no omap header: this is a legacy tmap object (or it is missing
+    // entirely, which _tmap_fetched will notice).
+    dout(10) << "_omap_fetched no omap header, trying tmap" << dendl;
+    _tmap_fetch(want_dn);
+    return;
   }
 
-  // purge stale snaps?
-  //  * only if we have past_parents open!
-  const set<snapid_t> *snaps = 0;
-  SnapRealm *realm = inode->find_snaprealm();
-  if (!realm->have_past_parents_open()) {
-    dout(10) << " no snap purge, one or more past parents NOT open" << dendl;
-  } else if (fnode.snap_purged_thru < realm->get_last_destroyed()) {
-    snaps = &realm->get_snaps();
-    dout(10) << " snap_purged_thru " << fnode.snap_purged_thru
-	     << " < " << realm->get_last_destroyed()
-	     << ", snap purge based on " << *snaps << dendl;
-    fnode.snap_purged_thru = realm->get_last_destroyed();
+  fnode_t got_fnode;
+  if (!_decode_fnode(hdrbl, &got_fnode)) {
+    clog.error() << "dir " << ino() << "." << dirfrag()
+		 << " has a corrupt fnode header\n";
+    assert(0);
   }
-  bool purged_any = false;
+  state_set(STATE_OMAP);
+
+  const set<snapid_t> *snaps = _get_purge_snaps();
+  unsigned num_stale = stale_items.size();
+  string last_key;
+  if (chunk->decoded) {
+    for (vector<dentry_rec_t>::iterator p = chunk->recs.begin(); p != chunk->recs.end(); ++p) {
+      bool stale;
+      _load_dentry(*p, snaps, want_dn, got_fnode.version, &stale);
+      if (stale)
+	stale_items.insert(p->key);
+    }
+    if (!omap.empty())
+      last_key = omap.rbegin()->first;
+  } else {
+    for (map<string, bufferlist>::iterator p = omap.begin(); p != omap.end(); ++p) {
+      bool stale;
+      _load_dentry(p->first, p->second, snaps, want_dn, got_fnode.version, &stale);
+      if (stale)
+	stale_items.insert(p->first);
+      last_key = p->first;
+    }
+  }
+  if (stale_items.size() > num_stale)
+    log_mark_dirty();  // so that the stale keys get removed
 
+  if (omap.size() >= (unsigned)g_conf->mds_dir_keys_per_op) {
+    // there may be more; keep going.
+    _omap_fetch(want_dn, last_key);
+    return;
+  }
 
-  //int num_new_inodes_loaded = 0;
-  loff_t baseoff = p.get_off();
-  for (unsigned i=0; i<n; i++) {
-    loff_t dn_offset = p.get_off() - baseoff;
+  // mark complete, !fetching
+  state_set(STATE_COMPLETE);
+  state_clear(STATE_FETCHING);
+  auth_unpin(this);
 
-    // dname
-    string dname;
-    snapid_t first, last;
-    dentry_key_t::decode_helper(p, dname, last);
-    
-    bufferlist dndata;
-    ::decode(dndata, p);
-    bufferlist::iterator q = dndata.begin();
-    ::decode(first, q);
-
-    // marker
-    char type;
-    ::decode(type, q);
-
-    dout(24) << "_fetched pos " << dn_offset << " marker '" << type << "' dname '" << dname
-	     << " [" << first << "," << last << "]"
-	     << dendl;
-
-    bool stale = false;
-    if (snaps && last != CEPH_NOSNAP) {
-      set<snapid_t>::const_iterator p = snaps->lower_bound(first);
-      if (p == snaps->end() || *p > last) {
-	dout(10) << " skipping stale dentry on [" << first << "," << last << "]" << dendl;
-	stale = true;
-	purged_any = true;
+  // kick waiters
+  finish_waiting(WAIT_COMPLETE, 0);
+}
+
+void CDir::_omap_fetched_keys(bufferlist& hdrbl, map<string, bufferlist>& omap,
+			      const set<string>& keys, Context *c, int r)
+{
+  dout(10) << "_omap_fetched_keys " << omap.size() << " of " << keys.size()
+	   << " keys for " << *this << " r=" << r << dendl;
+
+  assert(is_auth());
+  auth_unpin(this);
+
+  if (r < 0 || hdrbl.length() == 0) {
+    // legacy tmap (or missing) object; there is no cheap way to read
+    // part of it.
+    dout(10) << "_omap_fetched_keys no omap header, doing a full fetch" << dendl;
+    if (is_complete()) {
+      if (c) cache->mds->queue_waiter(c);
+    } else {
+      fetch(c);
+    }
+    return;
+  }
+
+  fnode_t got_fnode;
+  if (!_decode_fnode(hdrbl, &got_fnode)) {
+    cache->mds->clog.error() << "dir " << ino() << "." << dirfrag()
+			     << " has a corrupt fnode header\n";
+    assert(0);
+  }
+  state_set(STATE_OMAP);
+
+  if (!is_complete()) {
+    const set<snapid_t> *snaps = _get_purge_snaps();
+    for (set<string>::const_iterator p = keys.begin(); p != keys.end(); ++p) {
+      string dname;
+      snapid_t last;
+      dentry_key_t::decode_helper(*p, dname, last);
+
+      map<string, bufferlist>::iterator q = omap.find(*p);
+      if (q != omap.end()) {
+	bool stale;
+	_load_dentry(q->first, q->second, snaps, dname, got_fnode.version, &stale);
+	if (stale)
+	  stale_items.insert(q->first);
+      } else if (last == CEPH_NOSNAP && !lookup(dname, last) && !is_frozen()) {
+	// remember the miss so the retried lookup can conclude ENOENT.
+	CDentry *dn = add_null_dentry(dname);
+	dout(12) << "_omap_fetched_keys  added null " << *dn << dendl;
       }
     }
-    
-    /*
-     * look for existing dentry for _last_ snap, because unlink +
-     * create may leave a "hole" (epochs during which the dentry
-     * doesn't exist) but for which no explicit negative dentry is in
-     * the cache.
-     */
-    CDentry *dn = 0;
-    if (!stale)
-      dn = lookup(dname, last);
+  }
+
+  if (c)
+    cache->mds->queue_waiter(c);
+}
 
-    if (type == 'L') {
-      // hard link
-      inodeno_t ino;
-      unsigned char d_type;
-      ::decode(ino, q);
-      ::decode(d_type, q);
+/**
+ * Decode one on-disk dentry record (the same encoding is used for tmap
+ * values and omap values).  This touches no cache state, so it is safe
+ * to call without mds_lock.
+ */
+void CDir::_decode_dentry(const string& key, bufferlist& bl, dentry_rec_t& rec)
+{
+  bufferlist::iterator q = bl.begin();
 
-      if (stale)
-	continue;
-
-      if (dn) {
-        if (dn->get_linkage()->get_inode() == 0) {
-          dout(12) << "_fetched  had NEG dentry " << *dn << dendl;
-        } else {
-          dout(12) << "_fetched  had dentry " << *dn << dendl;
-        }
+  rec.key = key;
+  dentry_key_t::decode_helper(key, rec.dname, rec.last);
+  ::decode(rec.first, q);
+  ::decode(rec.type, q);
+
+  if (rec.type == 'L') {
+    ::decode(rec.ino, q);
+    ::decode(rec.d_type, q);
+  } else if (rec.type == 'I') {
+    ::decode(rec.inode, q);
+    if (rec.inode.is_symlink())
+      ::decode(rec.symlink, q);
+    ::decode(rec.fragtree, q);
+    ::decode(rec.xattrs, q);
+    ::decode(rec.snapbl, q);
+    ::decode(rec.old_inodes, q);
+  }
+  // anything else is corrupt; _load_dentry will complain.
+}
+
+CDentry *CDir::_load_dentry(const string& key, bufferlist& bl, const set<snapid_t> *snaps,
+			    const string& want_dn, version_t ondisk_version, bool *stale)
+{
+  dentry_rec_t rec;
+  _decode_dentry(key, bl, rec);
+  return _load_dentry(rec, snaps, want_dn, ondisk_version, stale);
+}
+
+/**
+ * Instantiate one decoded dentry record.
+ *
+ * @param stale [out] set if the record belongs only to purged snaps
+ * @return the dentry, or NULL if it was stale or a duplicate
+ */
+CDentry *CDir::_load_dentry(dentry_rec_t& rec, const set<snapid_t> *snaps,
+			    const string& want_dn, version_t ondisk_version, bool *stale)
+{
+  LogClient &clog = cache->mds->clog;
+
+  const string& dname = rec.dname;
+  snapid_t first = rec.first, last = rec.last;
+  char type = rec.type;
+
+  dout(24) << "_load_dentry marker '" << type << "' dname '" << dname
+	   << " [" << first << "," << last << "]"
+	   << dendl;
+
+  *stale = false;
+  if (snaps && last != CEPH_NOSNAP) {
+    set<snapid_t>::const_iterator p = snaps->lower_bound(first);
+    if (p == snaps->end() || *p > last) {
+      dout(10) << " skipping stale dentry on [" << first << "," << last << "]" << dendl;
+      *stale = true;
+    }
+  }
+    
+  /*
+   * look for existing dentry for _last_ snap, because unlink +
+   * create may leave a "hole" (epochs during which the dentry
+   * doesn't exist) but for which no explicit negative dentry is in
+   * the cache.
+   */
+  CDentry *dn = 0;
+  if (!*stale)
+    dn = lookup(dname, last);
+
+  if (type == 'L') {
+    // hard link
+    inodeno_t ino = rec.ino;
+    unsigned char d_type = rec.d_type;
+
+    if (*stale)
+      return 0;
+
+    if (dn) {
+      if (dn->get_linkage()->get_inode() == 0) {
+	dout(12) << "_load_dentry  had NEG dentry " << *dn << dendl;
       } else {
-	// (remote) link
-	dn = add_remote_dentry(dname, ino, d_type, first, last);
+	dout(12) << "_load_dentry  had dentry " << *dn << dendl;
+      }
+    } else {
+      // (remote) link
+      dn = add_remote_dentry(dname, ino, d_type, first, last);
 	
-	// link to inode?
-	CInode *in = cache->get_inode(ino);   // we may or may not have it.
-	if (in) {
-	  dn->link_remote(dn->get_linkage(), in);
-	  dout(12) << "_fetched  got remote link " << ino << " which we have " << *in << dendl;
-	} else {
-	  dout(12) << "_fetched  got remote link " << ino << " (dont' have it)" << dendl;
-	}
+      // link to inode?
+      CInode *in = cache->get_inode(ino);   // we may or may not have it.
+      if (in) {
+	dn->link_remote(dn->get_linkage(), in);
+	dout(12) << "_load_dentry  got remote link " << ino << " which we have " << *in << dendl;
+      } else {
+	dout(12) << "_load_dentry  got remote link " << ino << " (dont' have it)" << dendl;
       }
-    } 
-    else if (type == 'I') {
-      // inode
-      
-      // parse out inode
-      inode_t inode;
-      string symlink;
-      fragtree_t fragtree;
-      map<string, bufferptr> xattrs;
-      bufferlist snapbl;
-      map<snapid_t,old_inode_t> old_inodes;
-      ::decode(inode, q);
-      if (inode.is_symlink())
-        ::decode(symlink, q);
-      ::decode(fragtree, q);
-      ::decode(xattrs, q);
-      ::decode(snapbl, q);
-      ::decode(old_inodes, q);
+    }
+  } 
+  else if (type == 'I') {
+    // inode
+    inode_t& inode = rec.inode;
       
-      if (stale)
-	continue;
-
-      if (dn) {
-        if (dn->get_linkage()->get_inode() == 0) {
-          dout(12) << "_fetched  had NEG dentry " << *dn << dendl;
-        } else {
-          dout(12) << "_fetched  had dentry " << *dn << dendl;
-        }
+    if (*stale)
+      return 0;
+
+    if (dn) {
+      if (dn->get_linkage()->get_inode() == 0) {
+	dout(12) << "_load_dentry  had NEG dentry " << *dn << dendl;
       } else {
-	// add inode
-	CInode *in = 0;
-	if (cache->have_inode(inode.ino, last)) {
-	  in = cache->get_inode(inode.ino, last);
-	  dout(0) << "_fetched  badness: got (but i already had) " << *in
-		  << " mode " << in->inode.mode
-		  << " mtime " << in->inode.mtime << dendl;
-	  string dirpath, inopath;
-	  this->inode->make_path_string(dirpath);
-	  in->make_path_string(inopath);
-	  clog.error() << "loaded dup inode " << inode.ino
-	    << " [" << first << "," << last << "] v" << inode.version
-	    << " at " << dirpath << "/" << dname
-	    << ", but inode " << in->vino() << " v" << in->inode.version
-	    << " already exists at " << inopath << "\n";
-	  continue;
-	} else {
-	  // inode
-	  in = new CInode(cache, true, first, last);
-	  in->inode = inode;
+	dout(12) << "_load_dentry  had dentry " << *dn << dendl;
+      }
+    } else {
+      // add inode
+      CInode *in = 0;
+      if (cache->have_inode(inode.ino, last)) {
+	in = cache->get_inode(inode.ino, last);
+	dout(0) << "_load_dentry  badness: got (but i already had) " << *in
+		<< " mode " << in->inode.mode
+		<< " mtime " << in->inode.mtime << dendl;
+	string dirpath, inopath;
+	this->inode->make_path_string(dirpath);
+	in->make_path_string(inopath);
+	clog.error() << "loaded dup inode " << inode.ino
+		     << " [" << first << "," << last << "] v" << inode.version
+		     << " at " << dirpath << "/" << dname
+		     << ", but inode " << in->vino() << " v" << in->inode.version
+		     << " already exists at " << inopath << "\n";
+	return 0;
+      } else {
+	// inode
+	in = new CInode(cache, true, first, last);
+	in->inode = inode;
 	  
-	  // symlink?
-	  if (in->is_symlink()) 
-	    in->symlink = symlink;
+	// symlink?
+	if (in->is_symlink()) 
+	  in->symlink = rec.symlink;
 	  
-	  in->dirfragtree.swap(fragtree);
-	  in->xattrs.swap(xattrs);
-	  in->decode_snap_blob(snapbl);
-	  in->old_inodes.swap(old_inodes);
-	  if (snaps)
-	    in->purge_stale_snap_data(*snaps);
-
-	  // add 
-	  cache->add_inode( in );
+	in->dirfragtree.swap(rec.fragtree);
+	in->xattrs.swap(rec.xattrs);
+	in->decode_snap_blob(rec.snapbl);
+	in->old_inodes.swap(rec.old_inodes);
+	if (snaps)
+	  in->purge_stale_snap_data(*snaps);
+
+	// add 
+	cache->add_inode( in );
 	
-	  // link
-	  dn = add_primary_dentry(dname, in, first, last);
-	  dout(12) << "_fetched  got " << *dn << " " << *in << dendl;
+	// link
+	dn = add_primary_dentry(dname, in, first, last);
+	dout(12) << "_load_dentry  got " << *dn << " " << *in << dendl;
 
-	  if (in->inode.is_dirty_rstat())
-	    in->mark_dirty_rstat();
+	if (in->inode.is_dirty_rstat())
+	  in->mark_dirty_rstat();
 
-	  //in->hack_accessed = false;
-	  //in->hack_load_stamp = ceph_clock_now(g_ceph_context);
-	  //num_new_inodes_loaded++;
-	}
+	//in->hack_accessed = false;
+	//in->hack_load_stamp = ceph_clock_now(g_ceph_context);
+	//num_new_inodes_loaded++;
       }
-    } else {
-      dout(1) << "corrupt directory, i got tag char '" << type << "' val " << (int)(type)
-	      << " at offset " << p.get_off() << dendl;
-      assert(0);
     }
+  } else {
+    dout(1) << "corrupt directory, i got tag char '" << type << "' val " << (int)(type)
+	    << " for key " << rec.key << dendl;
+    assert(0);
+  }
     
-    if (dn && want_dn.length() && want_dn == dname) {
-      dout(10) << " touching wanted dn " << *dn << dendl;
-      inode->mdcache->touch_dentry(dn);
-    }
-
-    /** clean underwater item?
-     * Underwater item is something that is dirty in our cache from
-     * journal replay, but was previously flushed to disk before the
-     * mds failed.
-     *
-     * We only do this is committed_version == 0. that implies either
-     * - this is a fetch after from a clean/empty CDir is created
-     *   (and has no effect, since the dn won't exist); or
-     * - this is a fetch after _recovery_, which is what we're worried 
-     *   about.  Items that are marked dirty from the journal should be
-     *   marked clean if they appear on disk.
-     */
-    if (committed_version == 0 &&     
-	dn &&
-	dn->get_version() <= got_fnode.version &&
-	dn->is_dirty()) {
-      dout(10) << "_fetched  had underwater dentry " << *dn << ", marking clean" << dendl;
-      dn->mark_clean();
+  if (dn && want_dn.length() && want_dn == dname) {
+    dout(10) << " touching wanted dn " << *dn << dendl;
+    inode->mdcache->touch_dentry(dn);
+  }
+
+  /** clean underwater item?
+   * Underwater item is something that is dirty in our cache from
+   * journal replay, but was previously flushed to disk before the
+   * mds failed.
+   *
+   * We only do this is committed_version == 0. that implies either
+   * - this is a fetch after from a clean/empty CDir is created
+   *   (and has no effect, since the dn won't exist); or
+   * - this is a fetch after _recovery_, which is what we're worried 
+   *   about.  Items that are marked dirty from the journal should be
+   *   marked clean if they appear on disk.
+   */
+  if (committed_version == 0 &&     
+      dn &&
+      dn->get_version() <= ondisk_version &&
+      dn->is_dirty()) {
+    dout(10) << "_load_dentry  had underwater dentry " << *dn << ", marking clean" << dendl;
+    dn->mark_clean();
 
-      if (dn->get_linkage()->get_inode()) {
-	assert(dn->get_linkage()->get_inode()->get_version() <= got_fnode.version);
-	dout(10) << "_fetched  had underwater inode " << *dn->get_linkage()->get_inode() << ", marking clean" << dendl;
-	dn->get_linkage()->get_inode()->mark_clean();
-      }
+    if (dn->get_linkage()->get_inode()) {
+      assert(dn->get_linkage()->get_inode()->get_version() <= ondisk_version);
+      dout(10) << "_load_dentry  had underwater inode " << *dn->get_linkage()->get_inode() << ", marking clean" << dendl;
+      dn->get_linkage()->get_inode()->mark_clean();
     }
   }
-  if (!p.end()) {
-    clog.warn() << "dir " << dirfrag() << " has "
-	<< bl.length() - p.get_off() << " extra bytes\n";
-  }
-
-  //cache->mds->logger->inc("newin", num_new_inodes_loaded);
-  //hack_num_accessed = 0;
-
-  if (purged_any)
-    log_mark_dirty();
-
-  // mark complete, !fetching
-  state_set(STATE_COMPLETE);
-  state_clear(STATE_FETCHING);
-  auth_unpin(this);
-
-  // kick waiters
-  finish_waiting(WAIT_COMPLETE, 0);
+  return dn;
 }
 
 
@@ -1816,14 +2118,22 @@ CDir::map_t::iterator CDir::_commit_partial(ObjectOperation& m,
 void CDir::_encode_dentry(CDentry *dn, bufferlist& bl,
 			  const set<snapid_t> *snaps)
 {
-  // clear dentry NEW flag, if any.  we can no longer silently drop it.
-  dn->clear_new();
-
   dn->key().encode(bl);
 
-  ceph_le32 plen = init_le32(0);
-  unsigned plen_off = bl.length();
-  ::encode(plen, bl);
+  bufferlist dnbl;
+  _encode_dentry_value(dn, dnbl, snaps);
+  ::encode(dnbl, bl);
+}
+
+/**
+ * Encode the on-disk value for a dentry: the tmap value for
+ * _encode_dentry, or the omap value keyed by dentry_key_t.
+ */
+void CDir::_encode_dentry_value(CDentry *dn, bufferlist& bl,
+				const set<snapid_t> *snaps)
+{
+  // clear dentry NEW flag, if any.  we can no longer silently drop it.
+  dn->clear_new();
 
   ::encode(dn->first, bl);
 
@@ -1831,7 +2141,7 @@ void CDir::_encode_dentry(CDentry *dn, bufferlist& bl,
   if (dn->linkage.is_remote()) {
     inodeno_t ino = dn->linkage.get_remote_ino();
     unsigned char d_type = dn->linkage.get_remote_d_type();
-    dout(14) << " pos " << bl.length() << " dn '" << dn->name << "' remote ino " << ino << dendl;
+    dout(14) << " dn '" << dn->name << "' remote ino " << ino << dendl;
     
     // marker, name, ino
     bl.append('L');         // remote link
@@ -1842,7 +2152,7 @@ void CDir::_encode_dentry(CDentry *dn, bufferlist& bl,
     CInode *in = dn->linkage.get_inode();
     assert(in);
     
-    dout(14) << " pos " << bl.length() << " dn '" << dn->name << "' inode " << *in << dendl;
+    dout(14) << " dn '" << dn->name << "' inode " << *in << dendl;
     
     // marker, name, inode, [symlink string]
     bl.append('I');         // inode
@@ -1864,12 +2174,120 @@ void CDir::_encode_dentry(CDentry *dn, bufferlist& bl,
       in->purge_stale_snap_data(*snaps);
     ::encode(in->old_inodes, bl);
   }
-  
-  plen = bl.length() - plen_off - sizeof(__u32);
+}
+
+/**
+ * Write out an omap dirfrag.
+ *
+ * Normally only dirty dentries are written (and null or purged ones
+ * removed).  If we don't know that the object is already in omap format
+ * (a legacy tmap object, or a new fragment) we write the complete
+ * contents instead.  Either way the fnode header goes out in the last
+ * op, so that a partially applied commit is never mistaken for a
+ * complete one: see the comment in _commit.
+ */
+void CDir::_omap_commit(const set<snapid_t> *snaps)
+{
+  bool full = !state_test(STATE_OMAP) || state_test(STATE_FRAGMENTING);
+  dout(10) << "_omap_commit " << (full ? "full" : "partial") << dendl;
+  assert(!full || is_complete());
+
+  SnapContext snapc;
+  object_t oid = get_ondisk_object();
+  object_locator_t oloc(cache->mds->mdsmap->get_metadata_pg_pool());
+
+  ObjectOperation m;
+  m.priority = CEPH_MSG_PRIO_LOW;  // set priority lower than journal!
+  unsigned max_write_size = cache->max_dir_commit_size;
+  max_write_size -= inode->encode_parent_mutation(m);
+
+  C_GatherBuilder gather(g_ceph_context,
+			 new C_Dir_Committed(this, get_version(),
+					     inode->inode.last_renamed_version));
+
+  map<string, bufferlist> to_set;
+  set<string> to_remove;
+  unsigned write_size = 0;
+  bool cleared = !full;
+
+  if (!full)
+    to_remove.swap(stale_items);
+  else
+    stale_items.clear();
+
+  map_t::iterator p = items.begin();
+  while (p != items.end()) {
+    CDentry *dn = p->second;
+    ++p;
+
+    string key;
+    dn->key().encode(key);
+
+    if (snaps && dn->last != CEPH_NOSNAP &&
+	try_trim_snap_dentry(dn, *snaps)) {
+      if (!full)
+	to_remove.insert(key);
+      continue;
+    }
+
+    if (!full && !dn->is_dirty())
+      continue;  // skip clean dentries
+
+    if (dn->get_linkage()->is_null()) {
+      if (!full) {
+	dout(10) << " rm " << dn->name << " " << *dn << dendl;
+	write_size += key.length();
+	to_remove.insert(key);
+      }
+    } else {
+      dout(10) << " set " << dn->name << " " << *dn << dendl;
+      bufferlist &bl = to_set[key];
+      _encode_dentry_value(dn, bl, snaps);
+      write_size += key.length() + bl.length();
+    }
 
-  ceph_le32 eplen;
-  eplen = plen;
-  bl.copy_in(plen_off, sizeof(eplen), (char*)&eplen);
+    if (write_size >= max_write_size) {
+      ObjectOperation op;
+      op.priority = CEPH_MSG_PRIO_LOW;
+      if (!cleared) {
+	op.create(false);
+	op.omap_clear();
+	cleared = true;
+      }
+      if (!to_set.empty())
+	op.omap_set(to_set);
+      if (!to_remove.empty())
+	op.omap_rm_keys(to_remove);
+      cache->mds->objecter->mutate(oid, oloc, op, snapc, ceph_clock_now(g_ceph_context),
+				   0, NULL, gather.new_sub());
+      to_set.clear();
+      to_remove.clear();
+      write_size = 0;
+    }
+  }
+
+  // final op: remaining keys, the header, and (if converting) the old tmap data.
+  if (!cleared) {
+    m.create(false);
+    m.omap_clear();
+  }
+  if (full) {
+    fnode.snap_purged_thru = inode->find_snaprealm()->get_last_destroyed();
+    m.truncate(0);
+  }
+  if (!to_set.empty())
+    m.omap_set(to_set);
+  if (!to_remove.empty())
+    m.omap_rm_keys(to_remove);
+  bufferlist header;
+  ::encode(fnode, header);
+  m.omap_set_header(header);
+
+  cache->mds->objecter->mutate(oid, oloc, m, snapc, ceph_clock_now(g_ceph_context),
+			       0, NULL, gather.new_sub());
+  gather.activate();
+
+  state_set(STATE_OMAP);
 }
 
 
@@ -1902,11 +2320,13 @@ void CDir::_commit(version_t want)
     return;
   }
   
-  // complete first?  (only if we're not using TMAPUP osd op)
-  if (!g_conf->mds_use_tmap && !is_complete()) {
-    dout(7) << "commit not complete, fetching first" << dendl;
+  // an omap dirfrag can only be updated in place once we know the
+  // object is in omap format; otherwise we need to write it out in full,
+  // which requires the complete contents.  probe the object first.
+  if (!g_conf->mds_use_tmap && !state_test(STATE_OMAP) && !is_complete()) {
+    dout(7) << "commit on-disk format unknown, probing first" << dendl;
     if (cache->mds->logger) cache->mds->logger->inc(l_mds_dir_ffc);
-    fetch(new C_Dir_RetryCommit(this, want));
+    fetch_keys(new C_Dir_RetryCommit(this, want), set<string>());
     return;
   }
   
@@ -1923,14 +2343,11 @@ void CDir::_commit(version_t want)
 
   // snap purge?
   SnapRealm *realm = inode->find_snaprealm();
-  const set<snapid_t> *snaps = 0;
-  if (!realm->have_past_parents_open()) {
-    dout(10) << " no snap purge, one or more past parents NOT open" << dendl;
-  } else if (fnode.snap_purged_thru < realm->get_last_destroyed()) {
-    snaps = &realm->get_snaps();
-    dout(10) << " snap_purged_thru " << fnode.snap_purged_thru
-	     << " < " << realm->get_last_destroyed()
-	     << ", snap purge based on " << *snaps << dendl;
+  const set<snapid_t> *snaps = _get_purge_snaps();
+
+  if (!g_conf->mds_use_tmap) {
+    _omap_commit(snaps);
+    return;
   }
 
   ObjectOperation m;
@@ -107,6 +107,7 @@ public:
   static const unsigned STATE_STICKY =        (1<<15);  // sticky pin due to inode stickydirs
   static const unsigned STATE_DNPINNEDFRAG =  (1<<16);  // dir is refragmenting
   static const unsigned STATE_ASSIMRSTAT =    (1<<17);  // assimilating inode->frag rstats
+  static const unsigned STATE_OMAP =          (1<<18);  // on-disk object is known to be omap
 
   // common states
   static const unsigned STATE_CLEAN =  0;
@@ -115,7 +116,7 @@ public:
   // these state bits are preserved by an import/export
   // ...except if the directory is hashed, in which case none of them are!
   static const unsigned MASK_STATE_EXPORTED = 
-  (STATE_COMPLETE|STATE_DIRTY);
+  (STATE_COMPLETE|STATE_DIRTY|STATE_OMAP);
   static const unsigned MASK_STATE_IMPORT_KEPT = 
   (						  
    STATE_IMPORTING
@@ -473,7 +474,64 @@ private:
   }
   void fetch(Context *c, bool ignore_authpinnability=false);
   void fetch(Context *c, const string& want_dn, bool ignore_authpinnability=false);
-  void _fetched(bufferlist &bl, const string& want_dn);
+  void fetch_keys(Context *c, const set<string>& keys);
+  void _tmap_fetch(const string& want_dn);
+  void _tmap_fetched(bufferlist &bl, const string& want_dn);
+  void _omap_fetch(const string& want_dn, const string& start_after);
+
+  /// one on-disk dentry record, decoded but not yet in the cache
+  struct dentry_rec_t {
+    string key;
+    string dname;
+    snapid_t first, last;
+    char type;              // 'L' remote link, 'I' primary inode
+
+    // 'L'
+    inodeno_t ino;
+    unsigned char d_type;
+
+    // 'I'
+    inode_t inode;
+    string symlink;
+    fragtree_t fragtree;
+    map<string, bufferptr> xattrs;
+    bufferlist snapbl;
+    map<snapid_t,old_inode_t> old_inodes;
+
+    dentry_rec_t() : type(0), d_type(0) {}
+  };
+  static void _decode_dentry(const string& key, bufferlist& bl, dentry_rec_t& rec);
+
+  /**
+   * A chunk of an omap dirfrag as read from disk.  Big chunks are
+   * handed to MDCache::fetch_tp, which fills in recs without holding
+   * mds_lock before _omap_fetched instantiates them.
+   */
+  struct omap_chunk_t {
+    CDir *dir;
+    string want_dn, start_after;
+    int r;
+    bufferlist hdrbl;
+    map<string, bufferlist> omap;
+    vector<dentry_rec_t> recs;
+    bool decoded;
+
+    omap_chunk_t(CDir *d, const string& w, const string& s) :
+      dir(d), want_dn(w), start_after(s), r(0), decoded(false) {}
+  };
+  void _omap_fetched(omap_chunk_t *chunk);
+  void _omap_fetched_keys(bufferlist& hdrbl, map<string, bufferlist>& omap,
+			  const set<string>& keys, Context *c, int r);
+  bool _decode_fnode(bufferlist& hdrbl, fnode_t *got_fnode);
+  const set<snapid_t> *_get_purge_snaps();
+  CDentry *_load_dentry(const string& key, bufferlist& bl, const set<snapid_t> *snaps,
+			const string& want_dn, version_t ondisk_version, bool *stale);
+  CDentry *_load_dentry(dentry_rec_t& rec, const set<snapid_t> *snaps,
+			const string& want_dn, version_t ondisk_version, bool *stale);
+
+  /* keys of on-disk dentries that were skipped as stale while fetching
+   * an omap dirfrag; they are removed at the next commit. */
+  set<string> stale_items;
 
   // -- commit --
   map<version_t, list<Context*> > waiting_for_commit;
@@ -487,6 +545,8 @@ private:
                        unsigned max_write_size=-1,
                        map_t::iterator last_committed_dn=map_t::iterator());
   void _encode_dentry(CDentry *dn, bufferlist& bl, const set<snapid_t> *snaps);
+  void _encode_dentry_value(CDentry *dn, bufferlist& bl, const set<snapid_t> *snaps);
+  void _omap_commit(const set<snapid_t> *snaps);
   void _committed(version_t v, version_t last_renamed_version);
   void wait_for_commit(Context *c, version_t v=0);
 
@@ -351,6 +351,7 @@ void CInode::pop_and_dirty_projected_inode(LogSegment *ls)
   delete projected_nodes.front();
 
   projected_nodes.pop_front();
+  update_mem_charge();
 }
 
 sr_t *CInode::project_snaprealm(snapid_t snapid)
@@ -576,6 +577,7 @@ CDir *CInode::add_dirfrag(CDir *dir)
 {
   assert(dirfrags.count(dir->dirfrag().frag) == 0);
   dirfrags[dir->dirfrag().frag] = dir;
+  mdcache->adjust_cache_bytes(sizeof(CDir));
 
   if (stickydir_ref > 0) {
     dir->state_set(CDir::STATE_STICKY);
@@ -611,6 +613,7 @@ void CInode::close_dirfrag(frag_t fg)
   assert(dir->get_num_ref() == 0);
   delete dir;
   dirfrags.erase(fg);
+  mdcache->adjust_cache_bytes(-(int64_t)sizeof(CDir));
 }
 
 void CInode::close_dirfrags()
@@ -619,6 +622,66 @@ void CInode::close_dirfrags()
     close_dirfrag(dirfrags.begin()->first);
 }
 
+
+// -- memory accounting --
+
+/*
+ * A rough count of the bytes this inode pins: the object itself plus
+ * whatever hangs off it.  Dentries and dirfrags are charged by whoever
+ * creates them.
+ */
+uint64_t CInode::estimate_memory()
+{
+  // per-node overhead of a std::map/std::set entry, roughly
+  const uint64_t node = 48;
+
+  uint64_t b = sizeof(CInode) + symlink.length();
+  for (map<string,bufferptr>::iterator p = xattrs.begin(); p != xattrs.end(); ++p)
+    b += node + p->first.length() + p->second.length();
+  for (compact_map<snapid_t,old_inode_t>::iterator p = old_inodes.begin();
+       p != old_inodes.end();
+       ++p) {
+    b += node + sizeof(old_inode_t);
+    for (map<string,bufferptr>::iterator q = p->second.xattrs.begin();
+	 q != p->second.xattrs.end();
+	 ++q)
+      b += node + q->first.length() + q->second.length();
+  }
+  b += client_caps.size() * (node + sizeof(Capability));
+  b += (dirty_old_rstats.size() + remote_parents.size() +
+	mds_caps_wanted.size() + client_snap_caps.size() +
+	client_need_snapflush.size()) * node;
+  if (fcntl_locks)
+    b += sizeof(ceph_lock_state_t) + fcntl_locks->held_locks.size() * (node + sizeof(ceph_filelock));
+  if (flock_locks)
+    b += sizeof(ceph_lock_state_t) + flock_locks->held_locks.size() * (node + sizeof(ceph_filelock));
+  return b;
+}
+
+void CInode::charge_mem()
+{
+  assert(mem_charge == 0);
+  mem_charge = estimate_memory();
+  mdcache->adjust_cache_bytes(mem_charge);
+}
+
+void CInode::update_mem_charge()
+{
+  if (!mem_charge)
+    return;  // not in the cache (yet)
+  uint64_t b = estimate_memory();
+  mdcache->adjust_cache_bytes((int64_t)b - (int64_t)mem_charge);
+  mem_charge = b;
+}
+
+void CInode::clear_mem_charge()
+{
+  if (!mem_charge)
+    return;
+  mdcache->adjust_cache_bytes(-(int64_t)mem_charge);
+  mem_charge = 0;
+}
+
 bool CInode::has_subtree_root_dirfrag()
 {
   for (map<frag_t,CDir*>::iterator p = dirfrags.begin();
@@ -1065,6 +1128,20 @@ void CInode::set_object_info(MDSCacheObjectInfo &info)
   info.snapid = last;
 }
 
+void CInode::_encode_file_locks(bufferlist& bl)
+{
+  ceph_lock_state_t empty;
+  ::encode(fcntl_locks ? *fcntl_locks : empty, bl);
+  ::encode(flock_locks ? *flock_locks : empty, bl);
+}
+
+void CInode::_decode_file_locks(bufferlist::iterator& p)
+{
+  ::decode(*get_fcntl_lock_state(), p);
+  ::decode(*get_flock_lock_state(), p);
+  trim_file_locks();
+}
+
 void CInode::encode_lock_state(int type, bufferlist& bl)
 {
   ::encode(first, bl);
@@ -1188,8 +1265,7 @@ void CInode::encode_lock_state(int type, bufferlist& bl)
     break;
 
   case CEPH_LOCK_IFLOCK:
-    ::encode(fcntl_locks, bl);
-    ::encode(flock_locks, bl);
+    _encode_file_locks(bl);
     break;
 
   case CEPH_LOCK_IPOLICY:
@@ -1431,8 +1507,7 @@ void CInode::decode_lock_state(int type, bufferlist& bl)
     break;
 
   case CEPH_LOCK_IFLOCK:
-    ::decode(fcntl_locks, p);
-    ::decode(flock_locks, p);
+    _decode_file_locks(p);
     break;
 
   case CEPH_LOCK_IPOLICY:
@@ -2050,6 +2125,8 @@ old_inode_t& CInode::cow_old_inode(snapid_t follows, bool cow_head)
 	   << " to [" << old.first << "," << follows << "] on "
 	   << *this << dendl;
 
+  update_mem_charge();
+
   return old;
 }
 
@@ -2076,6 +2153,9 @@ void CInode::purge_stale_snap_data(const set<snapid_t>& snaps)
     } else
       p++;
   }
+  if (old_inodes.empty())
+    old_inodes.clear();  // give back the map itself
+  update_mem_charge();
 }
 
 /*
@@ -2299,7 +2379,8 @@ Capability *CInode::add_client_cap(client_t client, Session *session, SnapRealm
   cap->client_follows = first-1;
   
   containing_realm->add_cap(client, cap);
-  
+
+  update_mem_charge();
   return cap;
 }
 
@@ -2327,13 +2408,15 @@ void CInode::remove_client_cap(client_t client)
   mdcache->num_caps--;
 
   //clean up advisory locks
-  bool fcntl_removed = fcntl_locks.remove_all_from(client);
-  bool flock_removed = flock_locks.remove_all_from(client);
+  bool fcntl_removed = fcntl_locks ? fcntl_locks->remove_all_from(client) : false;
+  bool flock_removed = flock_locks ? flock_locks->remove_all_from(client) : false;
+  trim_file_locks();
   if (fcntl_removed || flock_removed) {
     list<Context*> waiters;
     take_waiting(CInode::WAIT_FLOCK, waiters);
     mdcache->mds->queue_waiters(waiters);
   }
+  update_mem_charge();
 }
 
 void CInode::move_to_realm(SnapRealm *realm)
@@ -22,6 +22,8 @@
 #include "include/elist.h"
 #include "include/types.h"
 #include "include/lru.h"
+#include "include/compact_map.h"
+#include "include/compact_set.h"
 
 #include "mdstypes.h"
 #include "flock.h"
@@ -209,8 +211,8 @@ public:
 
   SnapRealm        *containing_realm;
   snapid_t          first, last;
-  map<snapid_t, old_inode_t> old_inodes;  // key = last, value.first = first
-  set<snapid_t> dirty_old_rstats;
+  compact_map<snapid_t, old_inode_t> old_inodes;  // key = last, value.first = first
+  compact_set<snapid_t> dirty_old_rstats;
 
   bool is_multiversion() {
     return snaprealm ||  // other snaprealms will link to me
@@ -397,7 +399,7 @@ public:
  protected:
   // parent dentries in cache
   CDentry         *parent;             // primary link
-  set<CDentry*>    remote_parents;     // if hard linked
+  compact_set<CDentry*> remote_parents;     // if hard linked
 
   list<CDentry*>   projected_parent;   // for in-progress rename, (un)link, etc.
 
@@ -406,21 +408,59 @@ public:
   // -- distributed state --
 protected:
   // file capabilities
-  map<client_t, Capability*> client_caps;         // client -> caps
-  map<int, int>         mds_caps_wanted;     // [auth] mds -> caps wanted
+  compact_map<client_t, Capability*> client_caps;         // client -> caps
+  compact_map<int, int> mds_caps_wanted;     // [auth] mds -> caps wanted
   int                   replica_caps_wanted; // [replica] what i've requested from auth
 
-  map<int, set<client_t> > client_snap_caps;     // [auth] [snap] dirty metadata we still need from the head
+  compact_map<int, set<client_t> > client_snap_caps;     // [auth] [snap] dirty metadata we still need from the head
 public:
-  map<snapid_t, set<client_t> > client_need_snapflush;
+  compact_map<snapid_t, set<client_t> > client_need_snapflush;
 
   void add_need_snapflush(CInode *snapin, snapid_t snapid, client_t client);
   void remove_need_snapflush(CInode *snapin, snapid_t snapid, client_t client);
 
 protected:
 
-  ceph_lock_state_t fcntl_locks;
-  ceph_lock_state_t flock_locks;
+  // advisory locks; most inodes never see one, so allocate on demand
+  ceph_lock_state_t *fcntl_locks;
+  ceph_lock_state_t *flock_locks;
+
+  ceph_lock_state_t *get_fcntl_lock_state() {
+    if (!fcntl_locks)
+      fcntl_locks = new ceph_lock_state_t;
+    return fcntl_locks;
+  }
+  ceph_lock_state_t *get_flock_lock_state() {
+    if (!flock_locks)
+      flock_locks = new ceph_lock_state_t;
+    return flock_locks;
+  }
+  void clear_file_locks() {
+    delete fcntl_locks;
+    fcntl_locks = NULL;
+    delete flock_locks;
+    flock_locks = NULL;
+  }
+  void trim_file_locks() {
+    if (fcntl_locks && fcntl_locks->empty()) {
+      delete fcntl_locks;
+      fcntl_locks = NULL;
+    }
+    if (flock_locks && flock_locks->empty()) {
+      delete flock_locks;
+      flock_locks = NULL;
+    }
+  }
+  void _encode_file_locks(bufferlist& bl);
+  void _decode_file_locks(bufferlist::iterator& p);
+
+  // bytes we are currently charged for in MDCache::cache_bytes
+  uint64_t mem_charge;
+public:
+  uint64_t estimate_memory();
+  void charge_mem();
+  void update_mem_charge();
+  void clear_mem_charge();
 
   // LogSegment dlists i (may) belong to
 public:
@@ -469,6 +509,8 @@ private:
     parent(0),
     inode_auth(CDIR_AUTH_DEFAULT),
     replica_caps_wanted(0),
+    fcntl_locks(0), flock_locks(0),
+    mem_charge(0),
     item_dirty(this), item_caps(this), item_open_file(this), item_renamed_file(this), 
     item_dirty_dirfrag_dir(this), 
     item_dirty_dirfrag_nest(this), 
@@ -498,6 +540,8 @@ private:
     g_num_inos++;
     close_dirfrags();
     close_snaprealm();
+    clear_file_locks();
+    clear_mem_charge();
   }
   
 
@@ -797,9 +841,9 @@ public:
   bool is_any_caps() { return !client_caps.empty(); }
   bool is_any_nonstale_caps() { return count_nonstale_caps(); }
 
-  map<int,int>& get_mds_caps_wanted() { return mds_caps_wanted; }
+  compact_map<int,int>& get_mds_caps_wanted() { return mds_caps_wanted; }
 
-  map<client_t,Capability*>& get_client_caps() { return client_caps; }
+  compact_map<client_t,Capability*>& get_client_caps() { return client_caps; }
   Capability *get_client_cap(client_t client) {
     if (client_caps.count(client))
       return client_caps[client];
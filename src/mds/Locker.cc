@@ -48,6 +48,7 @@
 #include "messages/MClientReply.h"
 #include "messages/MClientCaps.h"
 #include "messages/MClientCapRelease.h"
+#include "messages/MClientCapsBatch.h"
 
 #include "messages/MMDSSlaveRequest.h"
 
@@ -84,6 +85,9 @@ void Locker::dispatch(Message *m)
   case CEPH_MSG_CLIENT_CAPS:
     handle_client_caps((MClientCaps*)m);
     break;
+  case CEPH_MSG_CLIENT_CAPS_BATCH:
+    handle_client_caps_batch((MClientCapsBatch*)m);
+    break;
   case CEPH_MSG_CLIENT_CAPRELEASE:
     handle_client_cap_release((MClientCapRelease*)m);
     break;
@@ -2168,6 +2172,23 @@ bool Locker::should_defer_client_cap_frozen(CInode *in)
     in->is_frozen();
 }
 
+/*
+ * The batch is unpacked into plain MClientCaps, which are handled in
+ * order while we still hold mds_lock for the dispatch of the batch.
+ * This function DOES put the passed message before returning
+ */
+void Locker::handle_client_caps_batch(MClientCapsBatch *m)
+{
+  dout(7) << "handle_client_caps_batch " << *m << " from " << m->get_source() << dendl;
+
+  vector<MClientCaps*> ls;
+  m->take_caps(ls);
+  m->put();
+
+  for (vector<MClientCaps*>::iterator p = ls.begin(); p != ls.end(); ++p)
+    handle_client_caps(*p);
+}
+
 /*
  * This function DOES put the passed message before returning
  */
@@ -2687,17 +2708,17 @@ bool Locker::_do_cap_update(CInode *in, Capability *cap,
     for ( int i=0; i < num_locks; ++i) {
       ceph_filelock decoded_lock;
       ::decode(decoded_lock, bli);
-      in->fcntl_locks.held_locks.
+      in->get_fcntl_lock_state()->held_locks.
 	insert(pair<uint64_t, ceph_filelock>(decoded_lock.start, decoded_lock));
-      ++in->fcntl_locks.client_held_lock_counts[(client_t)(decoded_lock.client)];
+      ++in->get_fcntl_lock_state()->client_held_lock_counts[(client_t)(decoded_lock.client)];
     }
     ::decode(num_locks, bli);
     for ( int i=0; i < num_locks; ++i) {
       ceph_filelock decoded_lock;
       ::decode(decoded_lock, bli);
-      in->flock_locks.held_locks.
+      in->get_flock_lock_state()->held_locks.
 	insert(pair<uint64_t, ceph_filelock>(decoded_lock.start, decoded_lock));
-      ++in->flock_locks.client_held_lock_counts[(client_t)(decoded_lock.client)];
+      ++in->get_flock_lock_state()->client_held_lock_counts[(client_t)(decoded_lock.client)];
     }
   }
 
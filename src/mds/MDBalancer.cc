@@ -82,6 +82,14 @@ void MDBalancer::tick()
   if ((double)now - (double)last_sample > g_conf->mds_bal_sample_interval) {
     dout(15) << "tick last_sample now " << now << dendl;
     last_sample = now;
+
+    sampled_auth_load = 0;
+    if (mds->mdcache->get_root()) {
+      list<CDir*> ls;
+      mds->mdcache->get_root()->get_dirfrags(ls);
+      for (list<CDir*>::iterator p = ls.begin(); p != ls.end(); ++p)
+	sampled_auth_load += (*p)->pop_auth_subtree_nested.meta_load(now, mds->mdcache->decayrate);
+    }
   }
 
   // balance?
@@ -101,7 +109,9 @@ void MDBalancer::tick()
 
   // hash?
   if (g_conf->mds_bal_frag && g_conf->mds_bal_fragment_interval > 0 &&
-      now.sec() - last_fragment.sec() > g_conf->mds_bal_fragment_interval) {
+      (hot_split_pending ||
+       now.sec() - last_fragment.sec() > g_conf->mds_bal_fragment_interval)) {
+    hot_split_pending = false;
     last_fragment = now;
     do_fragmenting();
   }
@@ -985,6 +995,24 @@ void MDBalancer::hit_inode(utime_t now, CInode *in, int type, int who)
 */
 
 
+/*
+ * A dirfrag is hot when it alone carries a large share of this mds'
+ * load.  Splitting it lets the rebalancer move pieces of it to other
+ * nodes.  Don't bother with dirfrags whose pieces would be small enough
+ * to be merged straight back.
+ */
+bool MDBalancer::is_dir_hot(utime_t now, CDir *dir)
+{
+  if (g_conf->mds_bal_split_load_fraction <= 0 ||
+      sampled_auth_load < g_conf->mds_bal_split_min_load)
+    return false;
+  if (dir->get_num_head_items() <=
+      ((unsigned)g_conf->mds_bal_merge_size << g_conf->mds_bal_split_bits))
+    return false;
+  double load = dir->pop_me.meta_load(now, mds->mdcache->decayrate);
+  return load > sampled_auth_load * g_conf->mds_bal_split_load_fraction;
+}
+
 void MDBalancer::hit_dir(utime_t now, CDir *dir, int type, int who, double amount)
 {
   // hit me
@@ -1002,13 +1030,17 @@ void MDBalancer::hit_dir(utime_t now, CDir *dir, int type, int who, double amoun
 	     << " size " << dir->get_num_head_items() << dendl;
 
     // split
+    bool too_hot = (v > g_conf->mds_bal_split_rd && type == META_POP_IRD) ||
+      (v > g_conf->mds_bal_split_wr && type == META_POP_IWR) ||
+      is_dir_hot(now, dir);
     if (g_conf->mds_bal_split_size > 0 &&
 	((dir->get_num_head_items() > (unsigned)g_conf->mds_bal_split_size) ||
-	 (v > g_conf->mds_bal_split_rd && type == META_POP_IRD) ||
-	 (v > g_conf->mds_bal_split_wr && type == META_POP_IWR)) &&
+	 too_hot) &&
 	split_queue.count(dir->dirfrag()) == 0) {
       dout(1) << "hit_dir " << type << " pop is " << v << ", putting in split_queue: " << *dir << dendl;
       split_queue.insert(dir->dirfrag());
+      if (too_hot)
+	hot_split_pending = true;  // split on the next tick
     }
 
     // merge?
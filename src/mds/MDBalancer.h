@@ -49,6 +49,12 @@ class MDBalancer {
 
   // todo
   set<dirfrag_t>   split_queue, merge_queue;
+  bool hot_split_pending;  // split_queue has a hot dirfrag; don't wait out mds_bal_fragment_interval
+
+  // our auth meta load as of last_sample, to spot a dirfrag that
+  // carries too large a share of it
+  double sampled_auth_load;
+  bool is_dir_hot(utime_t now, CDir *dir);
 
   // per-epoch scatter/gathered info
   map<int, mds_load_t>  mds_load;
@@ -77,7 +83,9 @@ public:
   MDBalancer(MDS *m) : 
     mds(m),
     beat_epoch(0),
-    last_epoch_under(0), last_epoch_over(0) { }
+    last_epoch_under(0), last_epoch_over(0),
+    hot_split_pending(false),
+    sampled_auth_load(0) { }
   
   mds_load_t get_load(utime_t);
 
@@ -123,7 +123,10 @@ long g_num_caps = 0;
 set<int> SimpleLock::empty_gather_set;
 
 
-MDCache::MDCache(MDS *m)
+MDCache::MDCache(MDS *m) :
+  fetch_tp(g_ceph_context, "MDCache::fetch_tp", g_conf->mds_fetch_decode_threads),
+  fetch_tp_stopped(true),
+  fetch_wq(this, &fetch_tp)
 {
   mds = m;
   migrator = new Migrator(mds, this);
@@ -137,6 +140,7 @@ MDCache::MDCache(MDS *m)
 
   num_inodes_with_caps = 0;
   num_caps = 0;
+  cache_bytes = 0;
 
   max_dir_commit_size = g_conf->mds_dir_max_commit_size ?
                         (g_conf->mds_dir_max_commit_size << 20) :
@@ -168,6 +172,48 @@ MDCache::~MDCache()
 
 
 
+void MDCache::start_fetch_tp()
+{
+  if (g_conf->mds_fetch_decode_threads <= 0)
+    return;
+  fetch_tp.start();
+  fetch_tp_stopped = false;
+}
+
+void MDCache::stop_fetch_tp()
+{
+  assert(mds->mds_lock.is_locked());
+  if (fetch_tp_stopped)
+    return;
+  fetch_tp_stopped = true;
+
+  // the workers need mds_lock to hand back what they decoded
+  mds->mds_lock.Unlock();
+  fetch_tp.stop();
+  mds->mds_lock.Lock();
+}
+
+/*
+ * Runs in fetch_tp, without mds_lock.
+ */
+void MDCache::_decode_fetched(CDir::omap_chunk_t *c)
+{
+  c->recs.reserve(c->omap.size());
+  for (map<string, bufferlist>::iterator p = c->omap.begin(); p != c->omap.end(); ++p) {
+    c->recs.push_back(CDir::dentry_rec_t());
+    CDir::_decode_dentry(p->first, p->second, c->recs.back());
+  }
+  c->decoded = true;
+
+  mds->mds_lock.Lock();
+  if (!fetch_tp_stopped) {
+    c->dir->_omap_fetched(c);
+    mds->flush_finished_queue();
+  }
+  mds->mds_lock.Unlock();
+  delete c;
+}
+
 void MDCache::log_stat()
 {
   mds->logger->set(l_mds_imax, g_conf->mds_cache_size);
@@ -178,6 +224,8 @@ void MDCache::log_stat()
   mds->logger->set(l_mds_iptail, lru.lru_get_pintail());
   mds->logger->set(l_mds_icap, num_inodes_with_caps);
   mds->logger->set(l_mds_cap, num_caps);
+  mds->logger->set(l_mds_cbytes, cache_bytes);
+  mds->logger->set(l_mds_cbytesmax, g_conf->mds_cache_memory_limit);
 }
 
 
@@ -204,6 +252,8 @@ void MDCache::add_inode(CInode *in)
   assert(inode_map.count(in->vino()) == 0);  // should be no dup inos!
   inode_map[ in->vino() ] = in;
 
+  in->charge_mem();
+
   if (in->ino() < MDS_INO_SYSTEM_BASE) {
     if (in->ino() == MDS_INO_ROOT)
       root = in;
@@ -5369,15 +5419,18 @@ bool MDCache::trim(int max)
     max = g_conf->mds_cache_size;
     if (!max) return false;
   }
-  dout(7) << "trim max=" << max << "  cur=" << lru.lru_get_size() << dendl;
+  dout(7) << "trim max=" << max << "  cur=" << lru.lru_get_size()
+	  << " bytes=" << cache_bytes << "/" << g_conf->mds_cache_memory_limit << dendl;
 
   map<int, MCacheExpire*> expiremap;
 
   bool is_standby_replay = mds->is_standby_replay();
   int unexpirable = 0;
   list<CDentry*> unexpirables;
-  // trim dentries from the LRU
-  while (lru.lru_get_size() + unexpirable > (unsigned)max) {
+  // trim dentries from the LRU, until we are within both the item
+  // count and the byte budget
+  while (lru.lru_get_size() + unexpirable > (unsigned)max ||
+	 cache_over_memory_limit()) {
     CDentry *dn = (CDentry*)lru.lru_expire();
     if (!dn) break;
     if (is_standby_replay && dn->get_linkage() &&
@@ -6131,6 +6184,12 @@ void MDCache::check_memory_usage()
     float ratio = (float)g_conf->mds_cache_size * .9 / (float)num_inodes_with_caps;
     if (ratio < 1.0)
       mds->server->recall_client_state(ratio);
+  } else if (cache_over_memory_limit()) {
+    // client caps pin the inodes we would otherwise trim
+    float ratio = (float)g_conf->mds_cache_memory_limit * .9 / (float)cache_bytes;
+    dout(2) << "check_memory_usage cache " << cache_bytes << " bytes over limit "
+	    << g_conf->mds_cache_memory_limit << ", recalling caps" << dendl;
+    mds->server->recall_client_state(ratio);
   }
 
 }
@@ -6784,7 +6843,16 @@ int MDCache::path_traverse(MDRequest *mdr, Message *req, Context *fin,     // wh
 	// directory isn't complete; reload
         dout(7) << "traverse: incomplete dir contents for " << *cur << ", fetching" << dendl;
         touch_inode(cur);
-        curdir->fetch(_get_waiter(mdr, req, fin), path[depth]);
+	if (!g_conf->mds_use_tmap && snapid == CEPH_NOSNAP) {
+	  // just look up the one dentry
+	  set<string> keys;
+	  string key;
+	  dentry_key_t(CEPH_NOSNAP, path[depth].c_str()).encode(key);
+	  keys.insert(key);
+	  curdir->fetch_keys(_get_waiter(mdr, req, fin), keys);
+	} else {
+	  curdir->fetch(_get_waiter(mdr, req, fin), path[depth]);
+	}
 	if (mds->logger) mds->logger->inc(l_mds_tdirf);
         return 1;
       }
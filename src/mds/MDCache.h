@@ -25,6 +25,7 @@
 #include "CDir.h"
 #include "include/Context.h"
 #include "events/EMetaBlob.h"
+#include "common/WorkQueue.h"
 
 #include "messages/MClientRequest.h"
 #include "messages/MMDSSlaveRequest.h"
@@ -104,6 +105,74 @@ public:
   int num_inodes_with_caps;
   int num_caps;
 
+  // -- fetch decoding --
+  /*
+   * Decoding a freshly read dirfrag (an inode_t, xattrs, fragtree... for
+   * every dentry) needs no cache state, so big chunks are decoded by
+   * fetch_tp without mds_lock.  Only instantiating the dentries happens
+   * under the lock.  This lets cold readdirs and lookups use more than
+   * one core.  It is the only part of request handling that does:
+   * Server, Locker and the journal still run every client request one
+   * at a time under mds_lock.
+   */
+  ThreadPool fetch_tp;
+  bool fetch_tp_stopped;
+  list<CDir::omap_chunk_t*> fetch_queue;
+
+  struct FetchDecodeWQ : public ThreadPool::WorkQueue<CDir::omap_chunk_t> {
+    MDCache *cache;
+    FetchDecodeWQ(MDCache *c, ThreadPool *tp)
+      : ThreadPool::WorkQueue<CDir::omap_chunk_t>("MDCache::FetchDecodeWQ", 0, 0, tp),
+	cache(c) {}
+
+    bool _empty() {
+      return cache->fetch_queue.empty();
+    }
+    bool _enqueue(CDir::omap_chunk_t *c) {
+      cache->fetch_queue.push_back(c);
+      return true;
+    }
+    void _dequeue(CDir::omap_chunk_t *c) {
+      assert(0);
+    }
+    CDir::omap_chunk_t *_dequeue() {
+      if (cache->fetch_queue.empty())
+	return NULL;
+      CDir::omap_chunk_t *c = cache->fetch_queue.front();
+      cache->fetch_queue.pop_front();
+      return c;
+    }
+    void _process(CDir::omap_chunk_t *c) {
+      cache->_decode_fetched(c);
+    }
+    void _clear() {
+      while (!cache->fetch_queue.empty()) {
+	delete cache->fetch_queue.front();
+	cache->fetch_queue.pop_front();
+      }
+    }
+  } fetch_wq;
+
+  bool fetch_decode_offload(unsigned nkeys) {
+    return !fetch_tp_stopped &&
+      g_conf->mds_fetch_decode_threads > 0 &&
+      nkeys >= (unsigned)g_conf->mds_fetch_decode_min_keys;
+  }
+  void start_fetch_tp();
+  void stop_fetch_tp();
+  void _decode_fetched(CDir::omap_chunk_t *c);
+
+  // rough bytes held by cached inodes, dentries and dirfrags
+  uint64_t cache_bytes;
+  void adjust_cache_bytes(int64_t delta) {
+    assert(delta >= 0 || (uint64_t)-delta <= cache_bytes);
+    cache_bytes += delta;
+  }
+  bool cache_over_memory_limit() {
+    return g_conf->mds_cache_memory_limit &&
+      cache_bytes > g_conf->mds_cache_memory_limit;
+  }
+
   unsigned max_dir_commit_size;
 
   ceph_file_layout default_file_layout;
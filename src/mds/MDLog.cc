@@ -68,6 +68,11 @@ void MDLog::create_logger()
   plb.add_u64(l_mdl_rdpos, "rdpos");
   plb.add_u64(l_mdl_jlat, "jlat");
 
+  plb.add_u64_counter(l_mdl_replayev, "replayev");
+  plb.add_u64_counter(l_mdl_replaybytes, "replaybytes");
+  plb.add_u64(l_mdl_replayleft, "replayleft");
+  plb.add_u64(l_mdl_replayq, "replayq");
+
   // logger
   logger = plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
@@ -478,81 +483,119 @@ void MDLog::_replay_thread()
   mds->mds_lock.Lock();
   dout(10) << "_replay_thread start" << dendl;
 
+  replay_decode_stop = false;
+  replay_decode_thread.create();
+
+  utime_t start = ceph_clock_now(g_ceph_context);
+  uint64_t start_pos = journaler->get_read_pos();
+  uint64_t replayed = 0;
+  unsigned queued = 0;  // read off the journaler but not yet replayed
+
   // loop
   int r = 0;
   while (1) {
-    // wait for read?
-    while (!journaler->is_readable() &&
-	   journaler->get_read_pos() < journaler->get_write_pos() &&
-	   !journaler->get_error()) {
-      journaler->wait_for_readable(new C_MDL_Replay(this));
-      replay_cond.Wait(mds->mds_lock);
-    }
-    if (journaler->get_error()) {
-      r = journaler->get_error();
-      dout(0) << "_replay journaler got error " << r << ", aborting" << dendl;
-      if (r == -EINVAL) {
-        if (journaler->get_read_pos() < journaler->get_expire_pos()) {
-          // this should only happen if you're following somebody else
-          assert(journaler->is_readonly());
-          dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
-          r = -EAGAIN;
-        } else {
-          /* re-read head and check it
-           * Given that replay happens in a separate thread and
-           * the MDS is going to either shut down or restart when
-           * we return this error, doing it synchronously is fine
-           * -- as long as we drop the main mds lock--. */
-          Mutex mylock("MDLog::_replay_thread lock");
-          Cond cond;
-          bool done = false;
-          int err = 0;
-          journaler->reread_head(new C_SafeCond(&mylock, &cond, &done, &err));
-          mds->mds_lock.Unlock();
-	  mylock.Lock();
-          while (!done)
-            cond.Wait(mylock);
-	  mylock.Unlock();
-          if (err) { // well, crap
-            dout(0) << "got error while reading head: " << cpp_strerror(err)
-                    << dendl;
-            mds->suicide();
-          }
-          mds->mds_lock.Lock();
-	  standby_trim_segments();
-          if (journaler->get_read_pos() < journaler->get_expire_pos()) {
-            dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
-            r = -EAGAIN;
-          }
-        }
+    // keep the decoder fed.  the journaler itself prefetches
+    // journaler_prefetch_periods objects ahead of the read position.
+    while (queued < (unsigned)g_conf->mds_log_replay_decode_ahead &&
+	   journaler->is_readable()) {
+      ReplayItem *item = new ReplayItem;
+      item->pos = journaler->get_read_pos();
+      if (!journaler->try_read_entry(item->bl)) {
+	delete item;
+	break;
       }
-      break;
+      item->end = journaler->get_read_pos();
+      replay_decode_lock.Lock();
+      replay_raw.push_back(item);
+      replay_decode_cond.Signal();
+      replay_decode_lock.Unlock();
+      queued++;
     }
-    
-    if (!journaler->is_readable() &&
-	journaler->get_read_pos() == journaler->get_write_pos())
-      break;
-    
-    assert(journaler->is_readable());
-    
-    // read it
-    uint64_t pos = journaler->get_read_pos();
-    bufferlist bl;
-    bool r = journaler->try_read_entry(bl);
-    if (!r && journaler->get_error())
+
+    if (!queued) {
+      // wait for read?
+      if (!journaler->is_readable() &&
+	  journaler->get_read_pos() < journaler->get_write_pos() &&
+	  !journaler->get_error()) {
+	journaler->wait_for_readable(new C_MDL_Replay(this));
+	replay_cond.Wait(mds->mds_lock);
+	continue;
+      }
+      if (journaler->get_error()) {
+	r = journaler->get_error();
+	dout(0) << "_replay journaler got error " << r << ", aborting" << dendl;
+	if (r == -EINVAL) {
+	  if (journaler->get_read_pos() < journaler->get_expire_pos()) {
+	    // this should only happen if you're following somebody else
+	    assert(journaler->is_readonly());
+	    dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
+	    r = -EAGAIN;
+	  } else {
+	    /* re-read head and check it
+	     * Given that replay happens in a separate thread and
+	     * the MDS is going to either shut down or restart when
+	     * we return this error, doing it synchronously is fine
+	     * -- as long as we drop the main mds lock--. */
+	    Mutex mylock("MDLog::_replay_thread lock");
+	    Cond cond;
+	    bool done = false;
+	    int err = 0;
+	    journaler->reread_head(new C_SafeCond(&mylock, &cond, &done, &err));
+	    mds->mds_lock.Unlock();
+	    mylock.Lock();
+	    while (!done)
+	      cond.Wait(mylock);
+	    mylock.Unlock();
+	    if (err) { // well, crap
+	      dout(0) << "got error while reading head: " << cpp_strerror(err)
+		      << dendl;
+	      mds->suicide();
+	    }
+	    mds->mds_lock.Lock();
+	    standby_trim_segments();
+	    if (journaler->get_read_pos() < journaler->get_expire_pos()) {
+	      dout(0) << "expire_pos is higher than read_pos, returning EAGAIN" << dendl;
+	      r = -EAGAIN;
+	    }
+	  }
+	}
+	break;
+      }
+
+      if (!journaler->is_readable() &&
+	  journaler->get_read_pos() == journaler->get_write_pos())
+	break;
       continue;
-    assert(r);
-    
-    // unpack event
-    LogEvent *le = LogEvent::decode(bl);
+    }
+
+    // next decoded event, in journal order.  don't hold mds_lock
+    // while we wait for the decoder.
+    replay_decode_lock.Lock();
+    if (replay_decoded.empty()) {
+      mds->mds_lock.Unlock();
+      while (replay_decoded.empty())
+	replay_decode_cond.Wait(replay_decode_lock);
+      replay_decode_lock.Unlock();
+      mds->mds_lock.Lock();
+      replay_decode_lock.Lock();
+    }
+    ReplayItem *item = replay_decoded.front();
+    replay_decoded.pop_front();
+    logger->set(l_mdl_replayq, replay_decoded.size());
+    replay_decode_lock.Unlock();
+    queued--;
+
+    uint64_t pos = item->pos;
+    LogEvent *le = item->le;
     if (!le) {
-      dout(0) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+      dout(0) << "_replay " << pos << "~" << item->bl.length() << " / " << journaler->get_write_pos() 
 	      << " -- unable to decode event" << dendl;
       dout(0) << "dump of unknown or corrupt event:\n";
-      bl.hexdump(*_dout);
+      item->bl.hexdump(*_dout);
       *_dout << dendl;
 
       assert(!!"corrupt log event" == g_conf->mds_log_skip_corrupt_events);
+      delete item;
       continue;
     }
     le->set_start_off(pos);
@@ -566,32 +609,60 @@ void MDLog::_replay_thread()
 
     // have we seen an import map yet?
     if (segments.empty()) {
-      dout(10) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+      dout(10) << "_replay " << pos << "~" << item->bl.length() << " / " << journaler->get_write_pos() 
 	       << " " << le->get_stamp() << " -- waiting for subtree_map.  (skipping " << *le << ")" << dendl;
     } else {
-      dout(10) << "_replay " << pos << "~" << bl.length() << " / " << journaler->get_write_pos() 
+      dout(10) << "_replay " << pos << "~" << item->bl.length() << " / " << journaler->get_write_pos() 
 	       << " " << le->get_stamp() << ": " << *le << dendl;
       le->_segment = get_current_segment();    // replay may need this
       le->_segment->num_events++;
-      le->_segment->end = journaler->get_read_pos();
+      le->_segment->end = item->end;
       num_events++;
 
       le->replay(mds);
     }
     delete le;
 
+    replayed++;
     logger->set(l_mdl_rdpos, pos);
+    logger->inc(l_mdl_replayev);
+    logger->inc(l_mdl_replaybytes, item->end - pos);
+    logger->set(l_mdl_replayleft, journaler->get_write_pos() - item->end);
+    delete item;
 
     // drop lock for a second, so other events/messages (e.g. beacon timer!) can go off
     mds->mds_lock.Unlock();
     mds->mds_lock.Lock();
   }
 
+  // stop the decoder, and drop anything it still had
+  replay_decode_lock.Lock();
+  replay_decode_stop = true;
+  replay_decode_cond.Signal();
+  replay_decode_lock.Unlock();
+  mds->mds_lock.Unlock();
+  replay_decode_thread.join();
+  mds->mds_lock.Lock();
+  while (!replay_raw.empty()) {
+    delete replay_raw.front();
+    replay_raw.pop_front();
+  }
+  while (!replay_decoded.empty()) {
+    delete replay_decoded.front()->le;
+    delete replay_decoded.front();
+    replay_decoded.pop_front();
+  }
+
   // done!
   if (r == 0) {
     assert(journaler->get_read_pos() == journaler->get_write_pos());
+    double elapsed = (double)(ceph_clock_now(g_ceph_context) - start);
+    uint64_t bytes = journaler->get_read_pos() - start_pos;
     dout(10) << "_replay - complete, " << num_events
 	     << " events" << dendl;
+    dout(1) << "_replay replayed " << replayed << " events, " << bytes << " bytes in "
+	    << elapsed << " s (" << (elapsed > 0 ? (double)replayed / elapsed : 0)
+	    << " events/s)" << dendl;
 
     logger->set(l_mdl_expos, journaler->get_expire_pos());
   }
@@ -603,6 +674,28 @@ void MDLog::_replay_thread()
   mds->mds_lock.Unlock();
 }
 
+// i am a separate thread, too
+void MDLog::_replay_decode_thread()
+{
+  replay_decode_lock.Lock();
+  while (!replay_decode_stop) {
+    if (replay_raw.empty()) {
+      replay_decode_cond.Wait(replay_decode_lock);
+      continue;
+    }
+    ReplayItem *item = replay_raw.front();
+    replay_raw.pop_front();
+    replay_decode_lock.Unlock();
+
+    item->le = LogEvent::decode(item->bl);
+
+    replay_decode_lock.Lock();
+    replay_decoded.push_back(item);
+    replay_decode_cond.Signal();
+  }
+  replay_decode_lock.Unlock();
+}
+
 void MDLog::standby_trim_segments()
 {
   dout(10) << "standby_trim_segments" << dendl;
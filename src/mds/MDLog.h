@@ -34,6 +34,10 @@ enum {
   l_mdl_wrpos,
   l_mdl_rdpos,
   l_mdl_jlat,
+  l_mdl_replayev,
+  l_mdl_replaybytes,
+  l_mdl_replayleft,
+  l_mdl_replayq,
   l_mdl_last,
 };
 
@@ -97,6 +101,33 @@ protected:
   void _replay();         // old way
   void _replay_thread();  // new way
 
+  // raw entries are pulled off the journaler by the replay thread and
+  // decoded by a second thread, so that decoding the next events
+  // overlaps replaying the current one.
+  struct ReplayItem {
+    uint64_t pos, end;
+    bufferlist bl;
+    LogEvent *le;
+    ReplayItem() : pos(0), end(0), le(0) {}
+  };
+  Mutex replay_decode_lock;
+  Cond replay_decode_cond;
+  list<ReplayItem*> replay_raw, replay_decoded;
+  bool replay_decode_stop;
+
+  class ReplayDecodeThread : public Thread {
+    MDLog *log;
+  public:
+    ReplayDecodeThread(MDLog *l) : log(l) {}
+    void* entry() {
+      log->_replay_decode_thread();
+      return 0;
+    }
+  } replay_decode_thread;
+  friend class ReplayDecodeThread;
+
+  void _replay_decode_thread();
+
 
   // -- segments --
   map<uint64_t,LogSegment*> segments;
@@ -154,6 +185,9 @@ public:
 		  logger(0),
 		  replay_thread(this),
 		  already_replayed(false),
+		  replay_decode_lock("MDLog::replay_decode_lock"),
+		  replay_decode_stop(false),
+		  replay_decode_thread(this),
 		  expiring_events(0), expired_events(0),
 		  cur_event(NULL) { }		  
   ~MDLog();
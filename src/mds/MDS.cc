@@ -197,6 +197,7 @@ void MDS::create_logger()
     mds_plb.add_u64_counter(l_mds_dir_c, "dir_c");
     mds_plb.add_u64_counter(l_mds_dir_sp, "dir_sp");
     mds_plb.add_u64_counter(l_mds_dir_ffc, "dir_ffc");
+    mds_plb.add_u64_counter(l_mds_dir_fk, "dir_fk");
     //mds_plb.add_u64_counter("mkdir");
 
     /*
@@ -222,6 +223,8 @@ void MDS::create_logger()
     mds_plb.add_u64_counter(l_mds_iex, "iex");
     mds_plb.add_u64_counter(l_mds_icap, "icap");
     mds_plb.add_u64_counter(l_mds_cap, "cap");
+    mds_plb.add_u64(l_mds_cbytes, "cbytes");
+    mds_plb.add_u64(l_mds_cbytesmax, "cbytesmax");
     
     mds_plb.add_u64_counter(l_mds_dis, "dis"); // FIXME: unused
 
@@ -460,6 +463,7 @@ int MDS::init(int wanted_state)
   }
 
   timer.init();
+  mdcache->start_fetch_tp();
 
   if (wanted_state==MDSMap::STATE_BOOT && g_conf->mds_standby_replay)
     wanted_state = MDSMap::STATE_STANDBY_REPLAY;
@@ -1541,6 +1545,8 @@ void MDS::suicide()
   }
   timer.cancel_all_events();
   //timer.join();
+
+  mdcache->stop_fetch_tp();
   
   // shut down cache
   mdcache->shutdown();
@@ -1605,6 +1611,31 @@ bool MDS::ms_dispatch(Message *m)
   return ret;
 }
 
+/*
+ * Run the contexts queued by queue_waiter(s).  Also used by threads
+ * that take mds_lock outside of ms_dispatch.
+ */
+void MDS::flush_finished_queue()
+{
+  assert(mds_lock.is_locked());
+  while (finished_queue.size()) {
+    dout(7) << "mds has " << finished_queue.size() << " queued contexts" << dendl;
+    dout(10) << finished_queue << dendl;
+    list<Context*> ls;
+    ls.swap(finished_queue);
+    while (!ls.empty()) {
+      dout(10) << " finish " << ls.front() << dendl;
+      ls.front()->finish(0);
+      delete ls.front();
+      ls.pop_front();
+      
+      // give other threads (beacon!) a chance
+      mds_lock.Unlock();
+      mds_lock.Lock();
+    }
+  }
+}
+
 bool MDS::ms_get_authorizer(int dest_type, AuthAuthorizer **authorizer, bool force_new)
 {
   dout(10) << "MDS::ms_get_authorizer type=" << ceph_entity_type_name(dest_type) << dendl;
@@ -1737,6 +1768,7 @@ bool MDS::handle_deferrable_message(Message *m)
       break;
       
     case CEPH_MSG_CLIENT_CAPS:
+    case CEPH_MSG_CLIENT_CAPS_BATCH:
     case CEPH_MSG_CLIENT_CAPRELEASE:
     case CEPH_MSG_CLIENT_LEASE:
       ALLOW_MESSAGES_FROM(CEPH_ENTITY_TYPE_CLIENT);
@@ -1801,22 +1833,7 @@ bool MDS::_dispatch(Message *m)
   }
 
   // finish any triggered contexts
-  while (finished_queue.size()) {
-    dout(7) << "mds has " << finished_queue.size() << " queued contexts" << dendl;
-    dout(10) << finished_queue << dendl;
-    list<Context*> ls;
-    ls.swap(finished_queue);
-    while (!ls.empty()) {
-      dout(10) << " finish " << ls.front() << dendl;
-      ls.front()->finish(0);
-      delete ls.front();
-      ls.pop_front();
-      
-      // give other threads (beacon!) a chance
-      mds_lock.Unlock();
-      mds_lock.Lock();
-    }
-  }
+  flush_finished_queue();
 
   while (!waiting_for_nolaggy.empty()) {
 
@@ -48,6 +48,7 @@ enum {
   l_mds_dir_c,
   l_mds_dir_sp,
   l_mds_dir_ffc,
+  l_mds_dir_fk,
   l_mds_imax,
   l_mds_i,
   l_mds_itop,
@@ -57,6 +58,8 @@ enum {
   l_mds_iex,
   l_mds_icap,
   l_mds_cap,
+  l_mds_cbytes,
+  l_mds_cbytesmax,
   l_mds_dis,
   l_mds_t,
   l_mds_thit,
@@ -255,6 +258,7 @@ class MDS : public Dispatcher {
   void queue_waiters(list<Context*>& ls) {
     finished_queue.splice( finished_queue.end(), ls );
   }
+  void flush_finished_queue();
   bool queue_one_replay() {
     if (replay_queue.empty())
       return false;
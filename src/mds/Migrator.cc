@@ -562,7 +562,7 @@ void Migrator::export_dir_nicely(CDir *dir, int dest)
 void Migrator::maybe_do_queued_export()
 {
   while (!export_queue.empty() &&
-	 export_state.size() <= 4) {
+	 (int)export_state.size() < g_conf->mds_max_exports_in_flight) {
     dirfrag_t df = export_queue.front().first;
     int dest = export_queue.front().second;
     export_queue.pop_front();
@@ -570,6 +570,7 @@ void Migrator::maybe_do_queued_export()
     CDir *dir = mds->mdcache->get_dirfrag(df);
     if (!dir) continue;
     if (!dir->is_auth()) continue;
+    if (export_state.count(dir)) continue;  // already on its way
 
     dout(0) << "nicely exporting to mds." << dest << " " << *dir << dendl;
 
@@ -674,17 +674,17 @@ void Server::recover_filelocks(CInode *in, bufferlist locks, int64_t client)
   for (int i = 0; i < numlocks; ++i) {
     ::decode(lock, p);
     lock.client = client;
-    in->fcntl_locks.held_locks.insert(pair<uint64_t, ceph_filelock>
+    in->get_fcntl_lock_state()->held_locks.insert(pair<uint64_t, ceph_filelock>
 				      (lock.start, lock));
-    ++in->fcntl_locks.client_held_lock_counts[client];
+    ++in->get_fcntl_lock_state()->client_held_lock_counts[client];
   }
   ::decode(numlocks, p);
   for (int i = 0; i < numlocks; ++i) {
     ::decode(lock, p);
     lock.client = client;
-    in->flock_locks.held_locks.insert(pair<uint64_t, ceph_filelock>
+    in->get_flock_lock_state()->held_locks.insert(pair<uint64_t, ceph_filelock>
 				      (lock.start, lock));
-    ++in->flock_locks.client_held_lock_counts[client];
+    ++in->get_flock_lock_state()->client_held_lock_counts[client];
   }
 }
 
@@ -842,8 +842,10 @@ void Server::reply_request(MDRequest *mdr, MClientReply *reply, CInode *tracei,
 	   << ") " << *req << dendl;
 
   // note successful request in session map?
-  if (req->may_write() && mdr->session && reply->get_result() == 0)
+  if (req->may_write() && mdr->session && reply->get_result() == 0) {
     mdr->session->add_completed_request(mdr->reqid.tid);
+    mds->sessionmap.mark_dirty(mdr->session);
+  }
 
   // give any preallocated inos to the session
   apply_allocated_inos(mdr);
@@ -1072,7 +1074,8 @@ void Server::handle_client_request(MClientRequest *req)
   // trim completed_request list
   if (req->get_oldest_client_tid() > 0) {
     dout(15) << " oldest_client_tid=" << req->get_oldest_client_tid() << dendl;
-    session->trim_completed_requests(req->get_oldest_client_tid());
+    if (session->trim_completed_requests(req->get_oldest_client_tid()))
+      mds->sessionmap.mark_dirty(session);
   }
 
   // register + dispatch
@@ -1794,11 +1797,13 @@ void Server::apply_allocated_inos(MDRequest *mdr)
   if (mdr->prealloc_inos.size()) {
     session->pending_prealloc_inos.subtract(mdr->prealloc_inos);
     session->prealloc_inos.insert(mdr->prealloc_inos);
+    mds->sessionmap.mark_dirty(session);
     mds->sessionmap.version++;
     mds->inotable->apply_alloc_ids(mdr->prealloc_inos);
   }
   if (mdr->used_prealloc_ino) {
     session->used_inos.erase(mdr->used_prealloc_ino);
+    mds->sessionmap.mark_dirty(session);
     mds->sessionmap.version++;
   }
 }
@@ -2933,11 +2938,11 @@ void Server::handle_client_file_setlock(MDRequest *mdr)
   // get the appropriate lock state
   switch (req->head.args.filelock_change.rule) {
   case CEPH_LOCK_FLOCK:
-    lock_state = &cur->flock_locks;
+    lock_state = cur->get_flock_lock_state();
     break;
 
   case CEPH_LOCK_FCNTL:
-    lock_state = &cur->fcntl_locks;
+    lock_state = cur->get_fcntl_lock_state();
     break;
 
   default:
@@ -2986,6 +2991,7 @@ void Server::handle_client_file_setlock(MDRequest *mdr)
       reply_request(mdr, 0);
   }
   dout(10) << " state after lock change: " << *lock_state << dendl;
+  cur->trim_file_locks();
 }
 
 void Server::handle_client_file_readlock(MDRequest *mdr)
@@ -3019,11 +3025,11 @@ void Server::handle_client_file_readlock(MDRequest *mdr)
   ceph_lock_state_t *lock_state = NULL;
   switch (req->head.args.filelock_change.rule) {
   case CEPH_LOCK_FLOCK:
-    lock_state = &cur->flock_locks;
+    lock_state = cur->get_flock_lock_state();
     break;
 
   case CEPH_LOCK_FCNTL:
-    lock_state = &cur->fcntl_locks;
+    lock_state = cur->get_fcntl_lock_state();
     break;
 
   default:
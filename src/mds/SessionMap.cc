@@ -18,6 +18,7 @@
 #include "osdc/Filer.h"
 
 #include "common/config.h"
+#include "include/stringify.h"
 
 #define dout_subsys ceph_subsys_mds
 #undef dout_prefix
@@ -52,11 +53,17 @@ object_t SessionMap::get_object_name()
 
 class C_SM_Load : public Context {
   SessionMap *sessionmap;
+  string start_after;
 public:
-  bufferlist bl;
-  C_SM_Load(SessionMap *cm) : sessionmap(cm) {}
+  bufferlist header;
+  map<string, bufferlist> session_vals;
+  int header_r, vals_r;
+  C_SM_Load(SessionMap *cm, const string& s) :
+    sessionmap(cm), start_after(s), header_r(0), vals_r(0) {}
   void finish(int r) {
-    sessionmap->_load_finish(r, bl);
+    if (r >= 0) r = header_r;
+    if (r >= 0) r = vals_r;
+    sessionmap->_load_finish(r, header, session_vals, start_after);
   }
 };
 
@@ -66,23 +73,111 @@ void SessionMap::load(Context *onload)
 
   if (onload)
     waiting_for_load.push_back(onload);
-  
-  C_SM_Load *c = new C_SM_Load(this);
+
+  _load_next(string());
+}
+
+/**
+ * Read the next chunk of the session table.
+ *
+ * The version lives in the omap header and each session is its own
+ * key; we read at most mds_sessionmap_keys_per_op sessions per op.
+ */
+void SessionMap::_load_next(const string& start_after)
+{
+  C_SM_Load *c = new C_SM_Load(this, start_after);
+  object_t oid = get_object_name();
+  object_locator_t oloc(mds->mdsmap->get_metadata_pg_pool());
+  ObjectOperation rd;
+  if (start_after.empty())
+    rd.omap_get_header(&c->header, &c->header_r);
+  rd.omap_get_vals(start_after, "", g_conf->mds_sessionmap_keys_per_op,
+		   &c->session_vals, &c->vals_r);
+  mds->objecter->read(oid, oloc, rd, CEPH_NOSNAP, NULL, 0, c);
+}
+
+void SessionMap::_load_finish(int r, bufferlist &header,
+			      map<string, bufferlist> &session_vals,
+			      const string& start_after)
+{
+  if (start_after.empty()) {
+    if (r < 0 || header.length() == 0) {
+      // no omap header: this is an old single-blob sessionmap (or it
+      // is missing entirely, which the legacy path will notice).
+      dout(10) << "_load_finish no omap header (r=" << r << "), reading legacy object" << dendl;
+      _load_legacy();
+      return;
+    }
+    bufferlist::iterator p = header.begin();
+    __u8 struct_v;
+    ::decode(struct_v, p);
+    ::decode(version, p);
+  }
+  assert(r >= 0);
+
+  for (map<string, bufferlist>::iterator q = session_vals.begin();
+       q != session_vals.end();
+       ++q) {
+    bufferlist::iterator p = q->second.begin();
+    entity_inst_t inst;
+    ::decode(inst.name, p);
+    Session *s = get_or_add_session(inst);
+    if (s->is_closed())
+      set_state(s, Session::STATE_OPEN);
+    s->decode(p);
+  }
+  dout(10) << "_load_finish v " << version
+	   << ", " << session_vals.size() << " sessions after '" << start_after << "'"
+	   << dendl;
+
+  if ((int)session_vals.size() >= g_conf->mds_sessionmap_keys_per_op) {
+    _load_next(session_vals.rbegin()->first);
+    return;
+  }
+
+  // what we just read is what is on disk
+  dirty_sessions.clear();
+  projected = committing = committed = version;
+  dump();
+  finish_contexts(g_ceph_context, waiting_for_load);
+}
+
+class C_SM_LoadLegacy : public Context {
+  SessionMap *sessionmap;
+public:
+  bufferlist bl;
+  C_SM_LoadLegacy(SessionMap *cm) : sessionmap(cm) {}
+  void finish(int r) {
+    sessionmap->_load_legacy_finish(r, bl);
+  }
+};
+
+void SessionMap::_load_legacy()
+{
+  C_SM_LoadLegacy *c = new C_SM_LoadLegacy(this);
   object_t oid = get_object_name();
   object_locator_t oloc(mds->mdsmap->get_metadata_pg_pool());
   mds->objecter->read_full(oid, oloc, CEPH_NOSNAP, &c->bl, 0, c);
 }
 
-void SessionMap::_load_finish(int r, bufferlist &bl)
+void SessionMap::_load_legacy_finish(int r, bufferlist &bl)
 { 
   bufferlist::iterator blp = bl.begin();
   dump();
   decode(blp);  // note: this sets last_cap_renew = now()
-  dout(10) << "_load_finish v " << version 
+  dout(10) << "_load_legacy_finish v " << version 
 	   << ", " << session_map.size() << " sessions, "
 	   << bl.length() << " bytes"
 	   << dendl;
   projected = committing = committed = version;
+
+  // the next save rewrites everything as omap and drops the blob
+  loaded_legacy = true;
+  for (hash_map<entity_name_t,Session*>::iterator p = session_map.begin();
+       p != session_map.end();
+       ++p)
+    mark_dirty(p->second);
+
   dump();
   finish_contexts(g_ceph_context, waiting_for_load);
 }
@@ -101,9 +196,16 @@ public:
   }
 };
 
+/**
+ * Write out the sessions that changed since the last save along with
+ * the new version in the omap header.  It all goes in one op, so the
+ * object never holds sessions newer than the version it claims; replay
+ * depends on that.
+ */
 void SessionMap::save(Context *onsave, version_t needv)
 {
-  dout(10) << "save needv " << needv << ", v " << version << dendl;
+  dout(10) << "save needv " << needv << ", v " << version
+	   << ", " << dirty_sessions.size() << " dirty sessions" << dendl;
  
   if (needv && committing >= needv) {
     assert(committing > committed);
@@ -112,19 +214,47 @@ void SessionMap::save(Context *onsave, version_t needv)
   }
 
   commit_waiters[version].push_back(onsave);
-  
-  bufferlist bl;
-  
-  encode(bl);
   committing = version;
+
+  map<string, bufferlist> to_set;
+  set<string> to_remove;
+  for (set<entity_name_t>::iterator p = dirty_sessions.begin();
+       p != dirty_sessions.end();
+       ++p) {
+    string key = stringify(*p);
+    Session *s = get_session(*p);
+    if (s && is_saved(s)) {
+      bufferlist &bl = to_set[key];
+      ::encode(*p, bl);
+      s->encode(bl);
+    } else {
+      to_remove.insert(key);
+    }
+  }
+  dirty_sessions.clear();
+
+  ObjectOperation m;
+  m.create(false);
+  if (loaded_legacy) {
+    // drop the old blob in the same op
+    m.truncate(0);
+    loaded_legacy = false;
+  }
+  if (!to_set.empty())
+    m.omap_set(to_set);
+  if (!to_remove.empty())
+    m.omap_rm_keys(to_remove);
+  bufferlist header;
+  __u8 struct_v = 1;
+  ::encode(struct_v, header);
+  ::encode(version, header);
+  m.omap_set_header(header);
+
   SnapContext snapc;
   object_t oid = get_object_name();
   object_locator_t oloc(mds->mdsmap->get_metadata_pg_pool());
-
-  mds->objecter->write_full(oid, oloc,
-			    snapc,
-			    bl, ceph_clock_now(g_ceph_context), 0,
-			    NULL, new C_SM_Save(this, version));
+  mds->objecter->mutate(oid, oloc, m, snapc, ceph_clock_now(g_ceph_context),
+			0, NULL, new C_SM_Save(this, version));
 }
 
 void SessionMap::_save_finish(version_t v)
@@ -139,28 +269,6 @@ void SessionMap::_save_finish(version_t v)
 
 // -------------------
 
-void SessionMap::encode(bufferlist& bl)
-{
-  uint64_t pre = -1;     // for 0.19 compatibility; we forgot an encoding prefix.
-  ::encode(pre, bl);
-
-  __u8 struct_v = 2;
-  ::encode(struct_v, bl);
-
-  ::encode(version, bl);
-
-  for (hash_map<entity_name_t,Session*>::iterator p = session_map.begin(); 
-       p != session_map.end(); 
-       ++p) 
-    if (p->second->is_open() ||
-	p->second->is_closing() ||
-	p->second->is_stale() ||
-	p->second->is_killing()) {
-      ::encode(p->first, bl);
-      p->second->encode(bl);
-    }
-}
-
 void SessionMap::decode(bufferlist::iterator& p)
 {
   utime_t now = ceph_clock_now(g_ceph_context);
@@ -235,6 +343,7 @@ void SessionMap::wipe_ino_prealloc()
     p->second->pending_prealloc_inos.clear();
     p->second->prealloc_inos.clear();
     p->second->used_inos.clear();
+    mark_dirty(p->second);
   }
   projected = ++version;
 }
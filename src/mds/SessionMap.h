@@ -168,11 +168,15 @@ public:
   void add_completed_request(tid_t t) {
     completed_requests.insert(t);
   }
-  void trim_completed_requests(tid_t mintid) {
+  bool trim_completed_requests(tid_t mintid) {
     // trim
+    bool erased = false;
     while (!completed_requests.empty() && 
-	   (mintid == 0 || *completed_requests.begin() < mintid))
+	   (mintid == 0 || *completed_requests.begin() < mintid)) {
       completed_requests.erase(completed_requests.begin());
+      erased = true;
+    }
+    return erased;
   }
   bool have_completed_request(tid_t tid) const {
     return completed_requests.count(tid);
@@ -231,6 +235,11 @@ class SessionMap {
 private:
   MDS *mds;
   hash_map<entity_name_t, Session*> session_map;
+
+  // sessions whose on-disk record is stale (changed, added or removed)
+  // since the last save
+  set<entity_name_t> dirty_sessions;
+  bool loaded_legacy;   // the object is still one encoded blob
 public:
   map<int,xlist<Session*>* > by_state;
   
@@ -239,9 +248,17 @@ public:  // i am lazy
   map<version_t, list<Context*> > commit_waiters;
 
 public:
-  SessionMap(MDS *m) : mds(m), 
+  SessionMap(MDS *m) : mds(m), loaded_legacy(false),
 		       version(0), projected(0), committing(0), committed(0) 
   { }
+
+  void mark_dirty(Session *s) {
+    dirty_sessions.insert(s->inst.name);
+  }
+  // only these make it to disk
+  static bool is_saved(Session *s) {
+    return s->is_open() || s->is_closing() || s->is_stale() || s->is_killing();
+  }
     
   // sessions
   bool empty() { return session_map.empty(); }
@@ -278,11 +295,13 @@ public:
       s = session_map[i.name] = new Session;
     s->inst = i;
     s->last_cap_renew = ceph_clock_now(g_ceph_context);
+    mark_dirty(s);
     return s;
   }
   void add_session(Session *s) {
     assert(session_map.count(s->inst.name) == 0);
     session_map[s->inst.name] = s;
+    mark_dirty(s);
     if (by_state.count(s->state) == 0)
       by_state[s->state] = new xlist<Session*>;
     by_state[s->state]->push_back(&s->item_session_list);
@@ -292,6 +311,7 @@ public:
     s->trim_completed_requests(0);
     s->item_session_list.remove_myself();
     session_map.erase(s->inst.name);
+    mark_dirty(s);
     s->put();
   }
   void touch_session(Session *session) {
@@ -313,6 +333,7 @@ public:
     if (session->state != s) {
       session->state = s;
       session->state_seq++;
+      mark_dirty(session);
       if (by_state.count(s) == 0)
 	by_state[s] = new xlist<Session*>;
       by_state[s]->push_back(&session->item_session_list);
@@ -367,11 +388,13 @@ public:
     session->add_completed_request(rid.tid);
     if (tid)
       session->trim_completed_requests(tid);
+    mark_dirty(session);
   }
   void trim_completed_requests(entity_name_t c, tid_t tid) {
     Session *session = get_session(c);
     assert(session);
     session->trim_completed_requests(tid);
+    mark_dirty(session);
   }
 
   void wipe();
@@ -381,13 +404,16 @@ public:
   inodeno_t ino;
   list<Context*> waiting_for_load;
 
-  void encode(bufferlist& bl);
   void decode(bufferlist::iterator& blp);
 
   object_t get_object_name();
 
   void load(Context *onload);
-  void _load_finish(int r, bufferlist &bl);
+  void _load_next(const string& start_after);
+  void _load_finish(int r, bufferlist &header, map<string, bufferlist> &session_vals,
+		    const string& start_after);
+  void _load_legacy();
+  void _load_legacy_finish(int r, bufferlist &bl);
   void save(Context *onsave, version_t needv=0);
   void _save_finish(version_t v);
  
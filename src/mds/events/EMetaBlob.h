@@ -68,7 +68,7 @@ public:
     bufferlist snapbl;
     bool dirty;
     struct default_file_layout *dir_layout;
-    typedef map<snapid_t, old_inode_t> old_inodes_t;
+    typedef compact_map<snapid_t, old_inode_t> old_inodes_t;
     old_inodes_t old_inodes;
 
     bufferlist _enc;
@@ -741,10 +741,12 @@ void EMetaBlob::replay(MDS *mds, LogSegment *logseg)
 	  assert(i == used_preallocated_ino);
 	  session->used_inos.clear();
 	}
+	mds->sessionmap.mark_dirty(session);
 	mds->sessionmap.projected = ++mds->sessionmap.version;
       }
       if (preallocated_inos.size()) {
 	session->prealloc_inos.insert(preallocated_inos);
+	mds->sessionmap.mark_dirty(session);
 	mds->sessionmap.projected = ++mds->sessionmap.version;
       }
       assert(sessionmapv == mds->sessionmap.version);
@@ -830,6 +832,7 @@ void ESession::replay(MDS *mds)
 	mds->sessionmap.remove_session(session);
       } else {
 	session->clear();    // the client has reconnected; keep the Session, but reset
+	mds->sessionmap.mark_dirty(session);
 	dout(10) << " reset session " << session->inst << " (they reconnected)" << dendl;
       }
     }
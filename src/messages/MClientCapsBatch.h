@@ -0,0 +1,102 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MCLIENTCAPSBATCH_H
+#define CEPH_MCLIENTCAPSBATCH_H
+
+#include "msg/Message.h"
+#include "MClientCaps.h"
+
+/*
+ * a bundle of cap updates/flushes/releases for many inodes, sent by
+ * clients that coalesce their cap traffic to an mds.  each entry is
+ * exactly what would have gone out as a standalone MClientCaps; the
+ * mds unpacks them and handles them in order.
+ */
+class MClientCapsBatch : public Message {
+ public:
+  vector<MClientCaps*> caps;
+
+  MClientCapsBatch() :
+    Message(CEPH_MSG_CLIENT_CAPS_BATCH) {}
+private:
+  ~MClientCapsBatch() {
+    for (vector<MClientCaps*>::iterator p = caps.begin(); p != caps.end(); ++p)
+      (*p)->put();
+  }
+
+public:
+  const char *get_type_name() const { return "client_caps_batch";}
+  void print(ostream& out) const {
+    out << "client_caps_batch(" << caps.size() << ")";
+  }
+
+  /*
+   * hand out the contained messages as if they had arrived on their
+   * own: same source, same connection.  the caller owns the returned
+   * refs; the batch keeps none.
+   */
+  void take_caps(vector<MClientCaps*>& ls) {
+    for (vector<MClientCaps*>::iterator p = caps.begin(); p != caps.end(); ++p) {
+      MClientCaps *m = *p;
+      uint64_t tid = m->get_tid();
+      int version = m->get_header().version;
+      m->set_header(get_header());
+      m->set_type(CEPH_MSG_CLIENT_CAPS);
+      m->set_tid(tid);
+      m->get_header().version = version;
+      if (get_connection())
+	m->set_connection(get_connection()->get());
+      m->set_recv_stamp(get_recv_stamp());
+      m->set_dispatch_stamp(get_dispatch_stamp());
+      ls.push_back(m);
+    }
+    caps.clear();
+  }
+
+  void decode_payload() {
+    bufferlist::iterator p = payload.begin();
+    __u32 n;
+    ::decode(n, p);
+    caps.reserve(n);
+    while (n--) {
+      MClientCaps *m = new MClientCaps;
+      uint64_t tid;
+      ::decode(tid, p);
+      m->set_tid(tid);
+      ::decode(m->head, p);
+      ::decode(m->snapbl, p);
+      ::decode(m->xattrbl, p);
+      ::decode(m->flockbl, p);
+      m->get_header().version = 2;
+      caps.push_back(m);
+    }
+  }
+  void encode_payload(uint64_t features) {
+    __u32 n = caps.size();
+    ::encode(n, payload);
+    for (vector<MClientCaps*>::iterator p = caps.begin(); p != caps.end(); ++p) {
+      MClientCaps *m = *p;
+      m->head.snap_trace_len = m->snapbl.length();
+      m->head.xattr_len = m->xattrbl.length();
+      ::encode(m->get_tid(), payload);
+      ::encode(m->head, payload);
+      ::encode(m->snapbl, payload);
+      ::encode(m->xattrbl, payload);
+      ::encode(m->flockbl, payload);
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,112 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MOSDSUBOPBATCH_H
+#define CEPH_MOSDSUBOPBATCH_H
+
+#include "msg/Message.h"
+#include "MOSDSubOp.h"
+
+/*
+ * several sub ops from one primary to one replica, used to push many
+ * small objects during recovery in one message.  each entry is exactly
+ * what would have gone out as a standalone MOSDSubOp; its data rides
+ * in our data section so that it isn't copied into the payload.
+ */
+class MOSDSubOpBatch : public Message {
+ public:
+  vector<MOSDSubOp*> subops;
+
+  MOSDSubOpBatch() :
+    Message(MSG_OSD_SUBOP_BATCH) {}
+private:
+  ~MOSDSubOpBatch() {
+    for (vector<MOSDSubOp*>::iterator p = subops.begin(); p != subops.end(); ++p)
+      (*p)->put();
+  }
+
+public:
+  const char *get_type_name() const { return "osd_sub_op_batch"; }
+  void print(ostream& out) const {
+    out << "osd_sub_op_batch(" << subops.size() << ")";
+  }
+
+  /*
+   * hand out the contained sub ops as if they had arrived on their
+   * own: same source, same connection.  the caller owns the returned
+   * refs; the batch keeps none.
+   */
+  void take_subops(vector<MOSDSubOp*>& ls) {
+    for (vector<MOSDSubOp*>::iterator p = subops.begin(); p != subops.end(); ++p) {
+      MOSDSubOp *m = *p;
+      uint64_t tid = m->get_tid();
+      int version = m->get_header().version;
+      m->set_header(get_header());
+      m->set_type(MSG_OSD_SUBOP);
+      m->set_tid(tid);
+      m->get_header().version = version;
+      if (get_connection())
+	m->set_connection(get_connection()->get());
+      m->set_recv_stamp(get_recv_stamp());
+      m->set_dispatch_stamp(get_dispatch_stamp());
+      ls.push_back(m);
+    }
+    subops.clear();
+  }
+
+  void decode_payload() {
+    bufferlist::iterator p = payload.begin();
+    __u32 n;
+    ::decode(n, p);
+    subops.reserve(n);
+    unsigned off = 0;
+    while (n--) {
+      MOSDSubOp *m = new MOSDSubOp;
+      uint64_t tid;
+      __u16 version;
+      __u32 data_len;
+      ::decode(tid, p);
+      ::decode(version, p);
+      ::decode(m->get_payload(), p);
+      ::decode(data_len, p);
+      m->set_tid(tid);
+      m->get_header().version = version;
+      bufferlist bl;
+      bl.substr_of(data, off, data_len);
+      off += data_len;
+      m->set_data(bl);
+      m->decode_payload();
+      subops.push_back(m);
+    }
+  }
+  void encode_payload(uint64_t features) {
+    __u32 n = subops.size();
+    ::encode(n, payload);
+    for (vector<MOSDSubOp*>::iterator p = subops.begin(); p != subops.end(); ++p) {
+      MOSDSubOp *m = *p;
+      m->clear_payload();
+      m->clear_data();
+      m->encode_payload(features);
+      __u16 version = m->get_header().version;
+      __u32 data_len = m->get_data().length();
+      ::encode(m->get_tid(), payload);
+      ::encode(version, payload);
+      ::encode(m->get_payload(), payload);
+      ::encode(data_len, payload);
+      data.append(m->get_data());
+    }
+  }
+};
+
+#endif
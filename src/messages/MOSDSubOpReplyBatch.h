@@ -0,0 +1,94 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2004-2006 Sage Weil <sage@newdream.net>
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MOSDSUBOPREPLYBATCH_H
+#define CEPH_MOSDSUBOPREPLYBATCH_H
+
+#include "msg/Message.h"
+#include "MOSDSubOpReply.h"
+
+/*
+ * replica acks/commits for many sub ops, possibly from different pgs,
+ * headed to the same primary.  each entry is exactly what would have
+ * gone out as a standalone MOSDSubOpReply.
+ */
+class MOSDSubOpReplyBatch : public Message {
+ public:
+  vector<MOSDSubOpReply*> replies;
+
+  MOSDSubOpReplyBatch() :
+    Message(MSG_OSD_SUBOPREPLY_BATCH) {}
+private:
+  ~MOSDSubOpReplyBatch() {
+    for (vector<MOSDSubOpReply*>::iterator p = replies.begin(); p != replies.end(); ++p)
+      (*p)->put();
+  }
+
+public:
+  const char *get_type_name() const { return "osd_sub_op_reply_batch"; }
+  void print(ostream& out) const {
+    out << "osd_sub_op_reply_batch(" << replies.size() << ")";
+  }
+
+  /*
+   * hand out the contained replies as if they had arrived on their
+   * own: same source, same connection.  the caller owns the returned
+   * refs; the batch keeps none.
+   */
+  void take_replies(vector<MOSDSubOpReply*>& ls) {
+    for (vector<MOSDSubOpReply*>::iterator p = replies.begin(); p != replies.end(); ++p) {
+      MOSDSubOpReply *m = *p;
+      uint64_t tid = m->get_tid();
+      m->set_header(get_header());
+      m->set_type(MSG_OSD_SUBOPREPLY);
+      m->set_tid(tid);
+      m->get_header().version = 1;
+      if (get_connection())
+	m->set_connection(get_connection()->get());
+      m->set_recv_stamp(get_recv_stamp());
+      m->set_dispatch_stamp(get_dispatch_stamp());
+      ls.push_back(m);
+    }
+    replies.clear();
+  }
+
+  void decode_payload() {
+    bufferlist::iterator p = payload.begin();
+    __u32 n;
+    ::decode(n, p);
+    replies.reserve(n);
+    while (n--) {
+      MOSDSubOpReply *m = new MOSDSubOpReply;
+      uint64_t tid;
+      ::decode(tid, p);
+      m->set_tid(tid);
+      ::decode(m->get_payload(), p);
+      m->decode_payload();
+      replies.push_back(m);
+    }
+  }
+  void encode_payload(uint64_t features) {
+    __u32 n = replies.size();
+    ::encode(n, payload);
+    for (vector<MOSDSubOpReply*>::iterator p = replies.begin(); p != replies.end(); ++p) {
+      MOSDSubOpReply *m = *p;
+      m->clear_payload();
+      m->encode_payload(features);
+      ::encode(m->get_tid(), payload);
+      ::encode(m->get_payload(), payload);
+    }
+  }
+};
+
+#endif
@@ -502,6 +502,10 @@ bool MDSMonitor::preprocess_command(MMonCommand *m)
   int r = -1;
   bufferlist rdata;
   stringstream ss;
+  bool cacheable = false;
+
+  if (reply_from_cache(m))
+    return true;
 
   vector<const char*> args;
   for (unsigned i = 1; i < m->cmd.size(); i++)
@@ -511,6 +515,7 @@ bool MDSMonitor::preprocess_command(MMonCommand *m)
     if (m->cmd[1] == "stat") {
       ss << mdsmap;
       r = 0;
+      cacheable = true;
     } 
     else if (m->cmd[1] == "dump") {
       string format = "plain";
@@ -561,6 +566,7 @@ bool MDSMonitor::preprocess_command(MMonCommand *m)
 	}
 	if (p != &mdsmap)
 	  delete p;
+	cacheable = (r == 0);
       }
     }
     else if (m->cmd[1] == "getmap") {
@@ -635,6 +641,8 @@ bool MDSMonitor::preprocess_command(MMonCommand *m)
   if (r != -1) {
     string rs;
     getline(ss, rs);
+    if (cacheable)
+      cache_reply(m, r, rs, rdata);
     mon->reply_command(m, r, rs, rdata, paxos->get_version());
     return true;
   } else
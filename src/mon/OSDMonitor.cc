@@ -111,6 +111,7 @@ void OSDMonitor::update_from_paxos()
     assert(success);
     
     dout(7) << "update_from_paxos  applying incremental " << osdmap.epoch+1 << dendl;
+    cache_map_bl(inc_bl_cache, osdmap.epoch+1, bl);
     OSDMap::Incremental inc(bl);
     osdmap.apply_incremental(inc);
 
@@ -118,6 +119,7 @@ void OSDMonitor::update_from_paxos()
     bl.clear();
     osdmap.encode(bl);
     mon->store->put_bl_sn(bl, "osdmap_full", osdmap.epoch);
+    cache_map_bl(full_bl_cache, osdmap.epoch, bl);
 
     // share
     dout(1) << osdmap << dendl;
@@ -168,8 +170,8 @@ void OSDMonitor::remove_redundant_pg_temp()
 {
   dout(10) << "remove_redundant_pg_temp" << dendl;
 
-  for (map<pg_t,vector<int> >::iterator p = osdmap.pg_temp.begin();
-       p != osdmap.pg_temp.end();
+  for (map<pg_t,vector<int> >::iterator p = osdmap.pg_temp->begin();
+       p != osdmap.pg_temp->end();
        p++) {
     if (pending_inc.new_pg_temp.count(p->first) == 0) {
       vector<int> raw_up;
@@ -312,11 +314,21 @@ void OSDMonitor::encode_pending(bufferlist &bl)
 }
 
 
+/*
+ * Tell a few osds about the new epoch; the rest hear about it from
+ * them (heartbeats, peering, and osd_map_share_fanout).
+ */
 void OSDMonitor::share_map_with_random_osd()
 {
-  // tell any osd
-  MonSession *s = mon->session_map.get_random_osd_session();
-  if (s) {
+  int fanout = MAX(1, g_conf->mon_osd_map_share_fanout);
+  set<int> told;
+  for (int i = 0; i < fanout; i++) {
+    MonSession *s = mon->session_map.get_random_osd_session();
+    if (!s)
+      break;
+    if (told.count(s->inst.name.num()))
+      continue;   // close enough
+    told.insert(s->inst.name.num());
     dout(10) << "committed, telling random " << s->inst << " all about it" << dendl;
     MOSDMap *m = build_incremental(osdmap.get_epoch() - 1, osdmap.get_epoch());  // whatev, they'll request more if they need it
     mon->messenger->send_message(m, s->inst);
@@ -777,14 +789,14 @@ bool OSDMonitor::preprocess_pgtemp(MOSDPGTemp *m)
 
   for (map<pg_t,vector<int> >::iterator p = m->pg_temp.begin(); p != m->pg_temp.end(); p++) {
     dout(20) << " " << p->first
-	     << (osdmap.pg_temp.count(p->first) ? osdmap.pg_temp[p->first] : empty)
+	     << (osdmap.pg_temp->count(p->first) ? (*osdmap.pg_temp)[p->first] : empty)
 	     << " -> " << p->second << dendl;
     // removal?
-    if (p->second.empty() && osdmap.pg_temp.count(p->first))
+    if (p->second.empty() && osdmap.pg_temp->count(p->first))
       return false;
     // change?
-    if (p->second.size() && (osdmap.pg_temp.count(p->first) == 0 ||
-			     osdmap.pg_temp[p->first] != p->second))
+    if (p->second.size() && (osdmap.pg_temp->count(p->first) == 0 ||
+			     (*osdmap.pg_temp)[p->first] != p->second))
       return false;
   }
 
@@ -934,11 +946,49 @@ void OSDMonitor::send_latest(PaxosServiceMessage *m, epoch_t start)
 }
 
 
+void OSDMonitor::cache_map_bl(map<epoch_t,bufferlist>& cache, epoch_t e, bufferlist& bl)
+{
+  cache[e] = bl;
+  while ((int)cache.size() > g_conf->mon_osd_cache_size)
+    cache.erase(cache.begin());
+}
+
+bool OSDMonitor::get_inc_bl(epoch_t e, bufferlist& bl)
+{
+  map<epoch_t,bufferlist>::iterator p = inc_bl_cache.find(e);
+  if (p != inc_bl_cache.end()) {
+    bl = p->second;
+    return true;
+  }
+  if (mon->store->get_bl_sn(bl, "osdmap", e) <= 0)
+    return false;
+  if (e + g_conf->mon_osd_cache_size > osdmap.get_epoch())
+    cache_map_bl(inc_bl_cache, e, bl);
+  return true;
+}
+
+bool OSDMonitor::get_full_bl(epoch_t e, bufferlist& bl)
+{
+  map<epoch_t,bufferlist>::iterator p = full_bl_cache.find(e);
+  if (p != full_bl_cache.end()) {
+    bl = p->second;
+    return true;
+  }
+  if (mon->store->get_bl_sn(bl, "osdmap_full", e) <= 0)
+    return false;
+  if (e + g_conf->mon_osd_cache_size > osdmap.get_epoch())
+    cache_map_bl(full_bl_cache, e, bl);
+  return true;
+}
+
 MOSDMap *OSDMonitor::build_latest_full()
 {
-  MOSDMap *r = new MOSDMap(mon->monmap->fsid, &osdmap);
+  MOSDMap *r = new MOSDMap(mon->monmap->fsid);
+  epoch_t e = osdmap.get_epoch();
+  if (!get_full_bl(e, r->maps[e]))
+    osdmap.encode(r->maps[e]);
   r->oldest_map = paxos->get_first_committed();
-  r->newest_map = osdmap.get_epoch();
+  r->newest_map = e;
   return r;
 }
 
@@ -953,11 +1003,11 @@ MOSDMap *OSDMonitor::build_incremental(epoch_t from, epoch_t to)
        e >= from && e > 0;
        e--) {
     bufferlist bl;
-    if (mon->store->get_bl_sn(bl, "osdmap", e) > 0) {
+    if (get_inc_bl(e, bl)) {
       dout(20) << "build_incremental    inc " << e << " " << bl.length() << " bytes" << dendl;
       m->incremental_maps[e] = bl;
     } 
-    else if (mon->store->get_bl_sn(bl, "osdmap_full", e) > 0) {
+    else if (get_full_bl(e, bl)) {
       dout(20) << "build_incremental   full " << e << " " << bl.length() << " bytes" << dendl;
       m->maps[e] = bl;
     }
@@ -981,7 +1031,7 @@ void OSDMonitor::send_incremental(PaxosServiceMessage *req, epoch_t first)
   if (first < paxos->get_first_committed()) {
     first = paxos->get_first_committed();
     bufferlist bl;
-    mon->store->get_bl_sn(bl, "osdmap_full", first);
+    get_full_bl(first, bl);
     dout(20) << "send_incremental starting with base full " << first << " " << bl.length() << " bytes" << dendl;
     MOSDMap *m = new MOSDMap(osdmap.get_fsid());
     m->oldest_map = paxos->get_first_committed();
@@ -1004,7 +1054,7 @@ void OSDMonitor::send_incremental(epoch_t first, entity_inst_t& dest, bool oneti
   if (first < paxos->get_first_committed()) {
     first = paxos->get_first_committed();
     bufferlist bl;
-    mon->store->get_bl_sn(bl, "osdmap_full", first);
+    get_full_bl(first, bl);
     dout(20) << "send_incremental starting with base full " << first << " " << bl.length() << " bytes" << dendl;
     MOSDMap *m = new MOSDMap(osdmap.get_fsid());
     m->oldest_map = paxos->get_first_committed();
@@ -1264,6 +1314,10 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
   int r = -1;
   bufferlist rdata;
   stringstream ss;
+  bool cacheable = false;
+
+  if (reply_from_cache(m))
+    return true;
 
   vector<const char*> args;
   for (unsigned i = 1; i < m->cmd.size(); i++)
@@ -1273,6 +1327,7 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
     if (m->cmd[1] == "stat") {
       osdmap.print_summary(ss);
       r = 0;
+      cacheable = true;
     }
     else if (m->cmd[1] == "dump" ||
 	     m->cmd[1] == "tree" ||
@@ -1333,12 +1388,13 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
 	  ss << "got osdmap epoch " << p->get_epoch();
 	  r = 0;
 	} else if (cmd == "getcrushmap") {
-	  p->crush.encode(rdata);
+	  p->crush->encode(rdata);
 	  ss << "got crush map from osdmap epoch " << p->get_epoch();
 	  r = 0;
 	}
 	if (p != &osdmap)
 	  delete p;
+	cacheable = (r == 0);
       }
     }
     else if (m->cmd[1] == "getmaxosd") {
@@ -1439,6 +1495,8 @@ bool OSDMonitor::preprocess_command(MMonCommand *m)
   if (r != -1) {
     string rs;
     getline(ss, rs);
+    if (cacheable)
+      cache_reply(m, r, rs, rdata);
     mon->reply_command(m, r, rs, rdata, paxos->get_version());
     return true;
   } else
@@ -1565,7 +1623,7 @@ bool OSDMonitor::prepare_command(MMonCommand *m)
 	if (pending_inc.crush.length())
 	  bl = pending_inc.crush;
 	else
-	  osdmap.crush.encode(bl);
+	  osdmap.crush->encode(bl);
 
 	CrushWrapper newcrush;
 	bufferlist::iterator p = bl.begin();
@@ -1596,7 +1654,7 @@ bool OSDMonitor::prepare_command(MMonCommand *m)
 	if (pending_inc.crush.length())
 	  bl = pending_inc.crush;
 	else
-	  osdmap.crush.encode(bl);
+	  osdmap.crush->encode(bl);
 
 	CrushWrapper newcrush;
 	bufferlist::iterator p = bl.begin();
@@ -1625,7 +1683,7 @@ bool OSDMonitor::prepare_command(MMonCommand *m)
 	if (pending_inc.crush.length())
 	  bl = pending_inc.crush;
 	else
-	  osdmap.crush.encode(bl);
+	  osdmap.crush->encode(bl);
 
 	CrushWrapper newcrush;
 	bufferlist::iterator p = bl.begin();
@@ -1652,10 +1710,10 @@ bool OSDMonitor::prepare_command(MMonCommand *m)
     }
     else if (m->cmd[1] == "setmaxosd" && m->cmd.size() > 2) {
       int newmax = atoi(m->cmd[2].c_str());
-      if (newmax < osdmap.crush.get_max_devices()) {
+      if (newmax < osdmap.crush->get_max_devices()) {
 	err = -ERANGE;
 	ss << "cannot set max_osd to " << newmax << " which is < crush max_devices "
-	   << osdmap.crush.get_max_devices();
+	   << osdmap.crush->get_max_devices();
 	goto out;
       }
 
@@ -2102,7 +2160,7 @@ bool OSDMonitor::prepare_command(MMonCommand *m)
 		return true;
 	      }
 	    } else if (m->cmd[4] == "crush_ruleset") {
-	      if (osdmap.crush.rule_exists(n)) {
+	      if (osdmap.crush->rule_exists(n)) {
 		if (pending_inc.new_pools.count(pool) == 0)
 		  pending_inc.new_pools[pool] = *p;
 		pending_inc.new_pools[pool].crush_ruleset = n;
@@ -2366,8 +2424,8 @@ int OSDMonitor::_prepare_remove_pool(uint64_t pool)
   pending_inc.old_pools.insert(pool);
 
   // remove any pg_temp mappings for this pool too
-  for (map<pg_t,vector<int32_t> >::iterator p = osdmap.pg_temp.begin();
-       p != osdmap.pg_temp.end();
+  for (map<pg_t,vector<int32_t> >::iterator p = osdmap.pg_temp->begin();
+       p != osdmap.pg_temp->end();
        ++p)
     if (p->first.pool() == pool) {
       dout(10) << "_prepare_remove_pool " << pool << " removing obsolete pg_temp "
@@ -49,6 +49,15 @@ private:
   map<int,utime_t>    down_pending_out;  // osd down -> out
 
   map<int,double> osd_weight;
+
+  // recently published maps, encoded.  every MOSDMap we build shares
+  // these buffers instead of reading its own copy out of the store.
+  map<epoch_t,bufferlist> inc_bl_cache;
+  map<epoch_t,bufferlist> full_bl_cache;
+  void cache_map_bl(map<epoch_t,bufferlist>& cache, epoch_t e, bufferlist& bl);
+  bool get_inc_bl(epoch_t e, bufferlist& bl);
+  bool get_full_bl(epoch_t e, bufferlist& bl);
+
   // svc
 public:  
   void create_initial();
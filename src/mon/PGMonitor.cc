@@ -676,7 +676,7 @@ bool PGMonitor::register_new_pgs()
     int64_t poolid = p->first;
     pg_pool_t &pool = p->second;
     int ruleno = pool.get_crush_ruleset();
-    if (!osdmap->crush.rule_exists(ruleno)) 
+    if (!osdmap->crush->rule_exists(ruleno)) 
       continue;
 
     if (pool.get_last_change() <= pg_map.last_pg_scan ||
@@ -712,7 +712,7 @@ bool PGMonitor::register_new_pgs()
     }
   }
 
-  int max = MIN(osdmap->get_max_osd(), osdmap->crush.get_max_devices());
+  int max = MIN(osdmap->get_max_osd(), osdmap->crush->get_max_devices());
   int removed = 0;
   for (set<pg_t>::iterator p = pg_map.creating_pgs.begin();
        p != pg_map.creating_pgs.end();
@@ -757,7 +757,7 @@ void PGMonitor::send_pg_creates()
   utime_t now = ceph_clock_now(g_ceph_context);
   
   OSDMap *osdmap = &mon->osdmon()->osdmap;
-  int max = MIN(osdmap->get_max_osd(), osdmap->crush.get_max_devices());
+  int max = MIN(osdmap->get_max_osd(), osdmap->crush->get_max_devices());
 
   for (set<pg_t>::iterator p = pg_map.creating_pgs.begin();
        p != pg_map.creating_pgs.end();
@@ -840,6 +840,10 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
   int r = -1;
   bufferlist rdata;
   stringstream ss;
+  bool cacheable = false;
+
+  if (reply_from_cache(m))
+    return true;
 
   vector<const char*> args;
   for (unsigned i = 1; i < m->cmd.size(); i++)
@@ -849,11 +853,13 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
     if (m->cmd[1] == "stat") {
       ss << pg_map;
       r = 0;
+      cacheable = true;
     }
     else if (m->cmd[1] == "getmap") {
       pg_map.encode(rdata);
       ss << "got pgmap version " << pg_map.version;
       r = 0;
+      cacheable = true;
     }
     else if (m->cmd[1] == "send_pg_creates") {
       send_pg_creates();
@@ -914,6 +920,7 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
 	if (r == 0) {
 	  rdata.append(ds);
 	  ss << "dumped " << what << " in format " << format;
+	  cacheable = true;
 	}
 	r = 0;
       }
@@ -928,6 +935,7 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
       stringstream ds;
       jsf.flush(ds);
       rdata.append(ds);
+      cacheable = true;
     }
     else if (m->cmd[1] == "dump_stuck") {
       r = dump_stuck_pg_stats(ss, rdata, args);
@@ -942,6 +950,7 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
       stringstream ds;
       jsf.flush(ds);
       rdata.append(ds);
+      cacheable = true;
     }
     else if (m->cmd[1] == "map" && m->cmd.size() == 3) {
       pg_t pgid;
@@ -1024,6 +1033,8 @@ bool PGMonitor::preprocess_command(MMonCommand *m)
   if (r != -1) {
     string rs;
     getline(ss, rs);
+    if (cacheable)
+      cache_reply(m, r, rs, rdata);
     mon->reply_command(m, r, rs, rdata, paxos->get_version());
     return true;
   } else
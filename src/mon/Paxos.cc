@@ -20,6 +20,7 @@
 #include "messages/MMonObserveNotify.h"
 
 #include "common/config.h"
+#include "common/perf_counters.h"
 
 #define dout_subsys ceph_subsys_paxos
 #undef dout_prefix
@@ -34,6 +35,19 @@ static ostream& _prefix(std::ostream *_dout, Monitor *mon, const string& name, i
 		<< ") ";
 }
 
+enum {
+  l_paxos_first = 456100,
+  l_paxos_collect,
+  l_paxos_collect_lat,
+  l_paxos_begin,
+  l_paxos_begin_bytes,
+  l_paxos_commit,
+  l_paxos_commit_lat,
+  l_paxos_accept_lat,
+  l_paxos_lease,
+  l_paxos_lease_ack_lat,
+  l_paxos_last,
+};
 
 
 void Paxos::init()
@@ -47,9 +61,33 @@ void Paxos::init()
   latest_stashed = get_stashed(temp);
   slurping = mon->store->get_int(machine_name, "slurping");
 
+  assert(!logger);
+  string n = string("paxos-") + machine_name;
+  PerfCountersBuilder pcb(g_ceph_context, n, l_paxos_first, l_paxos_last);
+  pcb.add_u64_counter(l_paxos_collect, "collect");
+  pcb.add_fl_avg(l_paxos_collect_lat, "collect_latency");
+  pcb.add_u64_counter(l_paxos_begin, "begin");
+  pcb.add_u64_counter(l_paxos_begin_bytes, "begin_bytes");
+  pcb.add_u64_counter(l_paxos_commit, "commit");
+  pcb.add_fl_avg(l_paxos_commit_lat, "commit_latency");   // begin -> majority
+  pcb.add_fl_avg(l_paxos_accept_lat, "accept_latency");   // begin -> whole quorum
+  pcb.add_u64_counter(l_paxos_lease, "lease");
+  pcb.add_fl_avg(l_paxos_lease_ack_lat, "lease_ack_latency");
+  logger = pcb.create_perf_counters();
+  g_ceph_context->get_perfcounters_collection()->add(logger);
+
   dout(10) << "init" << dendl;
 }
 
+void Paxos::shutdown()
+{
+  if (logger) {
+    g_ceph_context->get_perfcounters_collection()->remove(logger);
+    delete logger;
+    logger = NULL;
+  }
+}
+
 // ---------------------------------
 
 // PHASE 1
@@ -67,6 +105,8 @@ void Paxos::collect(version_t oldpn)
   uncommitted_value.clear();
   peer_first_committed.clear();
   peer_last_committed.clear();
+  collect_stamp = ceph_clock_now(g_ceph_context);
+  logger->inc(l_paxos_collect);
 
   // look for uncommitted value
   if (mon->store->exists_bl_sn(machine_name, last_committed+1)) {
@@ -313,6 +353,9 @@ void Paxos::handle_last(MMonPaxos *last)
       peer_first_committed.clear();
       peer_last_committed.clear();
 
+      logger->finc(l_paxos_collect_lat,
+		   (double)(ceph_clock_now(g_ceph_context) - collect_stamp));
+
       // almost...
       state = STATE_ACTIVE;
 
@@ -371,6 +414,9 @@ void Paxos::begin(bufferlist& v)
   accepted.clear();
   accepted.insert(mon->rank);
   new_value = v;
+  begin_stamp = ceph_clock_now(g_ceph_context);
+  logger->inc(l_paxos_begin);
+  logger->inc(l_paxos_begin_bytes, new_value.length());
   mon->store->put_bl_sn(new_value, machine_name, last_committed+1);
 
   if (mon->get_quorum().size() == 1) {
@@ -476,6 +522,8 @@ void Paxos::handle_accept(MMonPaxos *accept)
   // done?
   if (accepted == mon->get_quorum()) {
     dout(10) << " got quorum, done with update" << dendl;
+    logger->finc(l_paxos_accept_lat,
+		 (double)(ceph_clock_now(g_ceph_context) - begin_stamp));
     // cancel timeout event
     mon->timer.cancel_event(accept_timeout_event);
     accept_timeout_event = 0;
@@ -514,6 +562,8 @@ void Paxos::commit()
   // commit locally
   last_committed++;
   last_commit_time = ceph_clock_now(g_ceph_context);
+  logger->inc(l_paxos_commit);
+  logger->finc(l_paxos_commit_lat, (double)(last_commit_time - begin_stamp));
   mon->store->put_int(last_committed, machine_name, "last_committed");
   if (!first_committed) {
     first_committed = last_committed;
@@ -567,9 +617,11 @@ void Paxos::extend_lease()
   assert(is_active());
 
   lease_expire = ceph_clock_now(g_ceph_context);
+  lease_stamp = lease_expire;
   lease_expire += g_conf->mon_lease;
   acked_lease.clear();
   acked_lease.insert(mon->rank);
+  logger->inc(l_paxos_lease);
 
   dout(7) << "extend_lease now+" << g_conf->mon_lease << " (" << lease_expire << ")" << dendl;
 
@@ -682,6 +734,8 @@ void Paxos::handle_lease_ack(MMonPaxos *ack)
       // yay!
       dout(10) << "handle_lease_ack from " << ack->get_source() 
 	       << " -- got everyone" << dendl;
+      logger->finc(l_paxos_lease_ack_lat,
+		   (double)(ceph_clock_now(g_ceph_context) - lease_stamp));
       mon->timer.cancel_event(lease_ack_timeout_event);
       lease_ack_timeout_event = 0;
     } else {
@@ -63,6 +63,7 @@ e 12v
 class Monitor;
 class MMonPaxos;
 class Paxos;
+class PerfCounters;
 
 
 // i am one state machine.
@@ -124,6 +125,7 @@ private:
   // -- leader --
   // recovery (paxos phase 1)
   unsigned   num_last;
+  utime_t    collect_stamp;
   version_t  uncommitted_v;
   version_t  uncommitted_pn;
   bufferlist uncommitted_value;
@@ -132,6 +134,7 @@ private:
 
   // active
   set<int>   acked_lease;
+  utime_t    lease_stamp;      // when the outstanding OP_LEASE went out
   Context    *lease_renew_event;
   Context    *lease_ack_timeout_event;
   Context    *lease_timeout_event;
@@ -139,6 +142,7 @@ private:
   // updating (paxos phase 2)
   bufferlist new_value;
   set<int>   accepted;
+  utime_t    begin_stamp;      // when we sent OP_BEGIN for new_value
 
   Context    *accept_timeout_event;
 
@@ -158,6 +162,7 @@ private:
   utime_t last_clock_drift_warn;
   int clock_drift_warned;
 
+  PerfCounters *logger;
 
   class C_CollectTimeout : public Context {
     Paxos *paxos;
@@ -248,7 +253,8 @@ public:
 		   lease_ack_timeout_event(0),
 		   lease_timeout_event(0),
 		   accept_timeout_event(0),
-		   clock_drift_warned(0) { }
+		   clock_drift_warned(0),
+		   logger(0) { }
 
   const char *get_machine_name() const {
     return machine_name;
@@ -257,6 +263,7 @@ public:
   void dispatch(PaxosServiceMessage *m);
 
   void init();
+  void shutdown();
   /**
    * This function runs basic consistency checks. Importantly, if
    * it is inconsistent and shouldn't be, it asserts out.
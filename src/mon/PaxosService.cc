@@ -16,7 +16,7 @@
 #include "common/Clock.h"
 #include "Monitor.h"
 
-
+#include "messages/MMonCommand.h"
 
 #include "common/config.h"
 
@@ -105,6 +105,40 @@ bool PaxosService::should_propose(double& delay)
 }
 
 void PaxosService::propose_pending()
+{
+  _propose_pending();
+  if (g_conf->paxos_coalesce_proposals)
+    propose_waiting_services();
+}
+
+/*
+ * Other services with updates sitting behind their propose timer go
+ * out in the same window as this one, so a burst that touches several
+ * maps (osd boot: osdmap, pgmap, auth) commits together instead of
+ * staggered by each service's paxos_min_wait.  Only services whose
+ * paxos_propose_interval damping has already run out are pulled in;
+ * the others keep their timer, so e.g. a pgmap commit never makes a
+ * flapping cluster produce osdmap epochs faster than once per interval.
+ */
+void PaxosService::propose_waiting_services()
+{
+  utime_t now = ceph_clock_now(g_ceph_context);
+  for (vector<PaxosService*>::iterator p = mon->paxos_service.begin();
+       p != mon->paxos_service.end();
+       ++p) {
+    PaxosService *s = *p;
+    if (s == this || !s->proposal_timer || !s->have_pending ||
+	!s->paxos->is_writeable())
+      continue;
+    if ((double)(now - s->paxos->last_commit_time) < g_conf->paxos_propose_interval)
+      continue;
+    dout(10) << "propose_waiting_services also proposing "
+	     << s->paxos->get_machine_name() << dendl;
+    s->_propose_pending();
+  }
+}
+
+void PaxosService::_propose_pending()
 {
   dout(10) << "propose_pending" << dendl;
   assert(have_pending);
@@ -189,6 +223,53 @@ void PaxosService::_active()
 }
 
 
+string PaxosService::reply_cache_key(MMonCommand *m)
+{
+  string key;
+  for (vector<string>::iterator p = m->cmd.begin(); p != m->cmd.end(); ++p) {
+    key += *p;
+    key += '\0';
+  }
+  return key;
+}
+
+void PaxosService::trim_reply_cache()
+{
+  if (reply_cache_version != paxos->get_version()) {
+    reply_cache.clear();
+    reply_cache_version = paxos->get_version();
+  }
+}
+
+/*
+ * Answer m from the cache if we already built the reply for this
+ * command at the current version.  Consumes m on a hit.
+ */
+bool PaxosService::reply_from_cache(MMonCommand *m)
+{
+  trim_reply_cache();
+  map<string, cached_reply_t>::iterator p = reply_cache.find(reply_cache_key(m));
+  if (p == reply_cache.end())
+    return false;
+  dout(10) << "reply_from_cache " << m->cmd << " v" << reply_cache_version << dendl;
+  bufferlist rdata = p->second.rdata;  // shares the buffers
+  mon->reply_command(m, p->second.r, p->second.rs, rdata, reply_cache_version);
+  return true;
+}
+
+void PaxosService::cache_reply(MMonCommand *m, int r, const string& rs, bufferlist& rdata)
+{
+  if (g_conf->mon_cached_replies <= 0)
+    return;
+  trim_reply_cache();
+  if ((int)reply_cache.size() >= g_conf->mon_cached_replies)
+    reply_cache.erase(reply_cache.begin());
+  cached_reply_t& c = reply_cache[reply_cache_key(m)];
+  c.r = r;
+  c.rs = rs;
+  c.rdata = rdata;
+}
+
 void PaxosService::shutdown()
 {
   paxos->cancel_events();
@@ -197,4 +278,6 @@ void PaxosService::shutdown()
     mon->timer.cancel_event(proposal_timer);
     proposal_timer = 0;
   }
+
+  reply_cache.clear();
 }
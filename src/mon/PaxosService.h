@@ -20,6 +20,7 @@
 
 class Monitor;
 class Paxos;
+class MMonCommand;
 
 class PaxosService {
 public:
@@ -62,10 +63,32 @@ private:
   Context *proposal_timer;
   bool have_pending;
 
+  /*
+   * Replies to read-only commands (dump, stat, getmap...) depend only
+   * on the command line and the map version, so we keep them around
+   * until the next commit.  Tools that poll "pg dump" every few seconds
+   * then cost a map lookup instead of a full dump under the mon lock.
+   */
+  struct cached_reply_t {
+    int r;
+    string rs;
+    bufferlist rdata;
+  };
+  map<string, cached_reply_t> reply_cache;
+  version_t reply_cache_version;
+
+  static string reply_cache_key(MMonCommand *m);
+  void trim_reply_cache();
+
+protected:
+  bool reply_from_cache(MMonCommand *m);
+  void cache_reply(MMonCommand *m, int r, const string& rs, bufferlist& rdata);
+
 public:
   PaxosService(Monitor *mn, Paxos *p) : mon(mn), paxos(p),
 					proposal_timer(0),
-					have_pending(false) { }
+					have_pending(false),
+					reply_cache_version(0) { }
   virtual ~PaxosService() {}
 
   const char *get_machine_name();
@@ -77,6 +100,8 @@ public:
 
 private:
   void _active();
+  void _propose_pending();
+  void propose_waiting_services();
 
 public:
   // i implement and you use
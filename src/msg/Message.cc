@@ -58,6 +58,8 @@ using namespace std;
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDSubOpReply.h"
+#include "messages/MOSDSubOpReplyBatch.h"
+#include "messages/MOSDSubOpBatch.h"
 #include "messages/MOSDMap.h"
 
 #include "messages/MOSDPGNotify.h"
@@ -92,6 +94,7 @@ using namespace std;
 #include "messages/MClientReply.h"
 #include "messages/MClientCaps.h"
 #include "messages/MClientCapRelease.h"
+#include "messages/MClientCapsBatch.h"
 #include "messages/MClientLease.h"
 #include "messages/MClientSnap.h"
 
@@ -368,6 +371,12 @@ Message *decode_message(CephContext *cct, ceph_msg_header& header, ceph_msg_foot
   case MSG_OSD_SUBOPREPLY:
     m = new MOSDSubOpReply();
     break;
+  case MSG_OSD_SUBOPREPLY_BATCH:
+    m = new MOSDSubOpReplyBatch();
+    break;
+  case MSG_OSD_SUBOP_BATCH:
+    m = new MOSDSubOpBatch();
+    break;
 
   case CEPH_MSG_OSD_MAP:
     m = new MOSDMap;
@@ -457,6 +466,9 @@ Message *decode_message(CephContext *cct, ceph_msg_header& header, ceph_msg_foot
   case CEPH_MSG_CLIENT_CAPRELEASE:
     m = new MClientCapRelease;
     break;
+  case CEPH_MSG_CLIENT_CAPS_BATCH:
+    m = new MClientCapsBatch;
+    break;
   case CEPH_MSG_CLIENT_LEASE:
     m = new MClientLease;
     break;
@@ -80,10 +80,13 @@
 
 #define MSG_OSD_PG_SCAN        94
 #define MSG_OSD_PG_BACKFILL    95
+#define MSG_OSD_SUBOPREPLY_BATCH 96
 
 #define MSG_COMMAND            97
 #define MSG_COMMAND_REPLY      98
 
+#define MSG_OSD_SUBOP_BATCH    99
+
 // *** MDS ***
 
 #define MSG_MDS_BEACON             100  // to monitor
@@ -195,6 +195,7 @@ ObjectMap::ObjectMapIterator DBObjectMap::get_iterator(
   const hobject_t &hoid,
   Index index)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return ObjectMapIterator(new EmptyIteratorImpl());
@@ -382,26 +383,26 @@ int DBObjectMap::set_keys(const hobject_t &hoid,
 			  Index index,
 			  const map<string, bufferlist> &set)
 {
-  KeyValueDB::Transaction t = db->get_transaction();
+  KeyValueDB::Transaction t = get_batch_transaction();
   Header header = lookup_create_map_header(index->coll(), hoid, t);
   if (!header)
     return -EINVAL;
 
   t->set(user_prefix(header), set);
 
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::set_header(const hobject_t &hoid,
 			    Index index,
 			    const bufferlist &bl)
 {
-  KeyValueDB::Transaction t = db->get_transaction();
+  KeyValueDB::Transaction t = get_batch_transaction();
   Header header = lookup_create_map_header(index->coll(), hoid, t);
   if (!header)
     return -EINVAL;
   _set_header(header, bl, t);
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 void DBObjectMap::_set_header(Header header, const bufferlist &bl,
@@ -416,6 +417,7 @@ int DBObjectMap::get_header(const hobject_t &hoid,
 			    Index index,
 			    bufferlist *bl)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header) {
     return 0;
@@ -451,6 +453,7 @@ int DBObjectMap::_get_header(Header header,
 int DBObjectMap::clear(const hobject_t &hoid,
 		       Index index)
 {
+  flush_batch();
   KeyValueDB::Transaction t = db->get_transaction();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
@@ -461,7 +464,7 @@ int DBObjectMap::clear(const hobject_t &hoid,
   int r = _clear(header, t);
   if (r < 0)
     return r;
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::_clear(Header header,
@@ -574,12 +577,17 @@ int DBObjectMap::rm_keys(const hobject_t &hoid,
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
-  KeyValueDB::Transaction t = db->get_transaction();
-  t->rmkeys(user_prefix(header), to_clear);
   if (!header->parent) {
-    return db->submit_transaction(t);
+    KeyValueDB::Transaction t = get_batch_transaction();
+    t->rmkeys(user_prefix(header), to_clear);
+    return submit(t);
   }
 
+  // the copy up below reads keys, so it has to see everything before it
+  flush_batch();
+  KeyValueDB::Transaction t = db->get_transaction();
+  t->rmkeys(user_prefix(header), to_clear);
+
   // Copy up keys from parent around to_clear
   int keep_parent;
   {
@@ -637,7 +645,7 @@ int DBObjectMap::rm_keys(const hobject_t &hoid,
     set_header(header, t);
     t->rmkeys_by_prefix(complete_prefix(header));
   }
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::get(const hobject_t &hoid,
@@ -645,6 +653,7 @@ int DBObjectMap::get(const hobject_t &hoid,
 		     bufferlist *_header,
 		     map<string, bufferlist> *out)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
@@ -662,6 +671,7 @@ int DBObjectMap::get_keys(const hobject_t &hoid,
 			  Index index,
 			  set<string> *keys)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
@@ -701,6 +711,7 @@ int DBObjectMap::get_values(const hobject_t &hoid,
 			    const set<string> &keys,
 			    map<string, bufferlist> *out)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
@@ -712,6 +723,7 @@ int DBObjectMap::check_keys(const hobject_t &hoid,
 			    const set<string> &keys,
 			    set<string> *out)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
@@ -723,6 +735,7 @@ int DBObjectMap::get_xattrs(const hobject_t &hoid,
 			    const set<string> &to_get,
 			    map<string, bufferlist> *out)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
@@ -733,6 +746,7 @@ int DBObjectMap::get_all_xattrs(const hobject_t &hoid,
 				Index index,
 				set<string> *out)
 {
+  flush_batch();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
@@ -748,24 +762,24 @@ int DBObjectMap::set_xattrs(const hobject_t &hoid,
 			    Index index,
 			    const map<string, bufferlist> &to_set)
 {
-  KeyValueDB::Transaction t = db->get_transaction();
+  KeyValueDB::Transaction t = get_batch_transaction();
   Header header = lookup_create_map_header(index->coll(), hoid, t);
   if (!header)
     return -EINVAL;
   t->set(xattr_prefix(header), to_set);
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::remove_xattrs(const hobject_t &hoid,
 			       Index index,
 			       const set<string> &to_remove)
 {
-  KeyValueDB::Transaction t = db->get_transaction();
+  KeyValueDB::Transaction t = get_batch_transaction();
   Header header = lookup_map_header(index->coll(), hoid);
   if (!header)
     return -ENOENT;
   t->rmkeys(xattr_prefix(header), to_remove);
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::clone(const hobject_t &hoid,
@@ -775,6 +789,7 @@ int DBObjectMap::clone(const hobject_t &hoid,
 {
   assert(index->coll() != target_index->coll() ||
 	 hoid != target);
+  flush_batch();
   KeyValueDB::Transaction t = db->get_transaction();
   {
     Header destination = lookup_map_header(target_index->coll(), target);
@@ -787,7 +802,7 @@ int DBObjectMap::clone(const hobject_t &hoid,
 
   Header parent = lookup_map_header(index->coll(), hoid);
   if (!parent)
-    return db->submit_transaction(t);
+    return submit(t);
 
   Header source = generate_new_header(index->coll(), hoid, parent);
   Header destination = generate_new_header(target_index->coll(), target, parent);
@@ -825,7 +840,7 @@ int DBObjectMap::clone(const hobject_t &hoid,
     remove_map_header(p.first, p.second, parent, t);
     set_map_header(p.first, p.second, lsource , t);
   }
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::link(const hobject_t &hoid,
@@ -835,6 +850,7 @@ int DBObjectMap::link(const hobject_t &hoid,
 {
   assert(index->coll() != target_index->coll() ||
 	 hoid != target);
+  flush_batch();
   KeyValueDB::Transaction t = db->get_transaction();
   {
     Header destination = lookup_map_header(target_index->coll(), target);
@@ -852,7 +868,7 @@ int DBObjectMap::link(const hobject_t &hoid,
   _Header ldestination;
   ldestination.parent = header->seq;
   set_map_header(target_index->coll(), target, ldestination, t);
-  return db->submit_transaction(t);
+  return submit(t);
 }
 
 int DBObjectMap::init() {
@@ -876,6 +892,78 @@ int DBObjectMap::sync() {
   return write_state(true);
 }
 
+void DBObjectMap::start_batch()
+{
+  Mutex::Locker l(batch_lock);
+  Batch *&b = batches[pthread_self()];
+  assert(!b);
+  b = new Batch;
+  b->t = db->get_transaction();
+}
+
+int DBObjectMap::end_batch(unsigned *ops, unsigned *writes)
+{
+  int r = flush_batch();
+  Batch *b;
+  {
+    Mutex::Locker l(batch_lock);
+    map<pthread_t, Batch*>::iterator p = batches.find(pthread_self());
+    assert(p != batches.end());
+    b = p->second;
+    batches.erase(p);
+  }
+  *ops = b->ops;
+  *writes = b->writes;
+  delete b;
+  return r;
+}
+
+DBObjectMap::Batch *DBObjectMap::get_batch()
+{
+  Mutex::Locker l(batch_lock);
+  map<pthread_t, Batch*>::iterator p = batches.find(pthread_self());
+  if (p == batches.end())
+    return NULL;
+  return p->second;
+}
+
+KeyValueDB::Transaction DBObjectMap::get_batch_transaction()
+{
+  Batch *b = get_batch();
+  if (b)
+    return b->t;
+  return db->get_transaction();
+}
+
+int DBObjectMap::flush_batch()
+{
+  Batch *b = get_batch();
+  if (!b || !b->pending)
+    return 0;
+  dout(20) << "flush_batch: " << b->pending << " ops" << dendl;
+  int r = db->submit_transaction(b->t);
+  b->writes++;
+  b->pending = 0;
+  b->t = db->get_transaction();
+  b->leaves.clear();
+  b->headers.clear();
+  return r;
+}
+
+int DBObjectMap::submit(KeyValueDB::Transaction t)
+{
+  Batch *b = get_batch();
+  if (b) {
+    b->ops++;
+    if (t == b->t) {
+      b->pending++;
+      return 0;
+    }
+    b->writes++;
+  }
+  return db->submit_transaction(t);
+}
+
 int DBObjectMap::write_state(bool sync) {
   dout(20) << "dbobjectmap: seq is " << next_seq << dendl;
   KeyValueDB::Transaction t = db->get_transaction();
@@ -892,36 +980,89 @@ int DBObjectMap::write_state(bool sync) {
 
 DBObjectMap::Header DBObjectMap::lookup_map_header(coll_t c, const hobject_t &hoid)
 {
-  Mutex::Locker l(header_lock);
+  Batch *batch = get_batch();
+  string leaf_key = map_header_key(c, hoid);
   _Header lheader;
+  _Header cached;
+  bool from_cache, from_db;
+  uint64_t epoch;
   while (true) {
+    epoch = cache_get_epoch();
+    from_cache = from_db = false;
+    map<string, _Header>::iterator bp;
+    if (batch && (bp = batch->leaves.find(leaf_key)) != batch->leaves.end()) {
+      lheader = bp->second;
+    } else if (cache_lookup(leaf_key, &cached)) {
+      lheader.parent = cached.seq;
+      from_cache = true;
+    } else {
+      map<string, bufferlist> out;
+      set<string> keys;
+      keys.insert(leaf_key);
+      int r = db->get(LEAF_PREFIX, keys, &out);
+      if (r < 0)
+	return Header();
+      if (out.size() < 1)
+	return Header();
+      bufferlist::iterator iter = out.begin()->second.begin();
+      lheader.decode(iter);
+      from_db = true;
+    }
+
+    HeaderShard &shard = get_header_shard(lheader.parent);
+    Mutex::Locker l(shard.lock);
+    if (shard.in_use.count(lheader.parent)) {
+      shard.cond.Wait(shard.lock);
+      continue;
+    }
+    shard.in_use.insert(lheader.parent);
+    break;
+  }
+
+  dout(20) << "lookup_map_header: parent seq is " << lheader.parent
+       << " for hoid " << hoid << (from_cache ? " (cached)" : "") << dendl;
+  if (batch) {
+    map<uint64_t, _Header>::iterator bp = batch->headers.find(lheader.parent);
+    if (bp != batch->headers.end()) {
+      Header header = Header(new _Header(bp->second), RemoveOnDelete(this));
+      return header;
+    }
+  }
+  if (from_cache) {
+    // whoever held the seq while we waited may have moved the leaf
+    if (cache_lookup(leaf_key, &cached) && cached.seq == lheader.parent)
+      return Header(new _Header(cached), RemoveOnDelete(this));
+    put_header_seq(lheader.parent);
+    return lookup_map_header(c, hoid);
+  }
+  if (from_db) {
+    // same here: a clear or clone may have committed and released the
+    // seq between our leaf read and taking it
     map<string, bufferlist> out;
     set<string> keys;
-    keys.insert(map_header_key(c, hoid));
+    keys.insert(leaf_key);
     int r = db->get(LEAF_PREFIX, keys, &out);
-    if (r < 0)
-      return Header();
-    if (out.size() < 1)
+    if (r < 0 || out.size() < 1) {
+      put_header_seq(lheader.parent);
       return Header();
+    }
+    _Header now;
     bufferlist::iterator iter = out.begin()->second.begin();
-    lheader.decode(iter);
-
-    if (in_use.count(lheader.parent)) {
-      header_cond.Wait(header_lock);
-      continue;
+    now.decode(iter);
+    if (now.parent != lheader.parent) {
+      put_header_seq(lheader.parent);
+      return lookup_map_header(c, hoid);
     }
-    in_use.insert(lheader.parent);
-    break;
   }
 
-  dout(20) << "lookup_map_header: parent seq is " << lheader.parent
-       << " for hoid " << hoid << dendl;
   map<string, bufferlist> out;
   set<string> keys;
   keys.insert(HEADER_KEY);
   int r = db->get(sys_parent_prefix(lheader), keys, &out);
-  if (r < 0)
+  if (r < 0) {
+    put_header_seq(lheader.parent);
     return Header();
+  }
   assert(out.size());
 
   Header header = Header(new _Header(), RemoveOnDelete(this));
@@ -929,6 +1070,7 @@ DBObjectMap::Header DBObjectMap::lookup_map_header(coll_t c, const hobject_t &ho
 
   bufferlist::iterator iter = out.begin()->second.begin();
   header->decode(iter);
+  cache_add(leaf_key, *header, epoch);
   return header;
 }
 
@@ -943,8 +1085,12 @@ DBObjectMap::Header DBObjectMap::generate_new_header(coll_t c, const hobject_t &
   header->num_children = 1;
   header->c = c;
   header->hoid = hoid;
-  assert(!in_use.count(header->seq));
-  in_use.insert(header->seq);
+  {
+    HeaderShard &shard = get_header_shard(header->seq);
+    Mutex::Locker sl(shard.lock);
+    assert(!shard.in_use.count(header->seq));
+    shard.in_use.insert(header->seq);
+  }
 
   write_state();
   return header;
@@ -952,9 +1098,13 @@ DBObjectMap::Header DBObjectMap::generate_new_header(coll_t c, const hobject_t &
 
 DBObjectMap::Header DBObjectMap::lookup_parent(Header input)
 {
-  Mutex::Locker l(header_lock);
-  while (in_use.count(input->parent))
-    header_cond.Wait(header_lock);
+  {
+    HeaderShard &shard = get_header_shard(input->parent);
+    Mutex::Locker l(shard.lock);
+    while (shard.in_use.count(input->parent))
+      shard.cond.Wait(shard.lock);
+    shard.in_use.insert(input->parent);
+  }
   map<string, bufferlist> out;
   set<string> keys;
   keys.insert(HEADER_KEY);
@@ -977,10 +1127,89 @@ DBObjectMap::Header DBObjectMap::lookup_parent(Header input)
   header->decode(iter);
   dout(20) << "lookup_parent: parent seq is " << header->seq << " with parent "
        << header->parent << dendl;
-  in_use.insert(header->seq);
   return header;
 }
 
+void DBObjectMap::put_header_seq(uint64_t seq)
+{
+  HeaderShard &shard = get_header_shard(seq);
+  Mutex::Locker l(shard.lock);
+  shard.in_use.erase(seq);
+  shard.cond.SignalAll();
+}
+
+uint64_t DBObjectMap::cache_get_epoch()
+{
+  Mutex::Locker l(cache_lock);
+  return cache_epoch;
+}
+
+bool DBObjectMap::cache_lookup(const string &key, _Header *out)
+{
+  Mutex::Locker l(cache_lock);
+  map<string, CacheEntry>::iterator p = cache.find(key);
+  if (p == cache.end())
+    return false;
+  cache_lru.splice(cache_lru.begin(), cache_lru, p->second.lru);
+  *out = p->second.header;
+  return true;
+}
+
+void DBObjectMap::cache_add(const string &key, const _Header &header,
+			    uint64_t epoch)
+{
+  Mutex::Locker l(cache_lock);
+  if (!cache_max || epoch != cache_epoch)
+    return;
+  map<string, CacheEntry>::iterator p = cache.find(key);
+  if (p != cache.end())
+    _cache_remove(p);
+  cache_lru.push_front(key);
+  CacheEntry &e = cache[key];
+  e.header = header;
+  e.lru = cache_lru.begin();
+  cache_by_seq.insert(make_pair(header.seq, key));
+  while (cache.size() > cache_max)
+    _cache_remove(cache.find(cache_lru.back()));
+}
+
+void DBObjectMap::_cache_remove(map<string, CacheEntry>::iterator p)
+{
+  pair<multimap<uint64_t, string>::iterator,
+       multimap<uint64_t, string>::iterator> r =
+    cache_by_seq.equal_range(p->second.header.seq);
+  for (multimap<uint64_t, string>::iterator i = r.first; i != r.second; ++i) {
+    if (i->second == p->first) {
+      cache_by_seq.erase(i);
+      break;
+    }
+  }
+  cache_lru.erase(p->second.lru);
+  cache.erase(p);
+}
+
+void DBObjectMap::cache_invalidate_key(const string &key)
+{
+  Mutex::Locker l(cache_lock);
+  cache_epoch++;
+  map<string, CacheEntry>::iterator p = cache.find(key);
+  if (p != cache.end())
+    _cache_remove(p);
+}
+
+void DBObjectMap::cache_invalidate_seq(uint64_t seq)
+{
+  Mutex::Locker l(cache_lock);
+  cache_epoch++;
+  multimap<uint64_t, string>::iterator i = cache_by_seq.find(seq);
+  while (i != cache_by_seq.end() && i->first == seq) {
+    map<string, CacheEntry>::iterator p = cache.find(i->second);
+    assert(p != cache.end());
+    _cache_remove(p);
+    i = cache_by_seq.find(seq);
+  }
+}
+
 DBObjectMap::Header DBObjectMap::lookup_create_map_header(coll_t c, const hobject_t &hoid,
 							  KeyValueDB::Transaction t)
 {
@@ -991,6 +1220,14 @@ DBObjectMap::Header DBObjectMap::lookup_create_map_header(coll_t c, const hobjec
     _Header lheader;
     lheader.parent = header->seq;
     set_map_header(c, hoid, lheader, t);
+    Batch *batch = get_batch();
+    if (batch) {
+      batch->writes++;  // generate_new_header wrote next_seq
+      if (t == batch->t) {
+	batch->leaves[map_header_key(c, hoid)] = lheader;
+	batch->headers[header->seq] = *header;
+      }
+    }
   }
   return header;
 }
@@ -998,6 +1235,7 @@ DBObjectMap::Header DBObjectMap::lookup_create_map_header(coll_t c, const hobjec
 void DBObjectMap::clear_header(Header header, KeyValueDB::Transaction t)
 {
   dout(20) << "clear_header: clearing seq " << header->seq << dendl;
+  cache_invalidate_seq(header->seq);
   t->rmkeys_by_prefix(user_prefix(header));
   t->rmkeys_by_prefix(sys_prefix(header));
   t->rmkeys_by_prefix(complete_prefix(header));
@@ -1010,6 +1248,7 @@ void DBObjectMap::clear_header(Header header, KeyValueDB::Transaction t)
 void DBObjectMap::set_header(Header header, KeyValueDB::Transaction t)
 {
   dout(20) << "set_header: setting seq " << header->seq << dendl;
+  cache_invalidate_seq(header->seq);
   map<string, bufferlist> to_write;
   header->encode(to_write[HEADER_KEY]);
   t->set(sys_prefix(header), to_write);
@@ -1021,6 +1260,7 @@ void DBObjectMap::remove_map_header(coll_t c, const hobject_t &hoid,
 {
   dout(20) << "remove_map_header: removing " << header->seq
        << " hoid " << hoid << dendl;
+  cache_invalidate_key(map_header_key(c, hoid));
   set<string> to_remove;
   to_remove.insert(map_header_key(c, hoid));
   t->rmkeys(LEAF_PREFIX, to_remove);
@@ -1036,6 +1276,7 @@ void DBObjectMap::set_map_header(coll_t c, const hobject_t &hoid, _Header header
   dout(20) << "set_map_header: setting " << header.seq
        << " hoid " << hoid << " parent seq "
        << header.parent << dendl;
+  cache_invalidate_key(map_header_key(c, hoid));
   map<string, bufferlist> to_set;
   header.encode(to_set[map_header_key(c, hoid)]);
   t->set(LEAF_PREFIX, to_set);
@@ -66,18 +66,33 @@ public:
   uint64_t next_seq;
 
   /**
-   * Serializes access to next_seq as well as the in_use set
+   * Serializes access to next_seq
    */
   Mutex header_lock;
-  Cond header_cond;
 
   /**
-   * Set of headers currently in use
+   * Headers currently in use, sharded by seq so that lookups of
+   * unrelated objects don't wait on each other
    */
-  set<uint64_t> in_use;
+  struct HeaderShard {
+    Mutex lock;
+    Cond cond;
+    set<uint64_t> in_use;
+    HeaderShard() : lock("DBObjectMap::HeaderShard::lock") {}
+  };
+  static const unsigned NUM_HEADER_SHARDS = 32;
+  HeaderShard header_shards[NUM_HEADER_SHARDS];
+
+  HeaderShard &get_header_shard(uint64_t seq) {
+    return header_shards[seq % NUM_HEADER_SHARDS];
+  }
 
-  DBObjectMap(KeyValueDB *db) : db(db), next_seq(1),
-				header_lock("DBOBjectMap")
+  DBObjectMap(KeyValueDB *db, unsigned cache_size = 1024) :
+    db(db), next_seq(1),
+    header_lock("DBOBjectMap"),
+    batch_lock("DBObjectMap::batch_lock"),
+    cache_lock("DBObjectMap::cache_lock"),
+    cache_max(cache_size), cache_epoch(0)
     {}
 
   int set_keys(
@@ -184,6 +199,9 @@ public:
   /// Ensure that all previous operations are durable
   int sync();
 
+  void start_batch();
+  int end_batch(unsigned *ops, unsigned *writes);
+
   ObjectMapIterator get_iterator(const hobject_t &hoid,
 				 Index index);
 
@@ -275,6 +293,67 @@ private:
   /// Implicit lock on Header->seq
   typedef std::tr1::shared_ptr<_Header> Header;
 
+  /**
+   * Mutations gathered for one thread between start_batch() and
+   * end_batch().  Only mutations which read nothing but the object's
+   * header (set_keys, set_header, set_xattrs, remove_xattrs, rm_keys
+   * without a parent) go into t; anything else flushes t first and
+   * then writes on its own, as do reads, so that nothing ever reads
+   * around what is sitting in t.  Headers created in t are remembered
+   * so that later lookups of the same object find them.
+   */
+  struct Batch {
+    KeyValueDB::Transaction t;
+    unsigned pending;        ///< mutations in t
+    unsigned ops, writes;    ///< totals since start_batch()
+    map<string, _Header> leaves;     ///< map_header_key -> leaf, new in t
+    map<uint64_t, _Header> headers;  ///< seq -> header, new in t
+    Batch() : pending(0), ops(0), writes(0) {}
+  };
+
+  /// Protects batches
+  Mutex batch_lock;
+  map<pthread_t, Batch*> batches;
+
+  /**
+   * Decoded headers of recently looked up objects, by map_header_key.
+   * Entries are dropped whenever the leaf or the header they came from
+   * is rewritten; cache_epoch counts those so that a lookup which read
+   * the db before a concurrent rewrite doesn't cache what it read.
+   */
+  Mutex cache_lock;
+  unsigned cache_max;
+  uint64_t cache_epoch;
+  list<string> cache_lru;   ///< most recently used first
+  struct CacheEntry {
+    _Header header;
+    list<string>::iterator lru;
+  };
+  map<string, CacheEntry> cache;
+  multimap<uint64_t, string> cache_by_seq;
+
+  uint64_t cache_get_epoch();
+  bool cache_lookup(const string &key, _Header *out);
+  void cache_add(const string &key, const _Header &header, uint64_t epoch);
+  void _cache_remove(map<string, CacheEntry>::iterator p);
+  void cache_invalidate_key(const string &key);
+  void cache_invalidate_seq(uint64_t seq);
+
+  /// Drop our hold on seq @see lookup_map_header
+  void put_header_seq(uint64_t seq);
+
+  /// The calling thread's batch, NULL if none
+  Batch *get_batch();
+
+  /// Transaction for a mutation that may be batched
+  KeyValueDB::Transaction get_batch_transaction();
+
+  /// Write out this thread's batch so far, if any
+  int flush_batch();
+
+  /// Submit t, or just account for it if it is the batch transaction
+  int submit(KeyValueDB::Transaction t);
+
   /// String munging
   string hobject_key(coll_t c, const hobject_t &hoid);
   string map_header_key(coll_t c, const hobject_t &hoid);
@@ -440,9 +519,7 @@ private:
     RemoveOnDelete(DBObjectMap *db) :
       db(db), seq(seq) {}
     void operator() (_Header *header) {
-      Mutex::Locker l(db->header_lock);
-      db->in_use.erase(header->seq);
-      db->header_cond.Signal();
+      db->put_header_seq(header->seq);
       delete header;
     }
   };
@@ -1667,3 +1667,28 @@ void FileJournal::throttle()
   if (throttle_bytes.wait(g_conf->journal_queue_max_bytes))
     dout(2) << "throttle: waited for bytes" << dendl;
 }
+
+float FileJournal::get_fill()
+{
+  float fill = 0;
+  if (g_conf->journal_queue_max_ops)
+    fill = MAX(fill, (float)throttle_ops.get_current() /
+	       (float)g_conf->journal_queue_max_ops);
+  if (g_conf->journal_queue_max_bytes)
+    fill = MAX(fill, (float)throttle_bytes.get_current() /
+	       (float)g_conf->journal_queue_max_bytes);
+
+  // the ring normally runs up to half full before check_for_full kicks
+  // a commit, so only count what lies beyond that.
+  Mutex::Locker l(write_lock);
+  off64_t usable = header.max_size - get_top();
+  if (usable <= 0)
+    return fill;
+  off64_t used;
+  if (write_pos >= header.start)
+    used = write_pos - header.start;
+  else
+    used = (header.max_size - header.start) + (write_pos - get_top());
+  float ring = ((float)used / (float)usable - 0.5) * 2.0;
+  return MAX(fill, ring);
+}
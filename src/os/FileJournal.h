@@ -335,6 +335,7 @@ private:
   void flush();
 
   void throttle();
+  float get_fill();
 
   bool is_writeable() {
     return read_pos == 0;
@@ -673,6 +673,7 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   stop(false), sync_thread(this),
   default_osr("default"),
   op_queue_len(0), op_queue_bytes(0), op_finisher(g_ceph_context), next_finish(0),
+  commit_lat_avg(0),
   op_tp(g_ceph_context, "FileStore::op_tp", g_conf->filestore_op_threads),
   op_wq(this, g_conf->filestore_op_thread_timeout,
 	g_conf->filestore_op_thread_suicide_timeout, &op_tp),
@@ -742,6 +743,13 @@ FileStore::FileStore(const std::string &base, const std::string &jdev, const cha
   plb.add_fl_avg(l_os_commit_len, "commitcycle_interval");
   plb.add_fl_avg(l_os_commit_lat, "commitcycle_latency");
   plb.add_u64_counter(l_os_j_full, "journal_full");
+  plb.add_u64_counter(l_os_omap_ops, "omap_ops");        // object map mutations
+  plb.add_u64_counter(l_os_omap_writes, "omap_writes");  // leveldb writes for them
+  plb.add_fl_avg(l_os_apply_parallel, "apply_parallel");  // sequencer's ops applying at op start
+  plb.add_u64_counter(l_os_apply_conflicts, "apply_conflicts");  // ops held back by an earlier op
+  plb.add_u64_counter(l_os_apply_ordered_waits, "apply_ordered_waits");  // waits for earlier coll attr/meta updates
+  plb.add_u64(l_os_throttle_pressure, "throttle_pressure");  // percent; see op_queue_throttle_delay
+  plb.add_fl_avg(l_os_throttle_delay, "throttle_delay");
 
   logger = plb.create_perf_counters();
 }
@@ -1879,7 +1887,8 @@ int FileStore::mount()
       ret = -1;
       goto close_current_fd;
     }
-    DBObjectMap *dbomap = new DBObjectMap(omap_store);
+    DBObjectMap *dbomap = new DBObjectMap(omap_store,
+					  g_conf->filestore_omap_header_cache_size);
     ret = dbomap->init();
     if (ret < 0) {
       derr << "Error initializing DBObjectMap: " << ret << dendl;
@@ -2097,14 +2106,24 @@ FileStore::Op *FileStore::build_op(list<Transaction*>& tls,
 				   TrackedOpRef osd_op)
 {
   uint64_t bytes = 0, ops = 0;
+  Op *o = new Op;
+  o->barrier = !g_conf->filestore_parallel_apply;
+  int trans_num = 0;
   for (list<Transaction*>::iterator p = tls.begin();
        p != tls.end();
-       p++) {
+       p++, trans_num++) {
     bytes += (*p)->get_num_bytes();
     ops += (*p)->get_num_ops();
+    int first_ordered;
+    if (!o->barrier &&
+	!(*p)->get_objects(&o->objects, &o->ordered, &first_ordered))
+      o->barrier = true;
+    if (!o->barrier && o->ordered_trans < 0 && first_ordered >= 0) {
+      o->ordered_trans = trans_num;
+      o->ordered_op = first_ordered;
+    }
   }
 
-  Op *o = new Op;
   o->start = ceph_clock_now(g_ceph_context);
   o->tls.swap(tls);
   o->onreadable = onreadable;
@@ -2130,6 +2149,7 @@ void FileStore::queue_op(OpSequencer *osr, Op *o)
   _op_apply_start(o->op);
   op_tp.lock();
 
+  o->osr = osr;
   osr->queue(o);
 
   logger->inc(l_os_ops);
@@ -2144,7 +2164,55 @@ void FileStore::queue_op(OpSequencer *osr, Op *o)
 	  << " " << o->bytes << " bytes"
 	  << "   (queue has " << op_queue_len << " ops and " << op_queue_bytes << " bytes)"
 	  << dendl;
-  op_wq.queue(osr);
+  op_wq.queue(o);
+}
+
+/*
+ * The hard limits in _op_queue_reserve_throttle and the journal throttle
+ * only kick in once a queue is full, and then they block until a commit
+ * drains it.  Before that point, slow submitters down in proportion to
+ * how full the journal and apply queue are, so the backlog levels off
+ * instead of filling up and stalling.  The longest delay is the rate at
+ * which a full queue would drain over one commit.
+ */
+void FileStore::op_queue_throttle_delay()
+{
+  double low = g_conf->filestore_queue_throttle_low;
+  double high = g_conf->filestore_queue_throttle_high;
+  double max_delay = g_conf->filestore_queue_throttle_max_delay;
+  if (max_delay <= 0 || high <= low)
+    return;
+
+  double pressure = journal ? journal->get_fill() : 0;
+
+  op_tp.lock();
+  uint64_t max_ops = m_filestore_queue_max_ops;
+  uint64_t max_bytes = m_filestore_queue_max_bytes;
+  if (is_committing()) {
+    max_ops += m_filestore_queue_committing_max_ops;
+    max_bytes += m_filestore_queue_committing_max_bytes;
+  }
+  if (max_ops)
+    pressure = MAX(pressure, (double)op_queue_len / (double)max_ops);
+  if (max_bytes)
+    pressure = MAX(pressure, (double)op_queue_bytes / (double)max_bytes);
+  if (commit_lat_avg > 0 && max_ops)
+    max_delay = MIN(max_delay, commit_lat_avg / (double)max_ops);
+  op_tp.unlock();
+
+  logger->set(l_os_throttle_pressure, (uint64_t)(MIN(pressure, 1.0) * 100.0));
+  if (pressure <= low)
+    return;
+
+  utime_t delay;
+  delay.set_from_double(max_delay * MIN(1.0, (pressure - low) / (high - low)));
+  dout(10) << "op_queue_throttle_delay pressure " << pressure
+	   << ", delaying " << delay << dendl;
+  logger->finc(l_os_throttle_delay, delay);
+
+  struct timespec ts;
+  delay.to_timespec(&ts);
+  nanosleep(&ts, NULL);
 }
 
 void FileStore::op_queue_reserve_throttle(Op *o)
@@ -2189,13 +2257,34 @@ void FileStore::_op_queue_release_throttle(Op *o)
   op_throttle_cond.Signal();
 }
 
-void FileStore::_do_op(OpSequencer *osr)
+FileStore::Op *FileStore::_claim_op()
 {
-  osr->apply_lock.Lock();
-  Op *o = osr->peek_queue();
+  // called with tp lock held
+  set<OpSequencer*> tried;
+  for (deque<OpSequencer*>::iterator p = op_queue.begin();
+       p != op_queue.end();
+       ++p) {
+    if (!tried.insert(*p).second)
+      continue;
+    unsigned conflicts;
+    Op *o = (*p)->claim_next(&conflicts);
+    if (conflicts)
+      logger->inc(l_os_apply_conflicts, conflicts);
+    if (o) {
+      op_queue.erase(p);
+      return o;
+    }
+  }
+  return NULL;
+}
+
+void FileStore::_do_op(Op *o)
+{
+  OpSequencer *osr = o->osr;
+  logger->finc(l_os_apply_parallel, osr->get_applying());
 
   dout(5) << "_do_op " << o << " seq " << o->op << " " << *osr << "/" << osr->parent << " start" << dendl;
-  int r = do_transactions(o->tls, o->op);
+  int r = do_transactions(o->tls, o->op, o);
   op_apply_finish(o->op);
   dout(10) << "_do_op " << o << " seq " << o->op << " r = " << r
 	   << ", finisher " << o->onreadable << " " << o->onreadable_sync << dendl;
@@ -2205,26 +2294,35 @@ void FileStore::_do_op(OpSequencer *osr)
   */
 }
 
-void FileStore::_finish_op(OpSequencer *osr)
+void FileStore::_finish_op(Op *applied)
 {
-  Op *o = osr->dequeue();
-  
-  dout(10) << "_finish_op " << o << " seq " << o->op << " " << *osr << "/" << osr->parent << dendl;
-  osr->apply_lock.Unlock();  // locked in _do_op
-
   // called with tp lock held
-  _op_queue_release_throttle(o);
+  OpSequencer *osr = applied->osr;
+  osr->apply_finish(applied);
+
+  // ops may apply out of order, but they complete in order: retire
+  // whatever prefix of the sequencer is now done.
+  Op *o;
+  while ((o = osr->dequeue()) != NULL) {
+    dout(10) << "_finish_op " << o << " seq " << o->op << " " << *osr << "/" << osr->parent << dendl;
+
+    _op_queue_release_throttle(o);
 
-  utime_t lat = ceph_clock_now(g_ceph_context);
-  lat -= o->start;
-  logger->finc(l_os_apply_lat, lat);
+    utime_t lat = ceph_clock_now(g_ceph_context);
+    lat -= o->start;
+    logger->finc(l_os_apply_lat, lat);
 
-  if (o->onreadable_sync) {
-    o->onreadable_sync->finish(0);
-    delete o->onreadable_sync;
+    if (o->onreadable_sync) {
+      o->onreadable_sync->finish(0);
+      delete o->onreadable_sync;
+    }
+    op_finisher.queue(o->onreadable);
+    delete o;
   }
-  op_finisher.queue(o->onreadable);
-  delete o;
+
+  // ops that were waiting on this one may be able to start now
+  if (!op_queue.empty())
+    op_tp.kick();
 }
 
 
@@ -2274,6 +2372,7 @@ int FileStore::queue_transactions(Sequencer *posr, list<Transaction*> &tls,
 
   if (journal && journal->is_writeable() && !m_filestore_journal_trailing) {
     Op *o = build_op(tls, onreadable, onreadable_sync, osd_op);
+    op_queue_throttle_delay();
     op_queue_reserve_throttle(o);
     journal->throttle();
     o->op = op_submit_start();
@@ -2351,7 +2450,7 @@ void FileStore::_journaled_ahead(OpSequencer *osr, Op *o, Context *ondisk)
   }
 }
 
-int FileStore::do_transactions(list<Transaction*> &tls, uint64_t op_seq)
+int FileStore::do_transactions(list<Transaction*> &tls, uint64_t op_seq, Op *o)
 {
   int r = 0;
 
@@ -2368,14 +2467,25 @@ int FileStore::do_transactions(list<Transaction*> &tls, uint64_t op_seq)
     return id;
   }
     
+  // gather all object map updates for this op into one leveldb write
+  object_map->start_batch();
   int trans_num = 0;
   for (list<Transaction*>::iterator p = tls.begin();
        p != tls.end();
        p++, trans_num++) {
-    r = _do_transaction(**p, op_seq, trans_num);
+    r = _do_transaction(**p, op_seq, trans_num, o);
     if (r < 0)
       break;
   }
+  unsigned omap_ops, omap_writes;
+  int br = object_map->end_batch(&omap_ops, &omap_writes);
+  if (br < 0) {
+    derr << "do_transactions object map write got " << cpp_strerror(br) << dendl;
+    if (r >= 0)
+      r = br;
+  }
+  logger->inc(l_os_omap_ops, omap_ops);
+  logger->inc(l_os_omap_writes, omap_writes);
   
   _transaction_finish(id);
   return r;
@@ -2598,7 +2708,8 @@ int FileStore::_check_replay_guard(int fd, const SequencerPosition& spos)
   }
 }
 
-unsigned FileStore::_do_transaction(Transaction& t, uint64_t op_seq, int trans_num)
+unsigned FileStore::_do_transaction(Transaction& t, uint64_t op_seq, int trans_num,
+				    Op *o)
 {
   dout(10) << "_do_transaction on " << &t << dendl;
 
@@ -2606,6 +2717,14 @@ unsigned FileStore::_do_transaction(Transaction& t, uint64_t op_seq, int trans_n
   
   SequencerPosition spos(op_seq, trans_num, 0);
   while (i.have_op()) {
+    // collection attrs and meta objects go in queue order; see build_op
+    if (o && trans_num == o->ordered_trans && (int)spos.op == o->ordered_op &&
+	o->osr->wait_ordered(o)) {
+      dout(15) << "_do_transaction " << o << " seq " << op_seq
+	       << " waited for earlier ops at " << spos << dendl;
+      logger->inc(l_os_apply_ordered_waits);
+    }
+
     int op = i.get_op();
     int r = 0;
 
@@ -3010,6 +3129,87 @@ int FileStore::read(coll_t cid, const hobject_t& oid,
   return got;
 }
 
+int FileStore::readv(coll_t cid, const hobject_t& oid,
+		     map<uint64_t, uint64_t>& extents, bufferlist& bl)
+{
+  dout(15) << "readv " << cid << "/" << oid << " " << extents << dendl;
+
+  int fd = lfn_open(cid, oid, O_RDONLY);
+  if (fd < 0) {
+    dout(10) << "FileStore::readv(" << cid << "/" << oid << ") open error: " << cpp_strerror(fd) << dendl;
+    return fd;
+  }
+
+  // extents that are close together are read with a single preadv,
+  // with the holes between them landing in a scratch buffer
+  uint64_t max_gap = g_conf->filestore_readv_max_gap;
+  uint64_t total = 0, scratch_len = 0, end = 0;
+  for (map<uint64_t, uint64_t>::iterator p = extents.begin();
+       p != extents.end();
+       ++p) {
+    if (p != extents.begin() && p->first > end && p->first - end <= max_gap)
+      scratch_len = MAX(scratch_len, p->first - end);
+    total += p->second;
+    end = p->first + p->second;
+  }
+  bufferptr bptr(total);  // prealloc space for every extent
+  bufferptr scratch;
+  if (scratch_len)
+    scratch = bufferptr(scratch_len);
+
+  int got = 0;
+  uint64_t pos = 0;     // into bptr
+  map<uint64_t, uint64_t>::iterator p = extents.begin();
+  while (p != extents.end()) {
+    // gather a run of extents
+    vector<struct iovec> iov;
+    vector<map<uint64_t, uint64_t>::iterator> run;  // parallel to iov; end() for holes
+    uint64_t run_off = p->first;
+    end = p->first;
+    for (; p != extents.end(); ++p) {
+      if (!iov.empty() &&
+	  (p->first < end || p->first - end > max_gap || iov.size() + 2 > IOV_MAX))
+	break;
+      if (p->first > end) {
+	struct iovec hole = { scratch.c_str(), p->first - end };
+	iov.push_back(hole);
+	run.push_back(extents.end());
+      }
+      struct iovec data = { bptr.c_str() + pos, p->second };
+      iov.push_back(data);
+      run.push_back(p);
+      pos += p->second;
+      end = p->first + p->second;
+    }
+
+    vector<struct iovec> consumed(iov);
+    int r = safe_preadv(fd, &consumed[0], consumed.size(), run_off);
+    if (r < 0) {
+      dout(10) << "FileStore::readv(" << cid << "/" << oid << ") preadv error: " << cpp_strerror(r) << dendl;
+      TEMP_FAILURE_RETRY(::close(fd));
+      return r;
+    }
+
+    // trim whatever was past eof and hand out the data
+    uint64_t left = r;
+    for (unsigned i = 0; i < iov.size(); ++i) {
+      uint64_t n = MIN(left, iov[i].iov_len);
+      left -= n;
+      if (run[i] == extents.end())
+	continue;
+      run[i]->second = n;
+      if (n)
+	bl.append(bptr, (char *)iov[i].iov_base - bptr.c_str(), n);
+      got += n;
+    }
+  }
+  TEMP_FAILURE_RETRY(::close(fd));
+
+  dout(10) << "FileStore::readv " << cid << "/" << oid << " " << extents
+	   << " got " << got << "/" << total << dendl;
+  return got;
+}
+
 int FileStore::fiemap(coll_t cid, const hobject_t& oid,
                     uint64_t offset, size_t len,
                     bufferlist& bl)
@@ -3680,6 +3880,13 @@ void FileStore::sync_entry()
       logger->finc(l_os_commit_lat, lat);
       logger->finc(l_os_commit_len, dur);
 
+      op_tp.lock();
+      if (commit_lat_avg > 0)
+	commit_lat_avg = commit_lat_avg * .7 + (double)lat * .3;
+      else
+	commit_lat_avg = lat;
+      op_tp.unlock();
+
       commit_finish();
 
       logger->set(l_os_committing, 0);
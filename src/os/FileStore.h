@@ -112,6 +112,7 @@ class FileStore : public JournalingObjectStore,
   void sync_fs(); // actuall sync underlying fs
 
   // -- op workqueue --
+  class OpSequencer;
   struct Op {
     utime_t start;
     uint64_t op;
@@ -119,15 +120,48 @@ class FileStore : public JournalingObjectStore,
     Context *onreadable, *onreadable_sync;
     uint64_t ops, bytes;
     TrackedOpRef osd_op;
+
+    OpSequencer *osr;
+    set<hobject_t> objects;  ///< what we touch, unless barrier
+    /// collection attrs and meta objects we touch: these are applied in
+    /// queue order, but the rest of the op may overlap earlier ops
+    set<pair<coll_t, hobject_t> > ordered;
+    int ordered_trans, ordered_op;  ///< where we first touch ordered
+    bool barrier;   ///< conflicts with every other op in the sequencer
+    bool started, applied;
+    bool waited;    ///< had to wait for an earlier op at least once
+
+    Op() : onreadable(0), onreadable_sync(0), ops(0), bytes(0),
+	   osr(0), ordered_trans(-1), ordered_op(-1),
+	   barrier(false), started(false), applied(false),
+	   waited(false) {}
+
+    bool conflicts(const set<hobject_t>& busy) const {
+      for (set<hobject_t>::const_iterator p = objects.begin();
+	   p != objects.end();
+	   ++p)
+	if (busy.count(*p))
+	  return true;
+      return false;
+    }
+    bool shares_ordered(const Op *o) const {
+      for (set<pair<coll_t, hobject_t> >::const_iterator p = o->ordered.begin();
+	   p != o->ordered.end();
+	   ++p)
+	if (ordered.count(*p))
+	  return true;
+      return false;
+    }
   };
   class OpSequencer : public Sequencer_impl {
     Mutex qlock; // to protect q, for benefit of flush (peek/dequeue also protected by lock)
     list<Op*> q;
     list<uint64_t> jq;
     Cond cond;
+    Cond ordered_cond;  ///< an op applied; see wait_ordered
+    unsigned applying;
   public:
     Sequencer *parent;
-    Mutex apply_lock;  // for apply mutual exclusion
     
     void queue_journal(uint64_t s) {
       Mutex::Locker l(qlock);
@@ -142,13 +176,85 @@ class FileStore : public JournalingObjectStore,
       Mutex::Locker l(qlock);
       q.push_back(o);
     }
-    Op *peek_queue() {
-      assert(apply_lock.is_locked());
-      return q.front();
+
+    /**
+     * Pick the oldest op that may start applying now.
+     *
+     * An op may start once every earlier op in the sequencer that
+     * touches one of its objects has been applied.  A barrier waits for
+     * everything before it and holds back everything after it, so with
+     * every op a barrier this is the old one-at-a-time behavior.
+     *
+     * @param [out] conflicts set to the number of ops found waiting on
+     * an earlier op for the first time
+     * @return the op, marked started, or NULL if nothing can start
+     */
+    Op *claim_next(unsigned *conflicts) {
+      Mutex::Locker l(qlock);
+      set<hobject_t> busy;
+      bool pending = false;
+      *conflicts = 0;
+      for (list<Op*>::iterator p = q.begin(); p != q.end(); ++p) {
+	Op *o = *p;
+	if (o->applied)
+	  continue;
+	if (!o->started) {
+	  if (o->barrier ? !pending : !o->conflicts(busy)) {
+	    o->started = true;
+	    applying++;
+	    return o;
+	  }
+	  if (!o->waited) {
+	    o->waited = true;
+	    (*conflicts)++;
+	  }
+	}
+	if (o->barrier)
+	  return NULL;
+	busy.insert(o->objects.begin(), o->objects.end());
+	pending = true;
+      }
+      return NULL;
+    }
+    /// @return number of ops of this sequencer currently applying
+    unsigned get_applying() {
+      Mutex::Locker l(qlock);
+      return applying;
+    }
+    void apply_finish(Op *o) {
+      Mutex::Locker l(qlock);
+      assert(o->started && !o->applied);
+      o->applied = true;
+      applying--;
+      ordered_cond.Signal();
+    }
+    /**
+     * Wait until every earlier op sharing one of o's ordered keys has
+     * applied.  We only ever wait on earlier ops, and the oldest op
+     * that hasn't applied never waits, so the op threads can't all end
+     * up waiting on each other.
+     *
+     * @return true if we had to wait
+     */
+    bool wait_ordered(Op *o) {
+      Mutex::Locker l(qlock);
+      bool waited = false;
+      while (true) {
+	list<Op*>::iterator p;
+	for (p = q.begin(); *p != o; ++p)
+	  if (!(*p)->applied && (*p)->shares_ordered(o))
+	    break;
+	if (*p == o)
+	  return waited;
+	waited = true;
+	ordered_cond.Wait(qlock);
+      }
     }
+    /// @return the oldest op if it has been applied, else NULL
     Op *dequeue() {
-      assert(apply_lock.is_locked());
       Mutex::Locker l(qlock);
+      if (q.empty() || !q.front()->applied)
+	return NULL;
       Op *o = q.front();
       q.pop_front();
       cond.Signal();
@@ -177,7 +283,7 @@ class FileStore : public JournalingObjectStore,
 
     OpSequencer()
       : qlock("FileStore::OpSequencer::qlock", false, false),
-	apply_lock("FileStore::OpSequencer::apply_lock", false, false) {}
+	applying(0) {}
     ~OpSequencer() {
       assert(q.empty());
     }
@@ -190,52 +296,51 @@ class FileStore : public JournalingObjectStore,
   friend ostream& operator<<(ostream& out, const OpSequencer& s);
 
   Sequencer default_osr;
-  deque<OpSequencer*> op_queue;
+  deque<OpSequencer*> op_queue;  ///< one entry per op not yet started
   uint64_t op_queue_len, op_queue_bytes;
   Cond op_throttle_cond;
   Finisher op_finisher;
   uint64_t next_finish;
 
   ThreadPool op_tp;
-  struct OpWQ : public ThreadPool::WorkQueue<OpSequencer> {
+  struct OpWQ : public ThreadPool::WorkQueue<Op> {
     FileStore *store;
     OpWQ(FileStore *fs, time_t timeout, time_t suicide_timeout, ThreadPool *tp)
-      : ThreadPool::WorkQueue<OpSequencer>("FileStore::OpWQ", timeout, suicide_timeout, tp), store(fs) {}
+      : ThreadPool::WorkQueue<Op>("FileStore::OpWQ", timeout, suicide_timeout, tp), store(fs) {}
 
-    bool _enqueue(OpSequencer *osr) {
-      store->op_queue.push_back(osr);
+    bool _enqueue(Op *o) {
+      store->op_queue.push_back(o->osr);
       return true;
     }
-    void _dequeue(OpSequencer *o) {
+    void _dequeue(Op *o) {
       assert(0);
     }
     bool _empty() {
       return store->op_queue.empty();
     }
-    OpSequencer *_dequeue() {
-      if (store->op_queue.empty())
-	return NULL;
-      OpSequencer *osr = store->op_queue.front();
-      store->op_queue.pop_front();
-      return osr;
+    Op *_dequeue() {
+      return store->_claim_op();
     }
-    void _process(OpSequencer *osr) {
-      store->_do_op(osr);
+    void _process(Op *o) {
+      store->_do_op(o);
     }
-    void _process_finish(OpSequencer *osr) {
-      store->_finish_op(osr);
+    void _process_finish(Op *o) {
+      store->_finish_op(o);
     }
     void _clear() {
       assert(store->op_queue.empty());
     }
   } op_wq;
 
-  void _do_op(OpSequencer *o);
-  void _finish_op(OpSequencer *o);
+  Op *_claim_op();
+  void _do_op(Op *o);
+  void _finish_op(Op *o);
   Op *build_op(list<Transaction*>& tls,
 	       Context *onreadable, Context *onreadable_sync,
 	       TrackedOpRef osd_op);
   void queue_op(OpSequencer *osr, Op *o);
+  double commit_lat_avg;  ///< recent commit duration, protected by op_tp lock
+  void op_queue_throttle_delay();
   void op_queue_reserve_throttle(Op *o);
   void _op_queue_reserve_throttle(Op *o, const char *caller = 0);
   void _op_queue_release_throttle(Op *o);
@@ -302,12 +407,16 @@ public:
 
   int statfs(struct statfs *buf);
 
-  int do_transactions(list<Transaction*> &tls, uint64_t op_seq);
+  int do_transactions(list<Transaction*> &tls, uint64_t op_seq) {
+    return do_transactions(tls, op_seq, NULL);
+  }
+  int do_transactions(list<Transaction*> &tls, uint64_t op_seq, Op *o);
   unsigned apply_transaction(Transaction& t, Context *ondisk=0);
   unsigned apply_transactions(list<Transaction*>& tls, Context *ondisk=0);
   int _transaction_start(uint64_t bytes, uint64_t ops);
   void _transaction_finish(int id);
-  unsigned _do_transaction(Transaction& t, uint64_t op_seq, int trans_num);
+  unsigned _do_transaction(Transaction& t, uint64_t op_seq, int trans_num,
+			   Op *o = NULL);
 
   int queue_transaction(Sequencer *osr, Transaction* t);
   int queue_transactions(Sequencer *osr, list<Transaction*>& tls,
@@ -357,6 +466,7 @@ public:
   bool exists(coll_t cid, const hobject_t& oid);
   int stat(coll_t cid, const hobject_t& oid, struct stat *st);
   int read(coll_t cid, const hobject_t& oid, uint64_t offset, size_t len, bufferlist& bl);
+  int readv(coll_t cid, const hobject_t& oid, map<uint64_t, uint64_t>& extents, bufferlist& bl);
   int fiemap(coll_t cid, const hobject_t& oid, uint64_t offset, size_t len, bufferlist& bl);
 
   int _touch(coll_t cid, const hobject_t& oid);
@@ -48,6 +48,8 @@ public:
 
   virtual void flush() = 0;
   virtual void throttle() = 0;
+  /// how close we are to blocking submitters, 0 (idle) .. 1 (blocking)
+  virtual float get_fill() { return 0; }
 
   virtual int dump(ostream& out) { return -EOPNOTSUPP; }
 
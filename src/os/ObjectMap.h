@@ -142,6 +142,22 @@ public:
   /// Ensure all previous writes are durable
   virtual int sync() { return 0; }
 
+  /**
+   * Gather the calling thread's mutations into as few backing store
+   * writes as possible until end_batch().  Reads from the same thread
+   * in between still see everything gathered so far.
+   */
+  virtual void start_batch() {}
+
+  /// Submit the batch started by start_batch()
+  virtual int end_batch(
+    unsigned *ops,                     ///< [out] mutations gathered
+    unsigned *writes                   ///< [out] backing store writes issued
+    ) {
+    *ops = *writes = 0;
+    return 0;
+  }
+
   virtual bool check(std::ostream &out) { return true; }
 
   class ObjectMapIteratorImpl {
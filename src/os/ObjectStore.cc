@@ -367,6 +367,257 @@ void ObjectStore::Transaction::dump(ceph::Formatter *f)
   f->close_section();
 }
 
+int ObjectStore::readv(coll_t cid, const hobject_t& oid,
+		       map<uint64_t, uint64_t>& extents, bufferlist& bl)
+{
+  int total = 0;
+  for (map<uint64_t, uint64_t>::iterator p = extents.begin();
+       p != extents.end();
+       ++p) {
+    bufferlist t;
+    int r = read(cid, oid, p->first, p->second, t);
+    if (r < 0)
+      return r;
+    p->second = r;
+    total += r;
+    bl.claim_append(t);
+  }
+  return total;
+}
+
+// the osd keeps pg logs, pg info and maps here; see coll_t::META_COLL
+static const coll_t meta_coll("meta");
+
+/*
+ * Objects are keyed without their collection: COLL_ADD links one
+ * object into a second collection, and both names share the inode.
+ * Collection attrs and meta objects are keyed per collection/object
+ * in ordered instead; nearly every osd write appends to its pg's log
+ * object and sets the "ondisklog" attr, so treating them as plain
+ * conflicts would serialize a pg again.
+ */
+static void touch_object(const coll_t& cid, const hobject_t& oid, int n,
+			 set<hobject_t> *objects,
+			 set<pair<coll_t, hobject_t> > *ordered,
+			 int *first_ordered)
+{
+  if (cid == meta_coll) {
+    ordered->insert(make_pair(cid, oid));
+    if (*first_ordered < 0)
+      *first_ordered = n;
+  } else {
+    objects->insert(oid);
+  }
+}
+
+static void touch_coll_attrs(const coll_t& cid, int n,
+			     set<pair<coll_t, hobject_t> > *ordered,
+			     int *first_ordered)
+{
+  ordered->insert(make_pair(cid, hobject_t()));
+  if (*first_ordered < 0)
+    *first_ordered = n;
+}
+
+bool ObjectStore::Transaction::get_objects(set<hobject_t> *objects,
+					   set<pair<coll_t, hobject_t> > *ordered,
+					   int *first_ordered)
+{
+  *first_ordered = -1;
+  iterator i = begin();
+  for (int n = 0; i.have_op(); n++) {
+    int op = i.get_op();
+
+    switch (op) {
+    case Transaction::OP_NOP:
+    case Transaction::OP_STARTSYNC:
+      break;
+
+    case Transaction::OP_TOUCH:
+    case Transaction::OP_REMOVE:
+    case Transaction::OP_RMATTRS:
+    case Transaction::OP_COLL_REMOVE:
+    case Transaction::OP_OMAP_CLEAR:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_WRITE:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	i.get_length();
+	i.get_length();
+	bufferlist bl;
+	i.get_bl(bl);
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_ZERO:
+    case Transaction::OP_TRIMCACHE:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	i.get_length();
+	i.get_length();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_TRUNCATE:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	i.get_length();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_SETATTR:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	i.get_attrname();
+	bufferlist bl;
+	i.get_bl(bl);
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_SETATTRS:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	map<string, bufferptr> aset;
+	i.get_attrset(aset);
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_RMATTR:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	i.get_attrname();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_CLONE:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	hobject_t noid = i.get_oid();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+	touch_object(cid, noid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_CLONERANGE:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	hobject_t noid = i.get_oid();
+	i.get_length();
+	i.get_length();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+	touch_object(cid, noid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_CLONERANGE2:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	hobject_t noid = i.get_oid();
+	i.get_length();
+	i.get_length();
+	i.get_length();
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+	touch_object(cid, noid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_COLL_ADD:
+    case Transaction::OP_COLL_MOVE:
+      {
+	coll_t ocid = i.get_cid();
+	coll_t ncid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	touch_object(ocid, oid, n, objects, ordered, first_ordered);
+	touch_object(ncid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_COLL_SETATTR:
+      {
+	coll_t cid = i.get_cid();
+	i.get_attrname();
+	bufferlist bl;
+	i.get_bl(bl);
+	touch_coll_attrs(cid, n, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_COLL_RMATTR:
+      {
+	coll_t cid = i.get_cid();
+	i.get_attrname();
+	touch_coll_attrs(cid, n, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_COLL_SETATTRS:
+      {
+	coll_t cid = i.get_cid();
+	map<string, bufferptr> aset;
+	i.get_attrset(aset);
+	touch_coll_attrs(cid, n, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_OMAP_SETKEYS:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	map<string, bufferlist> aset;
+	i.get_attrset(aset);
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_OMAP_RMKEYS:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	set<string> keys;
+	i.get_keyset(keys);
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    case Transaction::OP_OMAP_SETHEADER:
+      {
+	coll_t cid = i.get_cid();
+	hobject_t oid = i.get_oid();
+	bufferlist bl;
+	i.get_bl(bl);
+	touch_object(cid, oid, n, objects, ordered, first_ordered);
+      }
+      break;
+
+    default:
+      // mkcoll, rmcoll, rename, and anything we don't know how to parse
+      return false;
+    }
+  }
+  return true;
+}
+
 void ObjectStore::Transaction::generate_test_instances(list<ObjectStore::Transaction*>& o)
 {
   o.push_back(new Transaction);
@@ -65,6 +65,13 @@ enum {
   l_os_commit_len,
   l_os_commit_lat,
   l_os_j_full,
+  l_os_omap_ops,
+  l_os_omap_writes,
+  l_os_apply_parallel,
+  l_os_apply_conflicts,
+  l_os_apply_ordered_waits,
+  l_os_throttle_pressure,
+  l_os_throttle_delay,
   l_os_last,
 };
 
@@ -573,6 +580,23 @@ public:
     }
 
     void dump(ceph::Formatter *f);
+
+    /**
+     * Collect what this transaction touches.
+     *
+     * @param [out] objects objects touched, whatever their collection
+     * @param [out] ordered collection attrs, as (cid, hobject_t()), and
+     * objects in the meta collection, as (cid, oid)
+     * @param [out] first_ordered index of the first op touching
+     * anything in ordered, or -1
+     * @return false if the transaction creates, removes or renames a
+     * collection (or contains an op we can't parse), in which case the
+     * sets are incomplete and the caller must assume it conflicts with
+     * everything
+     */
+    bool get_objects(set<hobject_t> *objects,
+		     set<pair<coll_t, hobject_t> > *ordered,
+		     int *first_ordered);
     static void generate_test_instances(list<Transaction*>& o);
   };
 
@@ -634,6 +658,15 @@ public:
   virtual bool exists(coll_t cid, const hobject_t& oid) = 0;                   // useful?
   virtual int stat(coll_t cid, const hobject_t& oid, struct stat *st) = 0;     // struct stat?
   virtual int read(coll_t cid, const hobject_t& oid, uint64_t offset, size_t len, bufferlist& bl) = 0;
+  /**
+   * Read several extents of one object.
+   *
+   * @param extents [in,out] offset -> length; each length is trimmed
+   * to what was actually read (e.g. at eof)
+   * @param bl [out] the extents' data, back to back
+   * @return total bytes read, or negative error
+   */
+  virtual int readv(coll_t cid, const hobject_t& oid, map<uint64_t, uint64_t>& extents, bufferlist& bl);
   virtual int fiemap(coll_t cid, const hobject_t& oid, uint64_t offset, size_t len, bufferlist& bl) = 0;
 
   virtual int getattr(coll_t cid, const hobject_t& oid, const char *name, bufferptr& value) = 0;
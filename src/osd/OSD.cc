@@ -57,6 +57,8 @@
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDSubOp.h"
 #include "messages/MOSDSubOpReply.h"
+#include "messages/MOSDSubOpReplyBatch.h"
+#include "messages/MOSDSubOpBatch.h"
 #include "messages/MOSDBoot.h"
 #include "messages/MOSDPGTemp.h"
 
@@ -548,6 +550,9 @@ OSD::OSD(int id, Messenger *internal_messenger, Messenger *external_messenger,
   hbserver_messenger(hbserverm),
   heartbeat_thread(this),
   heartbeat_dispatcher(this),
+  subop_reply_lock("OSD::subop_reply_lock"),
+  subop_reply_flush_queued(false),
+  subop_reply_finisher(external_messenger->cct),
   stat_lock("OSD::stat_lock"),
   finished_lock("OSD::finished_lock"),
   admin_ops_hook(NULL),
@@ -565,6 +570,9 @@ OSD::OSD(int id, Messenger *internal_messenger, Messenger *external_messenger,
   tid_lock("OSD::tid_lock"),
   command_wq(this, g_conf->osd_command_thread_timeout, &command_tp),
   recovery_ops_active(0),
+  recovery_max_active(g_conf->osd_recovery_max_active),
+  recovery_tune_lat_sum(0),
+  recovery_tune_ops(0),
   recovery_wq(this, g_conf->osd_recovery_thread_timeout, &recovery_tp),
   remove_list_lock("OSD::remove_list_lock"),
   replay_queue_lock("OSD::replay_queue_lock"),
@@ -577,7 +585,10 @@ OSD::OSD(int id, Messenger *internal_messenger, Messenger *external_messenger,
   rep_scrub_wq(this, g_conf->osd_scrub_thread_timeout, &disk_tp),
   remove_wq(this, g_conf->osd_remove_thread_timeout, &disk_tp),
   watch_lock("OSD::watch_lock"),
-  watch_timer(external_messenger->cct, watch_lock)
+  watch_timer(external_messenger->cct, watch_lock),
+  notify_send_lock("OSD::notify_send_lock"),
+  notify_flush_queued(false),
+  notify_finisher(external_messenger->cct)
 {
   monc->set_messenger(client_messenger);
 
@@ -726,6 +737,8 @@ int OSD::init()
   recovery_tp.start();
   disk_tp.start();
   command_tp.start();
+  subop_reply_finisher.start();
+  notify_finisher.start();
 
   // start the heartbeat
   heartbeat_thread.create();
@@ -796,6 +809,9 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_push_outb, "push_out_bytes");  // pushed bytes
 
   osd_plb.add_u64_counter(l_osd_rop, "recovery_ops");       // recovery ops (started)
+  osd_plb.add_u64(l_osd_rop_active, "recovery_active");      // recovery ops in progress
+  osd_plb.add_u64(l_osd_rop_max_active, "recovery_max_active");  // current recovery op limit
+  osd_plb.add_u64(l_osd_rop_backlog, "recovery_backlog");    // pgs waiting to start recovery ops
 
   osd_plb.add_fl(l_osd_loadavg, "loadavg");
   osd_plb.add_u64(l_osd_buf, "buffer_bytes");       // total ceph::buffer bytes
@@ -810,6 +826,10 @@ void OSD::create_logger()
   osd_plb.add_u64_counter(l_osd_mape, "map_message_epochs");         // osdmap epochs
   osd_plb.add_u64_counter(l_osd_mape_dup, "map_message_epoch_dups"); // dup osdmap epochs
 
+  osd_plb.add_u64_counter(l_osd_notify, "notify");               // notifies started
+  osd_plb.add_u64_counter(l_osd_notify_fanout, "notify_fanout"); // notify messages to watchers
+  osd_plb.add_fl_avg(l_osd_notify_lat, "notify_latency");        // notify to last ack/timeout
+
   logger = osd_plb.create_perf_counters();
   g_ceph_context->get_perfcounters_collection()->add(logger);
 }
@@ -907,6 +927,10 @@ int OSD::shutdown()
   osd_lock.Unlock();
   store->sync();
   store->flush();
+  subop_reply_finisher.stop();
+  flush_sub_op_replies();
+  notify_finisher.stop();
+  flush_watch_notifies();
   osd_lock.Lock();
 
   // zap waiters (bleh, this is messy)
@@ -1710,6 +1734,8 @@ void OSD::tick()
 
   logger->set(l_osd_buf, buffer::get_total_alloc());
 
+  tune_recovery();
+
   // periodically kick recovery work queue
   recovery_tp.kick();
   
@@ -1846,7 +1872,12 @@ void OSD::complete_notify(void *_notif, void *_obc)
   Watch::Notification *notif = (Watch::Notification *)_notif;
   dout(10) << "got the last reply from pending watchers, can send response now" << dendl;
   MWatchNotify *reply = notif->reply;
-  client_messenger->send_message(reply, notif->session->con);
+  send_watch_notify(reply, notif->session->con);
+  if (notif->start != utime_t()) {
+    utime_t lat = ceph_clock_now(g_ceph_context);
+    lat -= notif->start;
+    logger->finc(l_osd_notify_lat, (double)lat);
+  }
   notif->session->put();
   notif->session->con->put();
   watch->remove_notification(notif);
@@ -1858,6 +1889,59 @@ void OSD::complete_notify(void *_notif, void *_obc)
   delete notif;
 }
 
+struct C_FlushWatchNotifies : public Context {
+  OSD *osd;
+  C_FlushWatchNotifies(OSD *o) : osd(o) {}
+  void finish(int r) {
+    osd->flush_watch_notifies();
+  }
+};
+
+/*
+ * Notifies and notify completions are sent from here rather than from
+ * under the pg lock and watch_lock.  They are queued per client
+ * connection and handed to the messenger in one go from
+ * notify_finisher, so a notify with hundreds of watchers only costs
+ * the pg a list append per watcher, and everything generated while a
+ * flush is waiting to run (several notifies on the same header, say)
+ * goes out back to back on each connection.  Keeping completions on
+ * the same queue preserves ordering for a client that both watches
+ * and notifies over one connection.
+ */
+void OSD::send_watch_notify(MWatchNotify *m, Connection *con)
+{
+  Mutex::Locker l(notify_send_lock);
+  list<Message*>& q = notify_send_queue[con];
+  if (q.empty())
+    con->get();  // the queue's ref
+  q.push_back(m);
+  if (m->opcode == WATCH_NOTIFY)
+    logger->inc(l_osd_notify_fanout);
+  if (!notify_flush_queued) {
+    notify_flush_queued = true;
+    notify_finisher.queue(new C_FlushWatchNotifies(this));
+  }
+}
+
+void OSD::flush_watch_notifies()
+{
+  map<Connection*, list<Message*> > q;
+  {
+    Mutex::Locker l(notify_send_lock);
+    notify_flush_queued = false;
+    q.swap(notify_send_queue);
+  }
+  for (map<Connection*, list<Message*> >::iterator p = q.begin();
+       p != q.end();
+       ++p) {
+    dout(15) << "flush_watch_notifies " << p->second.size() << " to "
+	     << p->first->get_peer_addr() << dendl;
+    for (list<Message*>::iterator i = p->second.begin(); i != p->second.end(); ++i)
+      client_messenger->send_message(*i, p->first);
+    p->first->put();
+  }
+}
+
 void OSD::ack_notification(entity_name_t& name, void *_notif, void *_obc, ReplicatedPG *pg)
 {
   assert(watch_lock.is_locked());
@@ -1949,11 +2033,12 @@ void OSD::handle_notify_timeout(void *_notif)
   dout(10) << "OSD::handle_notify_timeout notif " << notif->id << dendl;
 
   ReplicatedPG::ObjectContext *obc = (ReplicatedPG::ObjectContext *)notif->obc;
+  pg_t pgid = notif->pgid;
 
-  complete_notify(_notif, obc);
+  complete_notify(_notif, obc);  // frees notif
   watch_lock.Unlock(); /* drop lock to change locking order */
 
-  put_object_context(obc, notif->pgid);
+  put_object_context(obc, pgid);
   watch_lock.Lock();
   /* exiting with watch_lock held */
 }
@@ -2563,6 +2648,43 @@ void OSD::_share_map_outgoing(const entity_inst_t& inst)
   }
 }
 
+/*
+ * Pass a new epoch on to a few heartbeat peers we know are behind,
+ * rather than waiting for the next ping to notice.  With this on the
+ * monitors only need to tell a handful of osds about each epoch
+ * (mon_osd_map_share_fanout) and the rest hear it from each other.
+ */
+void OSD::share_map_with_peers()
+{
+  int fanout = g_conf->osd_map_share_fanout;
+  if (fanout <= 0 || !is_active())
+    return;
+
+  vector<int> peers;
+  heartbeat_lock.Lock();
+  for (map<int,HeartbeatInfo>::iterator p = heartbeat_peers.begin();
+       p != heartbeat_peers.end();
+       ++p)
+    peers.push_back(p->first);
+  heartbeat_lock.Unlock();
+  if (peers.empty())
+    return;
+
+  // start somewhere random so that we don't all pick the same peers
+  unsigned start = rand() % peers.size();
+  for (unsigned i = 0; i < peers.size() && fanout > 0; i++) {
+    int peer = peers[(start + i) % peers.size()];
+    if (!osdmap->is_up(peer))
+      continue;
+    epoch_t pe = get_peer_epoch(peer);
+    if (!pe || pe >= osdmap->get_epoch())
+      continue;
+    dout(10) << "share_map_with_peers osd." << peer << " has " << pe << dendl;
+    _share_map_outgoing(osdmap->get_cluster_inst(peer));
+    fanout--;
+  }
+}
+
 
 bool OSD::heartbeat_dispatch(Message *m)
 {
@@ -2807,6 +2929,13 @@ void OSD::_dispatch(Message *m)
     handle_rep_scrub((MOSDRepScrub*)m);
     break;    
 
+  case MSG_OSD_SUBOPREPLY_BATCH:
+    handle_sub_op_reply_batch((MOSDSubOpReplyBatch*)m);
+    break;
+  case MSG_OSD_SUBOP_BATCH:
+    handle_sub_op_batch((MOSDSubOpBatch*)m);
+    break;
+
     // -- need OSDMap --
 
   default:
@@ -3146,8 +3275,15 @@ void OSD::handle_osd_map(MOSDMap *m)
 
   ObjectStore::Transaction t;
 
-  // store new maps: queue for disk and put in the osdmap cache
+  // store new maps: queue for disk and put the encoded maps in the
+  // cache.  apply the incrementals as we go, but only keep the last map
+  // in memory; the advance loop below rebuilds the intermediate epochs
+  // one at a time from their incrementals (see get_map()).
   epoch_t start = MAX(osdmap->get_epoch() + 1, first);
+  string cluster_snap;
+  OSDMapRef prev;
+  if (start > 1 && !m->maps.count(start))
+    prev = get_map(start - 1);
   for (epoch_t e = start; e <= last; e++) {
     map<epoch_t,bufferlist>::iterator p;
     p = m->maps.find(e);
@@ -3157,7 +3293,12 @@ void OSD::handle_osd_map(MOSDMap *m)
       bufferlist& bl = p->second;
       
       o->decode(bl);
-      add_map(o);
+      if (e == last)
+	prev = add_map(o);
+      else
+	prev = OSDMapRef(o);
+      if (cluster_snap.length() == 0)
+	cluster_snap = o->get_cluster_snapshot();
 
       hobject_t fulloid = get_osdmap_pobject_name(e);
       t.write(coll_t::META_COLL, fulloid, 0, bl.length(), bl);
@@ -3173,12 +3314,14 @@ void OSD::handle_osd_map(MOSDMap *m)
       t.write(coll_t::META_COLL, oid, 0, bl.length(), bl);
       add_map_inc_bl(e, bl);
 
-      OSDMap *o = new OSDMap;
+      // start from a shallow copy of the previous epoch; the pieces
+      // the incremental touches are unshared as they are applied
+      OSDMap *o;
       if (e > 1) {
-	bufferlist obl;
-	OSDMapRef prev = get_map(e - 1);
-	prev->encode(obl);
-	o->decode(obl);
+	assert(prev && prev->get_epoch() == e - 1);
+	o = new OSDMap(*prev);
+      } else {
+	o = new OSDMap;
       }
 
       OSDMap::Incremental inc;
@@ -3189,7 +3332,12 @@ void OSD::handle_osd_map(MOSDMap *m)
 	assert(0 == "bad fsid");
       }
 
-      add_map(o);
+      if (e == last)
+	prev = add_map(o);
+      else
+	prev = OSDMapRef(o);
+      if (cluster_snap.length() == 0)
+	cluster_snap = o->get_cluster_snapshot();
 
       bufferlist fbl;
       o->encode(fbl);
@@ -3203,12 +3351,7 @@ void OSD::handle_osd_map(MOSDMap *m)
     assert(0 == "MOSDMap lied about what maps it had?");
   }
 
-  // check for cluster snapshot
-  string cluster_snap;
-  for (epoch_t cur = start; cur <= last && cluster_snap.length() == 0; cur++) {
-    OSDMapRef newmap = get_map(cur);
-    cluster_snap = newmap->get_cluster_snapshot();
-  }
+  prev.reset();
 
   // flush here so that the peering code can re-read any pg data off
   // disk that it needs to... say for backlog generation.  (hmm, is
@@ -3250,7 +3393,7 @@ void OSD::handle_osd_map(MOSDMap *m)
     dout(10) << " advance to epoch " << cur << " (<= newest " << superblock.newest_map << ")" << dendl;
 
     OSDMapRef newmap = get_map(cur);
-    assert(newmap);  // we just cached it above!
+    assert(newmap);
 
     // kill connections to newly down osds
     set<int> old;
@@ -3266,6 +3409,9 @@ void OSD::handle_osd_map(MOSDMap *m)
     superblock.current_epoch = cur;
     advance_map(t, fin);
     had_map_since = ceph_clock_now(g_ceph_context);
+
+    // don't let a long catch-up pile every epoch up in the cache
+    trim_map_cache(0);
   }
 
   if (osdmap->is_up(whoami) &&
@@ -3621,6 +3767,7 @@ void OSD::activate_map(ObjectStore::Transaction& t, list<Context*>& tfin)
   wake_all_pg_waiters();   // the pg mapping may have shifted
   trim_map_cache(oldest_last_clean);
   maybe_update_heartbeat_peers();
+  share_map_with_peers();
 
   send_pg_temp();
 
@@ -3724,6 +3871,12 @@ OSDMapRef OSD::add_map(OSDMap *o)
   epoch_t e = o->get_epoch();
   if (map_cache.count(e) == 0) {
     dout(10) << "add_map " << e << " " << o << dendl;
+    // share whatever did not change with a neighboring epoch
+    map<epoch_t,OSDMapRef>::iterator p = map_cache.lower_bound(e);
+    if (p != map_cache.begin())
+      OSDMap::dedup((--p)->second.get(), o);
+    else if (p != map_cache.end())
+      OSDMap::dedup(p->second.get(), o);
     map_cache.insert(make_pair(e, OSDMapRef(o)));
   } else {
     dout(10) << "add_map " << e << " already have it" << dendl;
@@ -3756,6 +3909,30 @@ OSDMapRef OSD::get_map(epoch_t epoch)
     }
   }
 
+  // cheap path: previous epoch is cached and we have the incremental
+  if (epoch > 1) {
+    OSDMapRef prev;
+    {
+      Mutex::Locker l(map_cache_lock);
+      map<epoch_t,OSDMapRef>::iterator p = map_cache.find(epoch - 1);
+      if (p != map_cache.end())
+	prev = p->second;
+    }
+    bufferlist bl;
+    if (prev && get_inc_map_bl(epoch, bl)) {
+      OSDMap *map = new OSDMap(*prev);
+      OSDMap::Incremental inc;
+      bufferlist::iterator p = bl.begin();
+      inc.decode(p);
+      if (map->apply_incremental(inc) == 0) {
+	dout(20) << "get_map " << epoch << " - applied incremental to " << epoch - 1
+		 << " " << map << dendl;
+	return add_map(map);
+      }
+      delete map;
+    }
+  }
+
   OSDMap *map = new OSDMap;
   if (epoch > 0) {
     dout(20) << "get_map " << epoch << " - loading and decoding " << map << dendl;
@@ -4906,11 +5083,54 @@ bool OSD::queue_for_recovery(PG *pg)
   return b;
 }
 
+/*
+ * Recovery concurrency follows client latency.  If the average client
+ * op since the last tick took longer than
+ * osd_recovery_op_latency_target while recovery was running, halve
+ * the number of recovery ops we allow at once; otherwise, if recovery
+ * is using all of its ops and more pgs are waiting, allow one more, up
+ * to osd_recovery_max_active.
+ */
+void OSD::tune_recovery()
+{
+  double lat_sum = logger->fget(l_osd_op_lat);
+  uint64_t ops = logger->get(l_osd_op);
+  double lat = 0;
+  if (ops > recovery_tune_ops)
+    lat = (lat_sum - recovery_tune_lat_sum) / (double)(ops - recovery_tune_ops);
+  recovery_tune_lat_sum = lat_sum;
+  recovery_tune_ops = ops;
+
+  int limit = g_conf->osd_recovery_max_active;
+  double target = g_conf->osd_recovery_op_latency_target;
+
+  recovery_wq.lock();
+  int was = recovery_max_active;
+  if (target <= 0) {
+    recovery_max_active = limit;
+  } else if (lat > target && recovery_ops_active > 0) {
+    recovery_max_active = recovery_max_active / 2;
+  } else if (lat <= target && !recovery_queue.empty() &&
+	     recovery_ops_active >= recovery_max_active) {
+    recovery_max_active++;
+  }
+  recovery_max_active = MIN(MAX(recovery_max_active, 1), limit);
+  if (recovery_max_active != was)
+    dout(10) << "tune_recovery op latency " << lat << " target " << target
+	     << ", " << recovery_ops_active << " active, max "
+	     << was << " -> " << recovery_max_active << dendl;
+
+  logger->set(l_osd_rop_active, recovery_ops_active);
+  logger->set(l_osd_rop_max_active, recovery_max_active);
+  logger->set(l_osd_rop_backlog, recovery_queue.size());
+  recovery_wq.unlock();
+}
+
 bool OSD::_recover_now()
 {
-  if (recovery_ops_active >= g_conf->osd_recovery_max_active) {
+  if (recovery_ops_active >= recovery_max_active) {
     dout(15) << "_recover_now active " << recovery_ops_active
-	     << " >= max " << g_conf->osd_recovery_max_active << dendl;
+	     << " >= max " << recovery_max_active << dendl;
     return false;
   }
   if (ceph_clock_now(g_ceph_context) < defer_recovery_until) {
@@ -4925,9 +5145,10 @@ void OSD::do_recovery(PG *pg)
 {
   // see how many we should try to start.  note that this is a bit racy.
   recovery_wq.lock();
-  int max = g_conf->osd_recovery_max_active - recovery_ops_active;
+  int max = recovery_max_active - recovery_ops_active;
   recovery_wq.unlock();
-  if (max == 0) {
+  if (max <= 0) {
+    // raced, or tune_recovery lowered the limit under the active ops
     dout(10) << "do_recovery raced and failed to start anything; requeuing " << *pg << dendl;
     recovery_wq.queue(pg);
   } else {
@@ -4935,7 +5156,7 @@ void OSD::do_recovery(PG *pg)
     pg->lock();
     
     dout(10) << "do_recovery starting " << max
-	     << " (" << recovery_ops_active << "/" << g_conf->osd_recovery_max_active << " rops) on "
+	     << " (" << recovery_ops_active << "/" << recovery_max_active << " rops) on "
 	     << *pg << dendl;
 #ifdef DEBUG_RECOVERY_OIDS
     dout(20) << "  active was " << recovery_oids[pg->info.pgid] << dendl;
@@ -4951,7 +5172,7 @@ void OSD::do_recovery(PG *pg)
     int started = pg->start_recovery_ops(max, &rctx);
     
     dout(10) << "do_recovery started " << started
-	     << " (" << recovery_ops_active << "/" << g_conf->osd_recovery_max_active << " rops) on "
+	     << " (" << recovery_ops_active << "/" << recovery_max_active << " rops) on "
 	     << *pg << dendl;
 
     /*
@@ -4992,7 +5213,7 @@ void OSD::start_recovery_op(PG *pg, const hobject_t& soid)
 {
   recovery_wq.lock();
   dout(10) << "start_recovery_op " << *pg << " " << soid
-	   << " (" << recovery_ops_active << "/" << g_conf->osd_recovery_max_active << " rops)"
+	   << " (" << recovery_ops_active << "/" << recovery_max_active << " rops)"
 	   << dendl;
   assert(recovery_ops_active >= 0);
   recovery_ops_active++;
@@ -5010,7 +5231,7 @@ void OSD::finish_recovery_op(PG *pg, const hobject_t& soid, bool dequeue)
 {
   dout(10) << "finish_recovery_op " << *pg << " " << soid
 	   << " dequeue=" << dequeue
-	   << " (" << recovery_ops_active << "/" << g_conf->osd_recovery_max_active << " rops)"
+	   << " (" << recovery_ops_active << "/" << recovery_max_active << " rops)"
 	   << dendl;
   recovery_wq.lock();
 
@@ -5277,6 +5498,116 @@ void OSD::handle_sub_op(OpRequestRef op)
   pg->put();
 }
 
+/*
+ * Replies from a replica arrive in one message; dispatch each of them
+ * in order while we hold osd_lock for the batch, exactly as if they
+ * had come in separately.
+ */
+void OSD::handle_sub_op_reply_batch(MOSDSubOpReplyBatch *m)
+{
+  dout(10) << "handle_sub_op_reply_batch " << *m << " from " << m->get_source() << dendl;
+  vector<MOSDSubOpReply*> ls;
+  m->take_replies(ls);
+  m->put();
+  for (vector<MOSDSubOpReply*>::iterator p = ls.begin(); p != ls.end(); ++p)
+    _dispatch(*p);
+}
+
+/*
+ * Small objects pushed to us during recovery, several per message.
+ */
+void OSD::handle_sub_op_batch(MOSDSubOpBatch *m)
+{
+  dout(10) << "handle_sub_op_batch " << *m << " from " << m->get_source() << dendl;
+  vector<MOSDSubOp*> ls;
+  m->take_subops(ls);
+  m->put();
+  for (vector<MOSDSubOp*>::iterator p = ls.begin(); p != ls.end(); ++p)
+    _dispatch(*p);
+}
+
+struct C_FlushSubOpReplies : public Context {
+  OSD *osd;
+  C_FlushSubOpReplies(OSD *o) : osd(o) {}
+  void finish(int r) {
+    osd->flush_sub_op_replies();
+  }
+};
+
+/*
+ * Acks and commits to a primary that understands MOSDSubOpReplyBatch
+ * are queued per peer, and a flush is queued on subop_reply_finisher
+ * when the first one shows up.  Replies generated while that flush is
+ * waiting to run (the rest of a journal commit's completions, say)
+ * join the same message, so there is no timer and no added latency
+ * when we are idle.  osd_subop_reply_batch_max bounds a batch.
+ */
+void OSD::send_sub_op_reply(MOSDSubOpReply *r, const entity_inst_t& inst)
+{
+  int max = g_conf->osd_subop_reply_batch_max;
+  Mutex::Locker l(subop_reply_lock);
+  SubOpReplyBatch& b = subop_reply_batches[inst.name.num()];
+  if (b.m && b.inst != inst)
+    _flush_sub_op_replies(b);  // the peer restarted
+
+  if (max > 1) {
+    Connection *con = cluster_messenger->get_connection(inst);
+    bool can_batch = con && con->has_feature(CEPH_FEATURE_SUBOPREPLYBATCH);
+    if (con)
+      con->put();
+    if (can_batch) {
+      if (!b.m) {
+	b.m = new MOSDSubOpReplyBatch;
+	b.inst = inst;
+      }
+      b.m->replies.push_back(r);
+      dout(20) << "send_sub_op_reply queued " << *r << " for " << inst
+	       << ", " << b.m->replies.size() << " pending" << dendl;
+      if ((int)b.m->replies.size() >= max) {
+	_flush_sub_op_replies(b);
+      } else if (!subop_reply_flush_queued) {
+	subop_reply_flush_queued = true;
+	subop_reply_finisher.queue(new C_FlushSubOpReplies(this));
+      }
+      return;
+    }
+  }
+
+  // keep anything already queued for this peer ahead of us
+  _flush_sub_op_replies(b);
+  cluster_messenger->send_message(r, inst);
+}
+
+void OSD::_flush_sub_op_replies(SubOpReplyBatch& b)
+{
+  assert(subop_reply_lock.is_locked());
+  if (!b.m)
+    return;
+  MOSDSubOpReplyBatch *m = b.m;
+  b.m = NULL;
+  dout(15) << "_flush_sub_op_replies " << m->replies.size() << " replies to " << b.inst << dendl;
+  if (m->replies.size() == 1) {
+    // not worth the wrapper
+    MOSDSubOpReply *r = m->replies.front();
+    m->replies.clear();
+    m->put();
+    cluster_messenger->send_message(r, b.inst);
+    return;
+  }
+  m->set_priority(CEPH_MSG_PRIO_HIGH);  // same as the replies themselves
+  cluster_messenger->send_message(m, b.inst);
+}
+
+void OSD::flush_sub_op_replies()
+{
+  Mutex::Locker l(subop_reply_lock);
+  subop_reply_flush_queued = false;
+  for (map<int, SubOpReplyBatch>::iterator p = subop_reply_batches.begin();
+       p != subop_reply_batches.end();
+       ++p)
+    _flush_sub_op_replies(p->second);
+}
+
 void OSD::handle_sub_op_reply(OpRequestRef op)
 {
   MOSDSubOpReply *m = (MOSDSubOpReply*)op->request;
@@ -22,6 +22,7 @@
 #include "common/Mutex.h"
 #include "common/RWLock.h"
 #include "common/Timer.h"
+#include "common/Finisher.h"
 #include "common/WorkQueue.h"
 #include "common/LogClient.h"
 
@@ -89,6 +90,9 @@ enum {
   l_osd_push_outb,
 
   l_osd_rop,
+  l_osd_rop_active,
+  l_osd_rop_max_active,
+  l_osd_rop_backlog,
 
   l_osd_loadavg,
   l_osd_buf,
@@ -103,6 +107,10 @@ enum {
   l_osd_mape,
   l_osd_mape_dup,
 
+  l_osd_notify,
+  l_osd_notify_fanout,
+  l_osd_notify_lat,
+
   l_osd_last,
 };
 
@@ -309,6 +317,23 @@ public:
 
 
 private:
+  // -- batched sub op replies --
+  struct SubOpReplyBatch {
+    entity_inst_t inst;
+    class MOSDSubOpReplyBatch *m;
+    SubOpReplyBatch() : m(NULL) {}
+  };
+  Mutex subop_reply_lock;
+  map<int, SubOpReplyBatch> subop_reply_batches;  // by peer osd
+  bool subop_reply_flush_queued;
+  Finisher subop_reply_finisher;
+  void _flush_sub_op_replies(SubOpReplyBatch& b);
+  void flush_sub_op_replies();
+  friend struct C_FlushSubOpReplies;
+public:
+  void send_sub_op_reply(class MOSDSubOpReply *r, const entity_inst_t& inst);
+private:
+
   // -- stats --
   Mutex stat_lock;
   osd_stat_t osd_stat;
@@ -399,6 +424,7 @@ private:
   bool _share_map_incoming(const entity_inst_t& inst, epoch_t epoch,
 			   Session *session = 0);
   void _share_map_outgoing(const entity_inst_t& inst);
+  void share_map_with_peers();
 
   void wait_for_new_map(OpRequestRef op);
   void handle_osd_map(class MOSDMap *m);
@@ -688,6 +714,9 @@ protected:
   xlist<PG*> recovery_queue;
   utime_t defer_recovery_until;
   int recovery_ops_active;
+  int recovery_max_active;	 // <= osd_recovery_max_active; see tune_recovery()
+  double recovery_tune_lat_sum;	 // op_latency sum and op count at the last tune
+  uint64_t recovery_tune_ops;
 #ifdef DEBUG_RECOVERY_OIDS
   map<pg_t, set<hobject_t> > recovery_oids;
 #endif
@@ -746,6 +775,7 @@ protected:
   void defer_recovery(PG *pg);
   void do_recovery(PG *pg);
   bool _recover_now();
+  void tune_recovery();
 
   Mutex remove_list_lock;
   map<epoch_t, map<int, vector<pg_t> > > remove_list;
@@ -1071,6 +1101,8 @@ public:
   void handle_op(OpRequestRef op);
   void handle_sub_op(OpRequestRef op);
   void handle_sub_op_reply(OpRequestRef op);
+  void handle_sub_op_reply_batch(class MOSDSubOpReplyBatch *m);
+  void handle_sub_op_batch(class MOSDSubOpBatch *m);
 
 private:
   /// check if we can throw out op from a disconnected client
@@ -1094,6 +1126,14 @@ public:
 			ReplicatedPG *pg);
   Mutex watch_lock;
   SafeTimer watch_timer;
+
+  // -- watch notify fan-out --
+  Mutex notify_send_lock;
+  map<Connection*, list<Message*> > notify_send_queue;  // by client connection
+  bool notify_flush_queued;
+  Finisher notify_finisher;
+  void send_watch_notify(class MWatchNotify *m, Connection *con);
+  void flush_watch_notifies();
   void handle_notify_timeout(void *notif);
   void disconnect_session_watches(Session *session);
   void handle_watch_timeout(void *obc,
@@ -440,13 +440,77 @@ void OSDMap::set_max_osd(int m)
     osd_weight[o] = CEPH_OSD_OUT;
   }
   osd_info.resize(m);
-  osd_addr.resize(m);
-  osd_cluster_addr.resize(m);
-  osd_hb_addr.resize(m);
+
+  _unshare_addrs();
+  std::tr1::shared_ptr<entity_addr_t> empty(new entity_addr_t);
+  osd_addrs->client_addr.resize(m, empty);
+  osd_addrs->cluster_addr.resize(m, empty);
+  osd_addrs->hb_addr.resize(m, empty);
 
   calc_num_osds();
 }
 
+void OSDMap::_unshare_addrs()
+{
+  if (!osd_addrs.unique())
+    osd_addrs.reset(new addrs_t(*osd_addrs));
+}
+
+void OSDMap::_unshare_pg_temp()
+{
+  if (!pg_temp.unique())
+    pg_temp.reset(new map<pg_t,vector<int> >(*pg_temp));
+}
+
+void OSDMap::dedup(const OSDMap *o, OSDMap *n)
+{
+  if (o->epoch == n->epoch)
+    return;
+
+  // addrs: share the individual entries, and the whole table if
+  // nothing changed.  n's table may itself already be shared (it was
+  // copied from an earlier epoch), in which case leave its entries be.
+  bool private_addrs = n->osd_addrs.unique();
+  int diff = 0;
+  if (o->max_osd != n->max_osd)
+    diff++;
+  for (int i = 0; i < o->max_osd && i < n->max_osd; i++) {
+    if (o->osd_addrs->client_addr[i] != n->osd_addrs->client_addr[i]) {
+      if (*o->osd_addrs->client_addr[i] != *n->osd_addrs->client_addr[i])
+	diff++;
+      else if (private_addrs)
+	n->osd_addrs->client_addr[i] = o->osd_addrs->client_addr[i];
+    }
+    if (o->osd_addrs->cluster_addr[i] != n->osd_addrs->cluster_addr[i]) {
+      if (*o->osd_addrs->cluster_addr[i] != *n->osd_addrs->cluster_addr[i])
+	diff++;
+      else if (private_addrs)
+	n->osd_addrs->cluster_addr[i] = o->osd_addrs->cluster_addr[i];
+    }
+    if (o->osd_addrs->hb_addr[i] != n->osd_addrs->hb_addr[i]) {
+      if (*o->osd_addrs->hb_addr[i] != *n->osd_addrs->hb_addr[i])
+	diff++;
+      else if (private_addrs)
+	n->osd_addrs->hb_addr[i] = o->osd_addrs->hb_addr[i];
+    }
+  }
+  if (diff == 0)
+    n->osd_addrs = o->osd_addrs;
+
+  // pg_temp
+  if (o->pg_temp != n->pg_temp && *o->pg_temp == *n->pg_temp)
+    n->pg_temp = o->pg_temp;
+
+  // crush
+  if (o->crush != n->crush) {
+    bufferlist oc, nc;
+    o->crush->encode(oc);
+    n->crush->encode(nc);
+    if (oc.contents_equal(nc))
+      n->crush = o->crush;
+  }
+}
+
 
 int OSDMap::calc_num_osds()
 {
@@ -540,21 +604,23 @@ int OSDMap::apply_incremental(Incremental &inc)
     }
     osd_state[i->first] ^= s;
   }
+  if (!inc.new_up_client.empty() || !inc.new_up_internal.empty())
+    _unshare_addrs();
   for (map<int32_t,entity_addr_t>::iterator i = inc.new_up_client.begin();
        i != inc.new_up_client.end();
        i++) {
     osd_state[i->first] |= CEPH_OSD_EXISTS | CEPH_OSD_UP;
-    osd_addr[i->first] = i->second;
+    osd_addrs->client_addr[i->first].reset(new entity_addr_t(i->second));
     if (inc.new_hb_up.empty())
-      osd_hb_addr[i->first] = i->second;	//this is a backward-compatibility hack
+      osd_addrs->hb_addr[i->first] = osd_addrs->client_addr[i->first];	//this is a backward-compatibility hack
     else
-      osd_hb_addr[i->first] = inc.new_hb_up[i->first];
+      osd_addrs->hb_addr[i->first].reset(new entity_addr_t(inc.new_hb_up[i->first]));
     osd_info[i->first].up_from = epoch;
   }
   for (map<int32_t,entity_addr_t>::iterator i = inc.new_up_internal.begin();
        i != inc.new_up_internal.end();
        i++)
-    osd_cluster_addr[i->first] = i->second;
+    osd_addrs->cluster_addr[i->first].reset(new entity_addr_t(i->second));
   // info
   for (map<int32_t,epoch_t>::iterator i = inc.new_up_thru.begin();
        i != inc.new_up_thru.end();
@@ -570,11 +636,13 @@ int OSDMap::apply_incremental(Incremental &inc)
     osd_info[p->first].lost_at = p->second;
 
   // pg rebuild
+  if (!inc.new_pg_temp.empty())
+    _unshare_pg_temp();
   for (map<pg_t, vector<int> >::iterator p = inc.new_pg_temp.begin(); p != inc.new_pg_temp.end(); p++) {
     if (p->second.empty())
-      pg_temp.erase(p->first);
+      pg_temp->erase(p->first);
     else
-      pg_temp[p->first] = p->second;
+      (*pg_temp)[p->first] = p->second;
   }
 
   // blacklist
@@ -599,7 +667,8 @@ int OSDMap::apply_incremental(Incremental &inc)
   // do new crush map last (after up/down stuff)
   if (inc.crush.length()) {
     bufferlist::iterator blp = inc.crush.begin();
-    crush.decode(blp);
+    crush.reset(new CrushWrapper);
+    crush->decode(blp);
   }
 
   calc_num_osds();
@@ -647,13 +716,13 @@ void OSDMap::encode_client_old(bufferlist& bl) const
   ::encode(max_osd, bl);
   ::encode(osd_state, bl);
   ::encode(osd_weight, bl);
-  ::encode(osd_addr, bl);
+  ::encode(osd_addrs->client_addr, bl);
 
   // for ::encode(pg_temp, bl);
-  n = pg_temp.size();
+  n = pg_temp->size();
   ::encode(n, bl);
-  for (map<pg_t,vector<int32_t> >::const_iterator p = pg_temp.begin();
-       p != pg_temp.end();
+  for (map<pg_t,vector<int32_t> >::const_iterator p = pg_temp->begin();
+       p != pg_temp->end();
        ++p) {
     old_pg_t opg = p->first.get_old_pg();
     ::encode(opg, bl);
@@ -662,7 +731,7 @@ void OSDMap::encode_client_old(bufferlist& bl) const
 
   // crush
   bufferlist cbl;
-  crush.encode(cbl);
+  crush->encode(cbl);
   ::encode(cbl, bl);
 }
 
@@ -691,22 +760,22 @@ void OSDMap::encode(bufferlist& bl, uint64_t features) const
   ::encode(max_osd, bl);
   ::encode(osd_state, bl);
   ::encode(osd_weight, bl);
-  ::encode(osd_addr, bl);
+  ::encode(osd_addrs->client_addr, bl);
 
-  ::encode(pg_temp, bl);
+  ::encode(*pg_temp, bl);
 
   // crush
   bufferlist cbl;
-  crush.encode(cbl);
+  crush->encode(cbl);
   ::encode(cbl, bl);
 
   // extended
   __u16 ev = CEPH_OSDMAP_VERSION_EXT;
   ::encode(ev, bl);
-  ::encode(osd_hb_addr, bl);
+  ::encode(osd_addrs->hb_addr, bl);
   ::encode(osd_info, bl);
   ::encode(blacklist, bl);
-  ::encode(osd_cluster_addr, bl);
+  ::encode(osd_addrs->cluster_addr, bl);
   ::encode(cluster_snapshot_epoch, bl);
   ::encode(cluster_snapshot, bl);
 }
@@ -769,39 +838,44 @@ void OSDMap::decode(bufferlist::iterator& p)
   ::decode(max_osd, p);
   ::decode(osd_state, p);
   ::decode(osd_weight, p);
-  ::decode(osd_addr, p);
+  // never decode into pieces we may be sharing with another epoch
+  osd_addrs.reset(new addrs_t);
+  ::decode(osd_addrs->client_addr, p);
+  pg_temp.reset(new map<pg_t,vector<int> >);
   if (v <= 5) {
-    pg_temp.clear();
     ::decode(n, p);
     while (n--) {
       old_pg_t opg;
       ::decode_raw(opg, p);
-      ::decode(pg_temp[pg_t(opg)], p);
+      ::decode((*pg_temp)[pg_t(opg)], p);
     }
   } else {
-    ::decode(pg_temp, p);
+    ::decode(*pg_temp, p);
   }
 
   // crush
   bufferlist cbl;
   ::decode(cbl, p);
   bufferlist::iterator cblp = cbl.begin();
-  crush.decode(cblp);
+  crush.reset(new CrushWrapper);
+  crush->decode(cblp);
 
   // extended
   __u16 ev = 0;
   if (v >= 5)
     ::decode(ev, p);
-  ::decode(osd_hb_addr, p);
+  ::decode(osd_addrs->hb_addr, p);
   ::decode(osd_info, p);
   if (v < 5)
     ::decode(pool_name, p);
 
   ::decode(blacklist, p);
-  if (ev >= 6)
-    ::decode(osd_cluster_addr, p);
-  else
-    osd_cluster_addr.resize(osd_addr.size());
+  if (ev >= 6) {
+    ::decode(osd_addrs->cluster_addr, p);
+  } else {
+    std::tr1::shared_ptr<entity_addr_t> empty(new entity_addr_t);
+    osd_addrs->cluster_addr.resize(osd_addrs->client_addr.size(), empty);
+  }
 
   if (ev >= 7) {
     ::decode(cluster_snapshot_epoch, p);
@@ -871,8 +945,8 @@ void OSDMap::dump(Formatter *f) const
   f->close_section();
 
   f->open_array_section("pg_temp");
-  for (map<pg_t,vector<int> >::const_iterator p = pg_temp.begin();
-       p != pg_temp.end();
+  for (map<pg_t,vector<int> >::const_iterator p = pg_temp->begin();
+       p != pg_temp->end();
        p++) {
     f->open_array_section("osds");
     for (vector<int>::const_iterator q = p->second.begin(); q != p->second.end(); ++q)
@@ -977,8 +1051,8 @@ void OSDMap::print(ostream& out) const
   }
   out << std::endl;
 
-  for (map<pg_t,vector<int> >::const_iterator p = pg_temp.begin();
-       p != pg_temp.end();
+  for (map<pg_t,vector<int> >::const_iterator p = pg_temp->begin();
+       p != pg_temp->end();
        p++)
     out << "pg_temp " << p->first << " " << p->second << "\n";
 
@@ -1009,10 +1083,10 @@ void OSDMap::print_tree(ostream& out) const
   out << "# id\tweight\ttype name\tup/down\treweight\n";
   set<int> touched;
   set<int> roots;
-  crush.find_roots(roots);
+  crush->find_roots(roots);
   for (set<int>::iterator p = roots.begin(); p != roots.end(); p++) {
     list<qi> q;
-    q.push_back(qi(*p, 0, crush.get_bucket_weight(*p) / (float)0x10000));
+    q.push_back(qi(*p, 0, crush->get_bucket_weight(*p) / (float)0x10000));
     while (!q.empty()) {
       int cur = q.front().item;
       int depth = q.front().depth;
@@ -1030,14 +1104,14 @@ void OSDMap::print_tree(ostream& out) const
 	continue;
       }
 
-      int type = crush.get_bucket_type(cur);
-      out << crush.get_type_name(type) << " " << crush.get_item_name(cur) << "\n";
+      int type = crush->get_bucket_type(cur);
+      out << crush->get_type_name(type) << " " << crush->get_item_name(cur) << "\n";
 
       // queue bucket contents...
-      int s = crush.get_bucket_size(cur);
+      int s = crush->get_bucket_size(cur);
       for (int k=s-1; k>=0; k--)
-	q.push_front(qi(crush.get_bucket_item(cur, k), depth+1,
-			(float)crush.get_bucket_item_weight(cur, k) / (float)0x10000));
+	q.push_front(qi(crush->get_bucket_item(cur, k), depth+1,
+			(float)crush->get_bucket_item_weight(cur, k) / (float)0x10000));
     }
   }
 
@@ -1109,7 +1183,7 @@ void OSDMap::build_simple(CephContext *cct, epoch_t e, uuid_d &fsid,
     pool_name[pool] = p->second;
   }
 
-  build_simple_crush_map(cct, crush, rulesets, nosd);
+  build_simple_crush_map(cct, *crush, rulesets, nosd);
 
   for (int i=0; i<nosd; i++) {
     set_state(i, 0);
@@ -1225,7 +1299,7 @@ void OSDMap::build_simple_from_conf(CephContext *cct, epoch_t e, uuid_d &fsid,
     pool_name[pool] = p->second;
   }
 
-  build_simple_crush_map_from_conf(cct, crush, rulesets);
+  build_simple_crush_map_from_conf(cct, *crush, rulesets);
 
   for (int i=0; i<=maxosd; i++) {
     set_state(i, 0);
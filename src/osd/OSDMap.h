@@ -167,12 +167,25 @@ private:
   int num_osd;         // not saved
   int32_t max_osd;
   vector<uint8_t> osd_state;
-  vector<entity_addr_t> osd_addr;
-  vector<entity_addr_t> osd_cluster_addr;
-  vector<entity_addr_t> osd_hb_addr;
+
+  /*
+   * The bulky parts of the map (addresses, pg_temp, crush) are held
+   * through shared pointers so that consecutive epochs can share
+   * whatever did not change; see dedup().  They are treated as
+   * immutable once shared: anything that modifies them goes through
+   * the _unshare_*() helpers first, and addresses are replaced rather
+   * than written in place.
+   */
+  struct addrs_t {
+    vector<std::tr1::shared_ptr<entity_addr_t> > client_addr;
+    vector<std::tr1::shared_ptr<entity_addr_t> > cluster_addr;
+    vector<std::tr1::shared_ptr<entity_addr_t> > hb_addr;
+  };
+  std::tr1::shared_ptr<addrs_t> osd_addrs;
+
   vector<__u32>   osd_weight;   // 16.16 fixed point, 0x10000 = "in", 0 = "out"
   vector<osd_info_t> osd_info;
-  map<pg_t,vector<int> > pg_temp;  // temp pg mapping (e.g. while we rebuild)
+  std::tr1::shared_ptr< map<pg_t,vector<int> > > pg_temp;  // temp pg mapping (e.g. while we rebuild)
 
   map<int64_t,pg_pool_t> pools;
   map<int64_t,string> pool_name;
@@ -184,21 +197,34 @@ private:
   string cluster_snapshot;
 
  public:
-  CrushWrapper     crush;       // hierarchical map
+  std::tr1::shared_ptr<CrushWrapper> crush;       // hierarchical map
 
   friend class OSDMonitor;
   friend class PGMonitor;
   friend class MDS;
 
+ private:
+  void _unshare_addrs();
+  void _unshare_pg_temp();
+
  public:
   OSDMap() : epoch(0), 
 	     pool_max(-1),
 	     flags(0),
 	     num_osd(0), max_osd(0),
-	     cluster_snapshot_epoch(0) { 
+	     osd_addrs(new addrs_t),
+	     pg_temp(new map<pg_t,vector<int> >),
+	     cluster_snapshot_epoch(0),
+	     crush(new CrushWrapper) { 
     memset(&fsid, 0, sizeof(fsid));
   }
 
+  /*
+   * Make n share every piece that is identical in o.  n must not be
+   * visible to anyone else yet (i.e. freshly decoded).
+   */
+  static void dedup(const OSDMap *o, OSDMap *n);
+
   // map info
   const uuid_d& get_fsid() const { return fsid; }
   void set_fsid(uuid_d& f) { fsid = f; }
@@ -324,8 +350,8 @@ private:
   }
   
   int identify_osd(const entity_addr_t& addr) const {
-    for (unsigned i=0; i<osd_addr.size(); i++)
-      if ((osd_addr[i] == addr) || (osd_cluster_addr[i] == addr))
+    for (unsigned i=0; i<osd_addrs->client_addr.size(); i++)
+      if ((*osd_addrs->client_addr[i] == addr) || (*osd_addrs->cluster_addr[i] == addr))
 	return i;
     return -1;
   }
@@ -333,8 +359,9 @@ private:
     return identify_osd(addr) >= 0;
   }
   bool find_osd_on_ip(const entity_addr_t& ip) const {
-    for (unsigned i=0; i<osd_addr.size(); i++)
-      if (osd_addr[i].is_same_host(ip) || osd_cluster_addr[i].is_same_host(ip))
+    for (unsigned i=0; i<osd_addrs->client_addr.size(); i++)
+      if (osd_addrs->client_addr[i]->is_same_host(ip) ||
+	  osd_addrs->cluster_addr[i]->is_same_host(ip))
 	return i;
     return -1;
   }
@@ -343,34 +370,34 @@ private:
   }
   const entity_addr_t &get_addr(int osd) const {
     assert(exists(osd));
-    return osd_addr[osd];
+    return *osd_addrs->client_addr[osd];
   }
   const entity_addr_t &get_cluster_addr(int osd) const {
     assert(exists(osd));
-    if (osd_cluster_addr[osd] == entity_addr_t())
+    if (*osd_addrs->cluster_addr[osd] == entity_addr_t())
       return get_addr(osd);
-    return osd_cluster_addr[osd];
+    return *osd_addrs->cluster_addr[osd];
   }
   const entity_addr_t &get_hb_addr(int osd) const {
     assert(exists(osd));
-    return osd_hb_addr[osd];
+    return *osd_addrs->hb_addr[osd];
   }
   entity_inst_t get_inst(int osd) const {
     assert(exists(osd));
     assert(is_up(osd));
-    return entity_inst_t(entity_name_t::OSD(osd), osd_addr[osd]);
+    return entity_inst_t(entity_name_t::OSD(osd), *osd_addrs->client_addr[osd]);
   }
   entity_inst_t get_cluster_inst(int osd) const {
     assert(exists(osd));
     assert(is_up(osd));
-    if (osd_cluster_addr[osd] == entity_addr_t())
+    if (*osd_addrs->cluster_addr[osd] == entity_addr_t())
       return get_inst(osd);
-    return entity_inst_t(entity_name_t::OSD(osd), osd_cluster_addr[osd]);
+    return entity_inst_t(entity_name_t::OSD(osd), *osd_addrs->cluster_addr[osd]);
   }
   entity_inst_t get_hb_inst(int osd) const {
     assert(exists(osd));
     assert(is_up(osd));
-    return entity_inst_t(entity_name_t::OSD(osd), osd_hb_addr[osd]);
+    return entity_inst_t(entity_name_t::OSD(osd), *osd_addrs->hb_addr[osd]);
   }
 
   const epoch_t& get_up_from(int osd) const {
@@ -469,15 +496,15 @@ private:
     unsigned size = pool.get_size();
     {
       int preferred = pg.preferred();
-      if (preferred >= max_osd || preferred >= crush.get_max_devices())
+      if (preferred >= max_osd || preferred >= crush->get_max_devices())
 	preferred = -1;
 
-      assert(get_max_osd() >= crush.get_max_devices());
+      assert(get_max_osd() >= crush->get_max_devices());
 
       // what crush rule?
-      int ruleno = crush.find_rule(pool.get_crush_ruleset(), pool.get_type(), size);
+      int ruleno = crush->find_rule(pool.get_crush_ruleset(), pool.get_type(), size);
       if (ruleno >= 0)
-	crush.do_rule(ruleno, pps, osds, size, preferred, osd_weight);
+	crush->do_rule(ruleno, pps, osds, size, preferred, osd_weight);
     }
   
     return osds.size();
@@ -495,8 +522,8 @@ private:
   
   bool _raw_to_temp_osds(const pg_pool_t& pool, pg_t pg, vector<int>& raw, vector<int>& temp) const {
     pg = pool.raw_pg_to_pg(pg);
-    map<pg_t,vector<int> >::const_iterator p = pg_temp.find(pg);
-    if (p != pg_temp.end()) {
+    map<pg_t,vector<int> >::const_iterator p = pg_temp->find(pg);
+    if (p != pg_temp->end()) {
       temp.clear();
       for (unsigned i=0; i<p->second.size(); i++) {
 	if (!exists(p->second[i]) || is_down(p->second[i]))
@@ -22,6 +22,7 @@
 #include "messages/MOSDOp.h"
 #include "messages/MOSDOpReply.h"
 #include "messages/MOSDSubOp.h"
+#include "messages/MOSDSubOpBatch.h"
 #include "messages/MOSDSubOpReply.h"
 
 #include "messages/MOSDPGNotify.h"
@@ -574,7 +575,7 @@ void ReplicatedPG::calc_trim_to()
 }
 
 ReplicatedPG::ReplicatedPG(OSD *o, PGPool *_pool, pg_t p, const hobject_t& oid, const hobject_t& ioid) : 
-  PG(o, _pool, p, oid, ioid), temp_created(false),
+  PG(o, _pool, p, oid, ioid), batching_pushes(false), temp_created(false),
   temp_coll(coll_t::make_temp_coll(p)), snap_trimmer_machine(this)
 { 
   snap_trimmer_machine.initiate();
@@ -1687,25 +1688,15 @@ int ReplicatedPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
         map<uint64_t, uint64_t> m;
         bufferlist::iterator iter = bl.begin();
         ::decode(m, iter);
-        map<uint64_t, uint64_t>::iterator miter;
         bufferlist data_bl;
-        for (miter = m.begin(); miter != m.end(); ++miter) {
-          bufferlist tmpbl;
-          r = osd->store->read(coll, soid, miter->first, miter->second, tmpbl);
-          if (r < 0)
-            break;
-
-          if (r < (int)miter->second) /* this is usually happen when we get extent that exceeds the actual file size */
-            miter->second = r;
-          total_read += r;
-          dout(10) << "sparse-read " << miter->first << "@" << miter->second << dendl;
-	  data_bl.claim_append(tmpbl);
-        }
-
+        // extents past the actual file size come back trimmed
+        r = osd->store->readv(coll, soid, m, data_bl);
         if (r < 0) {
           result = r;
           break;
         }
+        total_read = r;
+        dout(10) << "sparse-read " << m << dendl;
 
         op.extent.length = total_read;
 
@@ -3000,7 +2991,7 @@ void ReplicatedPG::do_osd_op_effects(OpContext *ctx)
 	  /* there is a pending notification for this watcher, we should resend it anyway
 	     even if we already sent it as it might not have received it */
 	  MWatchNotify *notify_msg = new MWatchNotify(w.cookie, oi.user_version.version, notif->id, WATCH_NOTIFY, notif->bl);
-	  osd->client_messenger->send_message(notify_msg, session->con);
+	  osd->send_watch_notify(notify_msg, session->con);
 	}
       }
     }
@@ -3024,6 +3015,8 @@ void ReplicatedPG::do_osd_op_effects(OpContext *ctx)
       session->get();  // notif got a reference
       session->con->get();
       notif->pgid = get_osdmap()->object_locator_to_pg(soid.oid, obc->obs.oi.oloc);
+      notif->start = ceph_clock_now(g_ceph_context);
+      osd->logger->inc(l_osd_notify);
 
       osd->watch->add_notification(notif);
 
@@ -3041,7 +3034,7 @@ void ReplicatedPG::do_osd_op_effects(OpContext *ctx)
 	  s->add_notif(notif, name);
 
 	  MWatchNotify *notify_msg = new MWatchNotify(w.cookie, oi.user_version.version, notif->id, WATCH_NOTIFY, notif->bl);
-	  osd->client_messenger->send_message(notify_msg, s->con);
+	  osd->send_watch_notify(notify_msg, s->con);
 	} else {
 	  // unconnected
 	  entity_name_t name = i->first;
@@ -4183,7 +4176,7 @@ void ReplicatedPG::sub_op_modify_applied(RepModify *rm)
     // send ack to acker only if we haven't sent a commit already
     MOSDSubOpReply *ack = new MOSDSubOpReply(m, 0, get_osdmap()->get_epoch(), CEPH_OSD_FLAG_ACK);
     ack->set_priority(CEPH_MSG_PRIO_HIGH); // this better match commit priority!
-    osd->cluster_messenger->send_message(ack, get_osdmap()->get_cluster_inst(rm->ackerosd));
+    osd->send_sub_op_reply(ack, get_osdmap()->get_cluster_inst(rm->ackerosd));
   }
 
   rm->applied = true;
@@ -4226,7 +4219,7 @@ void ReplicatedPG::sub_op_modify_commit(RepModify *rm)
     MOSDSubOpReply *commit = new MOSDSubOpReply((MOSDSubOp*)rm->op->request, 0, get_osdmap()->get_epoch(), CEPH_OSD_FLAG_ONDISK);
     commit->set_last_complete_ondisk(rm->last_complete);
     commit->set_priority(CEPH_MSG_PRIO_HIGH); // this better match ack priority!
-    osd->cluster_messenger->send_message(commit, get_osdmap()->get_cluster_inst(rm->ackerosd));
+    osd->send_sub_op_reply(commit, get_osdmap()->get_cluster_inst(rm->ackerosd));
   }
   
   rm->committed = true;
@@ -4606,10 +4599,27 @@ void ReplicatedPG::push_start(
   pi.recovery_progress.data_recovered_to = 0;
   pi.recovery_progress.data_complete = 0;
   pi.recovery_progress.omap_complete = 0;
+  pi.in_flight = 0;
+
+  send_push_chunks(peer, pi);
+}
 
-  ObjectRecoveryProgress new_progress;
-  send_push(peer, pi.recovery_info, pi.recovery_progress, &new_progress);
-  pi.recovery_progress = new_progress;
+/*
+ * Keep up to osd_recovery_push_pipeline chunks of a push on the wire
+ * instead of waiting for each ack before reading the next chunk.  The
+ * replica queues them in the order we sent them (one connection, one
+ * pg queue), so only the ack accounting changes.
+ */
+void ReplicatedPG::send_push_chunks(int peer, PushInfo &pi)
+{
+  unsigned window = MAX(1, g_conf->osd_recovery_push_pipeline);
+  while (!pi.recovery_progress.data_complete && pi.in_flight < window) {
+    ObjectRecoveryProgress new_progress;
+    if (send_push(peer, pi.recovery_info, pi.recovery_progress, &new_progress) < 0)
+      break;
+    pi.recovery_progress = new_progress;
+    pi.in_flight++;
+  }
 }
 
 int ReplicatedPG::send_pull(int peer,
@@ -4922,7 +4932,7 @@ void ReplicatedPG::handle_push(OpRequestRef op)
   MOSDSubOpReply *reply = new MOSDSubOpReply(
     m, 0, get_osdmap()->get_epoch(), CEPH_OSD_FLAG_ACK);
   assert(entity_name_t::TYPE_OSD == m->get_connection()->peer_type);
-  osd->cluster_messenger->send_message(reply, m->get_connection());
+  osd->send_sub_op_reply(reply, m->get_source_inst());
 }
 
 int ReplicatedPG::send_push(int peer,
@@ -5022,13 +5032,86 @@ int ReplicatedPG::send_push(int peer,
   subop->recovery_info = recovery_info;
   subop->recovery_progress = new_progress;
   subop->current_progress = progress;
-  osd->cluster_messenger->
-    send_message(subop, get_osdmap()->get_cluster_inst(peer));
+  if (!queue_push(peer, subop))
+    osd->cluster_messenger->
+      send_message(subop, get_osdmap()->get_cluster_inst(peer));
   if (out_progress)
     *out_progress = new_progress;
   return 0;
 }
 
+/*
+ * While start_recovery_ops is running, pushes that carry an entire
+ * object in one chunk are held back and sent to each peer as a single
+ * MOSDSubOpBatch, so that recovering many small objects isn't bound by
+ * one message (and one round of replica queueing) per object.  A
+ * batch goes out when it reaches osd_recovery_max_chunk bytes or
+ * osd_recovery_push_batch_max objects, and in any case before
+ * start_recovery_ops returns.
+ */
+bool ReplicatedPG::queue_push(int peer, MOSDSubOp *subop)
+{
+  int max = g_conf->osd_recovery_push_batch_max;
+  if (!batching_pushes || max <= 1)
+    return false;
+  if (!subop->current_progress.first || !subop->recovery_progress.data_complete)
+    return false;
+
+  PushBatch &b = push_batches[peer];
+  if (!b.m) {
+    Connection *con = osd->cluster_messenger->get_connection(
+      get_osdmap()->get_cluster_inst(peer));
+    bool can_batch = con && con->has_feature(CEPH_FEATURE_SUBOPBATCH);
+    if (con)
+      con->put();
+    if (!can_batch) {
+      push_batches.erase(peer);
+      return false;
+    }
+    b.m = new MOSDSubOpBatch;
+  }
+
+  uint64_t len = subop->ops[0].indata.length();
+  if (!b.m->subops.empty() && b.bytes + len > g_conf->osd_recovery_max_chunk) {
+    osd->cluster_messenger->
+      send_message(b.m, get_osdmap()->get_cluster_inst(peer));
+    b.m = new MOSDSubOpBatch;
+    b.bytes = 0;
+  }
+  b.m->subops.push_back(subop);
+  b.bytes += len;
+  dout(20) << "queue_push " << subop->poid << " to osd." << peer
+	   << ", " << b.m->subops.size() << " queued" << dendl;
+  if ((int)b.m->subops.size() >= max) {
+    osd->cluster_messenger->
+      send_message(b.m, get_osdmap()->get_cluster_inst(peer));
+    push_batches.erase(peer);
+  }
+  return true;
+}
+
+void ReplicatedPG::flush_pushes()
+{
+  for (map<int, PushBatch>::iterator p = push_batches.begin();
+       p != push_batches.end();
+       ++p) {
+    MOSDSubOpBatch *m = p->second.m;
+    dout(15) << "flush_pushes " << m->subops.size() << " to osd." << p->first << dendl;
+    if (m->subops.size() == 1) {
+      // not worth the wrapper
+      MOSDSubOp *subop = m->subops.front();
+      m->subops.clear();
+      m->put();
+      osd->cluster_messenger->
+	send_message(subop, get_osdmap()->get_cluster_inst(p->first));
+    } else {
+      osd->cluster_messenger->
+	send_message(m, get_osdmap()->get_cluster_inst(p->first));
+    }
+  }
+  push_batches.clear();
+}
+
 void ReplicatedPG::send_push_op_blank(const hobject_t& soid, int peer)
 {
   // send a blank push back to the primary
@@ -5063,15 +5146,17 @@ void ReplicatedPG::sub_op_push_reply(OpRequestRef op)
 	     << dendl;
   } else {
     PushInfo *pi = &pushing[soid][peer];
+    if (pi->in_flight)
+      pi->in_flight--;
 
     if (!pi->recovery_progress.data_complete) {
       dout(10) << " pushing more from, "
 	       << pi->recovery_progress.data_recovered_to
 	       << " of " << pi->recovery_info.copy_subset << dendl;
-      ObjectRecoveryProgress new_progress;
-      send_push(
-	peer, pi->recovery_info, pi->recovery_progress, &new_progress);
-      pi->recovery_progress = new_progress;
+      send_push_chunks(peer, *pi);
+    } else if (pi->in_flight) {
+      dout(10) << " all of " << soid << " sent to osd." << peer
+	       << ", waiting for " << pi->in_flight << " more acks" << dendl;
     } else {
       // done!
       if (peer == backfill_target && backfills_in_flight.count(soid))
@@ -5720,6 +5805,8 @@ int ReplicatedPG::start_recovery_ops(int max, RecoveryCtx *prctx)
     info.last_complete = info.last_update;
   }
 
+  batching_pushes = true;
+
   if (num_missing == num_unfound) {
     // All of the missing objects we have are unfound.
     // Recover the replicas.
@@ -5739,6 +5826,9 @@ int ReplicatedPG::start_recovery_ops(int max, RecoveryCtx *prctx)
     started += recover_backfill(max - started);
   }
 
+  batching_pushes = false;
+  flush_pushes();
+
   dout(10) << " started " << started << dendl;
   osd->logger->inc(l_osd_rop, started);
 
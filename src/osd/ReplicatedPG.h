@@ -551,9 +551,21 @@ protected:
   struct PushInfo {
     ObjectRecoveryProgress recovery_progress;
     ObjectRecoveryInfo recovery_info;
+    unsigned in_flight;   // chunks sent but not yet acked
+    PushInfo() : in_flight(0) {}
   };
   map<hobject_t, map<int, PushInfo> > pushing;
 
+  // whole small objects queued for each peer while start_recovery_ops
+  // runs; see queue_push()
+  struct PushBatch {
+    class MOSDSubOpBatch *m;
+    uint64_t bytes;
+    PushBatch() : m(NULL), bytes(0) {}
+  };
+  map<int, PushBatch> push_batches;
+  bool batching_pushes;
+
   // pull
   struct PullInfo {
     ObjectRecoveryProgress recovery_progress;
@@ -577,6 +589,9 @@ protected:
 		ObjectRecoveryInfo recovery_info,
 		ObjectRecoveryProgress progress,
 		ObjectRecoveryProgress *out_progress = 0);
+  void send_push_chunks(int peer, PushInfo &pi);
+  bool queue_push(int peer, MOSDSubOp *subop);
+  void flush_pushes();
   int send_pull(int peer,
 		ObjectRecoveryInfo recovery_info,
 		ObjectRecoveryProgress progress);
@@ -44,6 +44,7 @@ public:
     void *obc;
     pg_t pgid;
     bufferlist bl;
+    utime_t start;
 
     void add_watcher(const entity_name_t& name, WatcherState state) {
       watchers[name] = state;
@@ -18,8 +18,10 @@
 #include "common/config.h"
 #include "global/global_init.h"
 #include "common/Cond.h"
+#include "common/Formatter.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 #include <stdlib.h>
 #include <time.h>
@@ -31,9 +33,27 @@ const int OP_SEQ_READ  = 2;
 const int OP_RAND_READ = 3;
 const char *BENCH_DATA = "benchmark_write_data";
 
+/*
+ * knobs beyond the basic write/seq run.  zeros mean "same as op_size"
+ * or "off".
+ */
+struct bench_opts {
+  int min_object_size;   // write: object sizes uniform in [min, op_size]
+  int min_op_size;       // rand: op sizes uniform in [min_op_size, max_op_size]
+  int max_op_size;
+  int read_percent;      // rand: 100 = random reads, 0 = random writes
+  int max_objects;       // rand: working set, from the last write run
+  double target_rate;    // ops/sec; issue open-loop at this rate
+  std::string json_file; // dump results here too
+
+  bench_opts() : min_object_size(0), min_op_size(0), max_op_size(0),
+		 read_percent(100), max_objects(0), target_rate(0) {}
+};
+
 struct bench_data {
   bool done; //is the benchmark is done
-  int object_size; //the size of the objects
+  int object_size; //the size of the objects (the largest, if they vary)
+  int min_object_size; //smallest object; == object_size unless they vary
   int trans_size; //size of the write/read to perform
   // same as object_size for write tests
   int in_flight; //number of reads/writes being waited on
@@ -45,8 +65,43 @@ struct bench_data {
   utime_t cur_latency; //latency of last completed transaction
   utime_t start_time; //start time for benchmark
   char *object_contents; //pointer to the contents written to each object
+  uint64_t bytes; //bytes moved by finished ops
+  int late; //open-loop ops issued after their due time
+  vector<double> read_latencies, write_latencies;
+
+  bench_data() : done(false), object_size(0), min_object_size(0), trans_size(0),
+		 in_flight(0), started(0), finished(0),
+		 min_latency(9999.0), max_latency(0), avg_latency(0),
+		 object_contents(NULL), bytes(0), late(0) {}
 };
 
+/*
+ * object sizes are a function of the object number so that readers
+ * can recompute them without any per-object metadata.
+ */
+int bench_object_size(bench_data *data, int objnum)
+{
+  if (data->min_object_size >= data->object_size)
+    return data->object_size;
+  uint32_t h = (uint32_t)objnum * 2654435761u;
+  return data->min_object_size + h % (data->object_size - data->min_object_size + 1);
+}
+
+/*
+ * the contents of [off, off+len) of object objnum, as write_bench
+ * wrote it: a name tag, then zeros.
+ */
+void bench_object_extent(bufferlist& bl, int objnum, uint64_t off, uint64_t len)
+{
+  char tag[64];
+  int taglen = snprintf(tag, sizeof(tag), "I'm the %dth object!", objnum);
+  bufferptr bp(len);
+  bp.zero();
+  if ((int)off < taglen)
+    memcpy(bp.c_str(), tag + off, MIN(len, taglen - off));
+  bl.append(bp);
+}
+
 void generate_object_name(char *s, size_t size, int objnum, int pid = 0)
 {
   char hostname[30];
@@ -60,27 +115,33 @@ void generate_object_name(char *s, size_t size, int objnum, int pid = 0)
 }
 
 int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
-		 int secondsToRun, int concurrentios, bench_data *data);
+		 int secondsToRun, int concurrentios, bench_data *data,
+		 const bench_opts& opts);
 int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
 		   int secondsToRun, int concurrentios, bench_data *data,
-		   int writePid);
+		   int writePid, const bench_opts& opts);
+int rand_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
+	       int secondsToRun, int concurrentios, bench_data *data,
+	       int writePid, const bench_opts& opts);
+void bench_report(bench_data *data, const char *mode, double runtime,
+		  int concurrentios, const bench_opts& opts);
 void *status_printer(void * data_store);
 void sanitize_object_contents(bench_data *data, int length);
 
 int aio_bench(librados::Rados& rados, librados::IoCtx &io_ctx, int operation,
-	      int secondsToRun, int concurrentios, int op_size) {
+	      int secondsToRun, int concurrentios, int op_size,
+	      const bench_opts& opts) {
   int object_size = op_size;
+  int min_object_size = op_size;
   int num_objects = 0;
-  char* contentsChars = new char[op_size];
   int r = 0;
   int prevPid = 0;
 
   //get data from previous write run, if available
   if (operation != OP_WRITE) {
     bufferlist object_data;
-    r = io_ctx.read(BENCH_DATA, object_data, sizeof(int)*3, 0);
+    r = io_ctx.read(BENCH_DATA, object_data, sizeof(int)*4, 0);
     if (r <= 0) {
-      delete[] contentsChars;
       if (r == -2)
 	cerr << "Must write data before running a read benchmark!" << std::endl;
       return r;
@@ -89,14 +150,22 @@ int aio_bench(librados::Rados& rados, librados::IoCtx &io_ctx, int operation,
     ::decode(object_size, p);
     ::decode(num_objects, p);
     ::decode(prevPid, p);
+    if (!p.end())
+      ::decode(min_object_size, p);
+    else
+      min_object_size = object_size;
   } else {
     object_size = op_size;
+    if (opts.min_object_size > 0 && opts.min_object_size < op_size)
+      min_object_size = opts.min_object_size;
   }
+  char* contentsChars = new char[object_size];
 
   dataLock.Lock();
   bench_data *data = new bench_data();
   data->done = false;
   data->object_size = object_size;
+  data->min_object_size = min_object_size;
   data->trans_size = op_size;
   data->in_flight = 0;
   data->started = 0;
@@ -111,16 +180,16 @@ int aio_bench(librados::Rados& rados, librados::IoCtx &io_ctx, int operation,
   sanitize_object_contents(data, data->object_size);
 
   if (OP_WRITE == operation) {
-    r = write_bench(rados, io_ctx, secondsToRun, concurrentios, data);
+    r = write_bench(rados, io_ctx, secondsToRun, concurrentios, data, opts);
     if (r != 0) goto out;
   }
   else if (OP_SEQ_READ == operation) {
-    r = seq_read_bench(rados, io_ctx, secondsToRun, concurrentios, data, prevPid);
+    r = seq_read_bench(rados, io_ctx, secondsToRun, concurrentios, data, prevPid, opts);
     if (r != 0) goto out;
   }
   else if (OP_RAND_READ == operation) {
-    cerr << "Random test not implemented yet!" << std::endl;
-    r = -1;
+    r = rand_bench(rados, io_ctx, secondsToRun, concurrentios, data, prevPid, opts);
+    if (r != 0) goto out;
   }
 
  out:
@@ -137,9 +206,12 @@ void _aio_cb(void *cb, void *arg) {
 }
 
 int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
-		 int secondsToRun, int concurrentios, bench_data *data) {
-  cout << "Maintaining " << concurrentios << " concurrent writes of "
-       << data->object_size << " bytes for at least "
+		 int secondsToRun, int concurrentios, bench_data *data,
+		 const bench_opts& opts) {
+  cout << "Maintaining " << concurrentios << " concurrent writes of ";
+  if (data->min_object_size < data->object_size)
+    cout << data->min_object_size << "-";
+  cout << data->object_size << " bytes for at least "
        << secondsToRun << " seconds." << std::endl;
 
   librados::AioCompletion* completions[concurrentios];
@@ -147,6 +219,7 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
   bufferlist* contents[concurrentios];
   double total_latency = 0;
   utime_t start_times[concurrentios];
+  int sizes[concurrentios];
   utime_t stopTime;
   int r = 0;
   bufferlist b_write;
@@ -160,7 +233,8 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     contents[i] = new bufferlist();
     generate_object_name(name[i], 128, i);
     snprintf(data->object_contents, data->object_size, "I'm the %dth object!", i);
-    contents[i]->append(data->object_contents, data->object_size);
+    sizes[i] = bench_object_size(data, i);
+    contents[i]->append(data->object_contents, sizes[i]);
   }
 
   pthread_t print_thread;
@@ -173,7 +247,7 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     start_times[i] = ceph_clock_now(g_ceph_context);
     completions[i] = rados.aio_create_completion((void *) &cond, 0,
 						 &_aio_cb);
-    r = io_ctx.aio_write(name[i], completions[i], *contents[i], data->object_size, 0);
+    r = io_ctx.aio_write(name[i], completions[i], *contents[i], sizes[i], 0);
     if (r < 0) { //naughty, doesn't clean up heap
       goto ERR;
     }
@@ -187,6 +261,7 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
   int slot;
   bufferlist* newContents;
   char* newName;
+  int newSize;
 
   //don't need locking for reads because other thread doesn't write
 
@@ -211,7 +286,8 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     newName = new char[128];
     generate_object_name(newName, 128, data->started);
     snprintf(data->object_contents, data->object_size, "I'm the %dth object!", data->started);
-    newContents->append(data->object_contents, data->object_size);
+    newSize = bench_object_size(data, data->started);
+    newContents->append(data->object_contents, newSize);
     completions[slot]->wait_for_safe();
     dataLock.Lock();
     r = completions[slot]->get_return_value();
@@ -221,6 +297,8 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     }
     data->cur_latency = ceph_clock_now(g_ceph_context) - start_times[slot];
     total_latency += data->cur_latency;
+    data->write_latencies.push_back(data->cur_latency);
+    data->bytes += sizes[slot];
     if( data->cur_latency > data->max_latency) data->max_latency = data->cur_latency;
     if (data->cur_latency < data->min_latency) data->min_latency = data->cur_latency;
     ++data->finished;
@@ -235,7 +313,7 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     //and save locations of new stuff for later deletion
     start_times[slot] = ceph_clock_now(g_ceph_context);
     completions[slot] = rados.aio_create_completion((void *) &cond, 0, &_aio_cb);
-    r = io_ctx.aio_write(newName, completions[slot], *newContents, data->object_size, 0);
+    r = io_ctx.aio_write(newName, completions[slot], *newContents, newSize, 0);
     if (r < 0) {//naughty; doesn't clean up heap space.
       goto ERR;
     }
@@ -247,6 +325,7 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     delete contents[slot];
     name[slot] = newName;
     contents[slot] = newContents;
+    sizes[slot] = newSize;
   }
 
   while (data->finished < data->started) {
@@ -260,6 +339,8 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
     }
     data->cur_latency = ceph_clock_now(g_ceph_context) - start_times[slot];
     total_latency += data->cur_latency;
+    data->write_latencies.push_back(data->cur_latency);
+    data->bytes += sizes[slot];
     if (data->cur_latency > data->max_latency) data->max_latency = data->cur_latency;
     if (data->cur_latency < data->min_latency) data->min_latency = data->cur_latency;
     ++data->finished;
@@ -280,7 +361,7 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
   pthread_join(print_thread, NULL);
 
   double bandwidth;
-  bandwidth = ((double)data->finished)*((double)data->object_size)/(double)timePassed;
+  bandwidth = ((double)data->bytes)/(double)timePassed;
   bandwidth = bandwidth/(1024*1024); // we want it in MB/sec
   char bw[20];
   snprintf(bw, sizeof(bw), "%.3lf \n", bandwidth);
@@ -292,12 +373,14 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
        << "Average Latency:       " << data->avg_latency << std::endl
        << "Max latency:           " << data->max_latency << std::endl
        << "Min latency:           " << data->min_latency << std::endl;
+  bench_report(data, "write", timePassed, concurrentios, opts);
 
   //write object size/number data for read benchmarks
   ::encode(data->object_size, b_write);
   ::encode(data->finished, b_write);
   ::encode(getpid(), b_write);
-  io_ctx.write(BENCH_DATA, b_write, sizeof(int)*3, 0);
+  ::encode(data->min_object_size, b_write);
+  io_ctx.write(BENCH_DATA, b_write, sizeof(int)*4, 0);
   return 0;
 
  ERR:
@@ -309,10 +392,12 @@ int write_bench(librados::Rados& rados, librados::IoCtx& io_ctx,
 }
 
 int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_to_run,
-		   int concurrentios, bench_data *write_data, int pid) {
+		   int concurrentios, bench_data *write_data, int pid,
+		   const bench_opts& opts) {
   bench_data *data = new bench_data();
   data->done = false;
   data->object_size = write_data->object_size;
+  data->min_object_size = write_data->min_object_size;
   data->trans_size = data->object_size;
   data->in_flight= 0;
   data->started = 0;
@@ -402,6 +487,8 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
     }
     data->cur_latency = ceph_clock_now(g_ceph_context) - start_times[slot];
     total_latency += data->cur_latency;
+    data->read_latencies.push_back(data->cur_latency);
+    data->bytes += contents[slot]->length();
     if( data->cur_latency > data->max_latency) data->max_latency = data->cur_latency;
     if (data->cur_latency < data->min_latency) data->min_latency = data->cur_latency;
     ++data->finished;
@@ -425,7 +512,8 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
     ++data->in_flight;
     snprintf(data->object_contents, data->object_size, "I'm the %dth object!", current_index);
     dataLock.Unlock();
-    if (memcmp(data->object_contents, cur_contents->c_str(), data->object_size) != 0) {
+    if ((int)cur_contents->length() != bench_object_size(data, current_index) ||
+	memcmp(data->object_contents, cur_contents->c_str(), cur_contents->length()) != 0) {
       cerr << name[slot] << " is not correct!" << std::endl;
       ++errors;
     }
@@ -447,6 +535,8 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
     }
     data->cur_latency = ceph_clock_now(g_ceph_context) - start_times[slot];
     total_latency += data->cur_latency;
+    data->read_latencies.push_back(data->cur_latency);
+    data->bytes += contents[slot]->length();
     if (data->cur_latency > data->max_latency) data->max_latency = data->cur_latency;
     if (data->cur_latency < data->min_latency) data->min_latency = data->cur_latency;
     ++data->finished;
@@ -456,7 +546,8 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
     completions[slot] = 0;
     snprintf(data->object_contents, data->object_size, "I'm the %dth object!", index[slot]);
     dataLock.Unlock();
-    if (memcmp(data->object_contents, contents[slot]->c_str(), data->object_size) != 0) {
+    if ((int)contents[slot]->length() != bench_object_size(data, index[slot]) ||
+	memcmp(data->object_contents, contents[slot]->c_str(), contents[slot]->length()) != 0) {
       cerr << name[slot] << " is not correct!" << std::endl;
       ++errors;
     }
@@ -472,7 +563,7 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
   pthread_join(print_thread, NULL);
 
   double bandwidth;
-  bandwidth = ((double)data->finished)*((double)data->object_size)/(double)runtime;
+  bandwidth = ((double)data->bytes)/(double)runtime;
   bandwidth = bandwidth/(1024*1024); // we want it in MB/sec
   char bw[20];
   snprintf(bw, sizeof(bw), "%.3lf \n", bandwidth);
@@ -484,6 +575,7 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
        << "Average Latency:       " << data->avg_latency << std::endl
        << "Max latency:           " << data->max_latency << std::endl
        << "Min latency:           " << data->min_latency << std::endl;
+  bench_report(data, "seq", runtime, concurrentios, opts);
 
   delete data;
   return 0;
@@ -497,12 +589,353 @@ int seq_read_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_
 }
 
 
+/*
+ * random reads and/or writes within the objects left by the last write
+ * run.  writes put back the same bytes write_bench wrote, so later seq
+ * and rand runs still verify.  with a target rate we issue open-loop:
+ * ops go out on a fixed schedule and their latency is counted from
+ * when they were due, so a backed-up cluster shows up in the tail
+ * instead of just slowing the offered load.
+ */
+int rand_bench(librados::Rados& rados, librados::IoCtx& io_ctx, int seconds_to_run,
+	       int concurrentios, bench_data *write_data, int pid,
+	       const bench_opts& opts) {
+  bench_data *data = new bench_data();
+  data->object_size = write_data->object_size;
+  data->min_object_size = write_data->min_object_size;
+  data->trans_size = opts.max_op_size ? opts.max_op_size : write_data->trans_size;
+  data->object_contents = write_data->object_contents;
+
+  int num_objects = write_data->finished;
+  if (opts.max_objects && opts.max_objects < num_objects)
+    num_objects = opts.max_objects;
+  if (num_objects <= 0) {
+    cerr << "no objects from a previous write run to work on!" << std::endl;
+    delete data;
+    return -ENOENT;
+  }
+  int max_op = data->trans_size;
+  int min_op = opts.min_op_size ? opts.min_op_size : max_op;
+  if (min_op > max_op)
+    min_op = max_op;
+
+  cout << "Maintaining " << concurrentios << " concurrent ops ("
+       << opts.read_percent << "% reads) of " << min_op;
+  if (min_op < max_op)
+    cout << "-" << max_op;
+  cout << " bytes over " << num_objects << " objects for " << seconds_to_run
+       << " seconds";
+  if (opts.target_rate > 0)
+    cout << " at " << opts.target_rate << " ops/sec";
+  cout << "." << std::endl;
+
+  Cond cond;
+  librados::AioCompletion* completions[concurrentios];
+  bufferlist* contents[concurrentios];
+  bool is_read[concurrentios];
+  int objnums[concurrentios];
+  uint64_t offsets[concurrentios];
+  utime_t start_times[concurrentios];
+  for (int i = 0; i < concurrentios; ++i) {
+    completions[i] = 0;
+    contents[i] = 0;
+  }
+  int errors = 0;
+  double total_latency = 0;
+  int r = 0;
+  int slot;
+  utime_t runtime;
+  utime_t time_to_run;
+  time_to_run.set_from_double(seconds_to_run);
+  utime_t interval;
+  if (opts.target_rate > 0)
+    interval.set_from_double(1.0 / opts.target_rate);
+  srand48(getpid() ^ time(NULL));
+
+  pthread_t print_thread;
+  pthread_create(&print_thread, NULL, status_printer, (void *)data);
+
+  dataLock.Lock();
+  data->start_time = ceph_clock_now(g_ceph_context);
+  dataLock.Unlock();
+  utime_t finish_time = data->start_time + time_to_run;
+  utime_t next_start = data->start_time;
+
+  while (1) {
+    utime_t now = ceph_clock_now(g_ceph_context);
+
+    // reap whatever finished
+    for (slot = 0; slot < concurrentios; ++slot) {
+      if (!completions[slot])
+	continue;
+      if (is_read[slot] ? !completions[slot]->is_complete() : !completions[slot]->is_safe())
+	continue;
+      r = completions[slot]->get_return_value();
+      if (r < 0) {
+	cerr << (is_read[slot] ? "read" : "write") << " got " << r << std::endl;
+	goto ERR;
+      }
+      utime_t lat = ceph_clock_now(g_ceph_context) - start_times[slot];
+      if (is_read[slot]) {
+	bufferlist expect;
+	bench_object_extent(expect, objnums[slot], offsets[slot], contents[slot]->length());
+	if (!contents[slot]->contents_equal(expect)) {
+	  char name[128];
+	  generate_object_name(name, sizeof(name), objnums[slot], pid);
+	  cerr << name << " " << offsets[slot] << "~" << contents[slot]->length()
+	       << " is not correct!" << std::endl;
+	  ++errors;
+	}
+      }
+      dataLock.Lock();
+      data->cur_latency = lat;
+      total_latency += lat;
+      if (is_read[slot])
+	data->read_latencies.push_back(lat);
+      else
+	data->write_latencies.push_back(lat);
+      data->bytes += contents[slot]->length();
+      if (data->cur_latency > data->max_latency) data->max_latency = data->cur_latency;
+      if (data->cur_latency < data->min_latency) data->min_latency = data->cur_latency;
+      ++data->finished;
+      data->avg_latency = total_latency / data->finished;
+      --data->in_flight;
+      dataLock.Unlock();
+      completions[slot]->release();
+      completions[slot] = 0;
+      delete contents[slot];
+      contents[slot] = 0;
+    }
+
+    if (now >= finish_time)
+      break;
+
+    utime_t start = now;
+    if (opts.target_rate > 0) {
+      if (next_start > now) {
+	dataLock.Lock();
+	cond.WaitInterval(g_ceph_context, dataLock, next_start - now);
+	dataLock.Unlock();
+	continue;
+      }
+      start = next_start;
+    }
+
+    for (slot = 0; slot < concurrentios; ++slot)
+      if (!completions[slot])
+	break;
+    if (slot == concurrentios) {
+      // everything is in flight; wait for something to finish
+      dataLock.Lock();
+      while (1) {
+	for (slot = 0; slot < concurrentios; ++slot)
+	  if (is_read[slot] ? completions[slot]->is_complete() : completions[slot]->is_safe())
+	    break;
+	if (slot < concurrentios)
+	  break;
+	cond.Wait(dataLock);
+      }
+      dataLock.Unlock();
+      continue;
+    }
+
+    // pick an object, an extent within it, and read or write
+    int objnum = lrand48() % num_objects;
+    int objsize = bench_object_size(data, objnum);
+    int len = min_op;
+    if (max_op > min_op)
+      len += lrand48() % (max_op - min_op + 1);
+    if (len > objsize)
+      len = objsize;
+    uint64_t off = 0;
+    if (objsize > len) {
+      off = lrand48() % (objsize - len + 1);
+      off -= off % MIN(len, 4096);
+    }
+    char name[128];
+    generate_object_name(name, sizeof(name), objnum, pid);
+
+    if (opts.target_rate > 0) {
+      if (now - next_start > interval)
+	++data->late;
+      next_start += interval;
+    }
+    objnums[slot] = objnum;
+    offsets[slot] = off;
+    start_times[slot] = start;
+    contents[slot] = new bufferlist();
+    is_read[slot] = (lrand48() % 100) < opts.read_percent;
+    if (is_read[slot]) {
+      completions[slot] = rados.aio_create_completion((void *) &cond, &_aio_cb, 0);
+      r = io_ctx.aio_read(name, completions[slot], contents[slot], len, off);
+    } else {
+      bench_object_extent(*contents[slot], objnum, off, len);
+      completions[slot] = rados.aio_create_completion((void *) &cond, 0, &_aio_cb);
+      r = io_ctx.aio_write(name, completions[slot], *contents[slot], len, off);
+    }
+    if (r < 0) {
+      cerr << "r = " << r << std::endl;
+      goto ERR;
+    }
+    dataLock.Lock();
+    ++data->started;
+    ++data->in_flight;
+    dataLock.Unlock();
+  }
+
+  //wait for the rest
+  for (slot = 0; slot < concurrentios; ++slot) {
+    if (!completions[slot])
+      continue;
+    if (is_read[slot])
+      completions[slot]->wait_for_complete();
+    else
+      completions[slot]->wait_for_safe();
+    r = completions[slot]->get_return_value();
+    if (r < 0) {
+      cerr << (is_read[slot] ? "read" : "write") << " got " << r << std::endl;
+      goto ERR;
+    }
+    dataLock.Lock();
+    data->cur_latency = ceph_clock_now(g_ceph_context) - start_times[slot];
+    total_latency += data->cur_latency;
+    if (is_read[slot])
+      data->read_latencies.push_back(data->cur_latency);
+    else
+      data->write_latencies.push_back(data->cur_latency);
+    data->bytes += contents[slot]->length();
+    if (data->cur_latency > data->max_latency) data->max_latency = data->cur_latency;
+    if (data->cur_latency < data->min_latency) data->min_latency = data->cur_latency;
+    ++data->finished;
+    data->avg_latency = total_latency / data->finished;
+    --data->in_flight;
+    dataLock.Unlock();
+    completions[slot]->release();
+    completions[slot] = 0;
+    delete contents[slot];
+    contents[slot] = 0;
+  }
+
+  runtime = ceph_clock_now(g_ceph_context) - data->start_time;
+  dataLock.Lock();
+  data->done = true;
+  dataLock.Unlock();
+
+  pthread_join(print_thread, NULL);
+
+  double bandwidth;
+  bandwidth = ((double)data->bytes)/(double)runtime;
+  bandwidth = bandwidth/(1024*1024); // we want it in MB/sec
+  char bw[20];
+  snprintf(bw, sizeof(bw), "%.3lf \n", bandwidth);
+
+  cout << "Total time run:        " << runtime << std::endl
+       << "Total reads made:      " << data->read_latencies.size() << std::endl
+       << "Total writes made:     " << data->write_latencies.size() << std::endl
+       << "Op size:               " << min_op;
+  if (min_op < max_op)
+    cout << "-" << max_op;
+  cout << std::endl
+       << "Bandwidth (MB/sec):    " << bw << std::endl
+       << "IOPS:                  " << (double)data->finished / (double)runtime << std::endl
+       << "Average Latency:       " << data->avg_latency << std::endl
+       << "Max latency:           " << data->max_latency << std::endl
+       << "Min latency:           " << data->min_latency << std::endl;
+  if (opts.target_rate > 0)
+    cout << "Late ops:              " << data->late << std::endl;
+  if (errors)
+    cout << "Verify errors:         " << errors << std::endl;
+  bench_report(data, "rand", runtime, concurrentios, opts);
+
+  delete data;
+  return 0;
+
+ ERR:
+  dataLock.Lock();
+  data->done = 1;
+  dataLock.Unlock();
+  pthread_join(print_thread, NULL);
+  return -5;
+}
+
+// nearest-rank percentile of a sorted sample
+double bench_percentile(const vector<double>& v, double p)
+{
+  if (v.empty())
+    return 0;
+  size_t i = (size_t)(p * v.size());
+  if (i >= v.size())
+    i = v.size() - 1;
+  return v[i];
+}
+
+void bench_dump_latency(Formatter *f, const char *name, vector<double>& v)
+{
+  sort(v.begin(), v.end());
+  if (!v.empty())
+    cout << name << " latency p50/p99/p99.9/max: "
+	 << bench_percentile(v, .5) << " / "
+	 << bench_percentile(v, .99) << " / "
+	 << bench_percentile(v, .999) << " / "
+	 << v.back() << std::endl;
+  if (!f)
+    return;
+  f->open_object_section(name);
+  f->dump_unsigned("ops", v.size());
+  f->dump_float("p50", bench_percentile(v, .5));
+  f->dump_float("p90", bench_percentile(v, .9));
+  f->dump_float("p99", bench_percentile(v, .99));
+  f->dump_float("p99.9", bench_percentile(v, .999));
+  f->dump_float("max", v.empty() ? 0 : v.back());
+  f->close_section();
+}
+
+/*
+ * latency percentiles for the console, and the whole result as json
+ * for regression tracking if a file was given.
+ */
+void bench_report(bench_data *data, const char *mode, double runtime,
+		  int concurrentios, const bench_opts& opts)
+{
+  JSONFormatter *f = NULL;
+  if (opts.json_file.length()) {
+    f = new JSONFormatter(true);
+    f->open_object_section("bench");
+    f->dump_string("mode", mode);
+    f->dump_int("concurrent_ios", concurrentios);
+    f->dump_int("object_size", data->object_size);
+    f->dump_int("min_object_size", data->min_object_size);
+    f->dump_int("op_size", data->trans_size);
+    f->dump_int("read_percent", opts.read_percent);
+    f->dump_float("target_rate", opts.target_rate);
+    f->dump_float("runtime", runtime);
+    f->dump_unsigned("ops", data->finished);
+    f->dump_unsigned("bytes", data->bytes);
+    f->dump_float("bandwidth_mb_sec", runtime > 0 ? data->bytes / runtime / (1024*1024) : 0);
+    f->dump_float("iops", runtime > 0 ? data->finished / runtime : 0);
+    f->dump_int("late_ops", data->late);
+  }
+  bench_dump_latency(f, "read", data->read_latencies);
+  bench_dump_latency(f, "write", data->write_latencies);
+  if (f) {
+    f->close_section();
+    std::ofstream out(opts.json_file.c_str());
+    if (!out) {
+      cerr << "unable to write " << opts.json_file << std::endl;
+    } else {
+      f->flush(out);
+      out << std::endl;
+    }
+    delete f;
+  }
+}
 
 void *status_printer(void * data_store) {
   bench_data *data = (bench_data *) data_store;
   Cond cond;
   int i = 0;
   int previous_writes = 0;
+  uint64_t previous_bytes = 0;
   int cycleSinceChange = 0;
   double avg_bandwidth;
   double bandwidth;
@@ -526,14 +959,14 @@ void *status_printer(void * data_store) {
 	   << setw(10) << "last lat"
 	   << setw(10) << "avg lat" << std::endl;
     }
-    bandwidth = (double)(data->finished - previous_writes)
-      * (data->trans_size)
+    bandwidth = (double)(data->bytes - previous_bytes)
       / (1024*1024)
       / cycleSinceChange;
-    avg_bandwidth = (double) (data->trans_size) * (data->finished)
+    avg_bandwidth = (double)data->bytes
       / (double)(ceph_clock_now(g_ceph_context) - data->start_time) / (1024*1024);
     if (previous_writes != data->finished) {
       previous_writes = data->finished;
+      previous_bytes = data->bytes;
       cycleSinceChange = 0;
       cout << setfill(' ')
 	   << setw(5) << i
@@ -75,6 +75,7 @@ void usage(ostream& out)
 "   rollback <obj-name> <snap-name>  roll back object to snap <snap-name>\n\n"
 "   bench <seconds> write|seq|rand [-t concurrent_operations]\n"
 "                                    default is 16 concurrent IOs and 4 MB ops\n"
+"                                    rand works on the objects the last write left\n"
 "   load-gen [options]               generate load on the cluster\n"
 "\n"
 "IMPORT AND EXPORT\n"
@@ -116,7 +117,15 @@ STR(DEFAULT_NUM_RADOS_WORKER_THREADS) ")\n"
 "   --max-backlog                    max backlog (in MB)\n"
 "   --percent                        percent of operations that are read\n"
 "   --target-throughput              target throughput (in MB)\n"
-"   --run-length                     total time (in seconds)\n";
+"   --run-length                     total time (in seconds)\n"
+"\n"
+"BENCH OPTIONS:\n"
+"   --min-object-size                write: vary object sizes from here up to -b\n"
+"   --min-op-len, --max-op-len       rand: vary op sizes in this range\n"
+"   --read-percent                   rand: percent of ops that are reads (default 100)\n"
+"   --num-objects                    rand: limit the working set to this many objects\n"
+"   --target-rate                    issue ops open-loop at this many per second\n"
+"   --json-output file               also write results and latency percentiles as json\n";
 
 
 }
@@ -604,6 +613,8 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   int64_t read_percent = -1;
   uint64_t num_objs = 0;
   int run_length = 0;
+  double target_rate = 0;
+  string json_output;
 
   Formatter *formatter = NULL;
   bool pretty_format = false;
@@ -680,6 +691,14 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
   if (i != opts.end()) {
     run_length = strtol(i->second.c_str(), NULL, 10);
   }
+  i = opts.find("target-rate");
+  if (i != opts.end()) {
+    target_rate = strtod(i->second.c_str(), NULL);
+  }
+  i = opts.find("json-output");
+  if (i != opts.end()) {
+    json_output = i->second;
+  }
   i = opts.find("pretty-format");
   if (i != opts.end()) {
     pretty_format = true;
@@ -1218,7 +1237,16 @@ static int rados_tool_common(const std::map < std::string, std::string > &opts,
       operation = OP_RAND_READ;
     else
       usage_exit();
-    ret = aio_bench(rados, io_ctx, operation, seconds, concurrent_ios, op_size);
+    bench_opts bopts;
+    bopts.min_object_size = min_obj_len;
+    bopts.min_op_size = min_op_len;
+    bopts.max_op_size = max_op_len;
+    if (read_percent >= 0)
+      bopts.read_percent = read_percent;
+    bopts.max_objects = num_objs;
+    bopts.target_rate = target_rate;
+    bopts.json_file = json_output;
+    ret = aio_bench(rados, io_ctx, operation, seconds, concurrent_ios, op_size, bopts);
     if (ret != 0)
       cerr << "error during benchmark: " << ret << std::endl;
   }
@@ -1356,6 +1384,10 @@ int main(int argc, const char **argv)
       opts["num-objects"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--run-length", (char*)NULL)) {
       opts["run-length"] = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--target-rate", (char*)NULL)) {
+      opts["target-rate"] = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--json-output", (char*)NULL)) {
+      opts["json-output"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--workers", (char*)NULL)) {
       opts["workers"] = val;
     } else if (ceph_argparse_witharg(args, i, &val, "--format", (char*)NULL)) {
@@ -0,0 +1,189 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+/*
+ * Hammer DBObjectMap with header lookups and small updates from several
+ * threads, on top of KeyValueDBMemory so that what gets measured is the
+ * object map itself.  --db-latency-us adds a sleep to each db read to
+ * stand in for leveldb; --cache-size 0 turns the header cache off.
+ */
+#include <tr1/memory>
+#include <map>
+#include <set>
+#include <iostream>
+#include <unistd.h>
+
+#include "os/IndexManager.h"
+#include "include/buffer.h"
+#include "test/ObjectMap/KeyValueDBMemory.h"
+#include "os/KeyValueDB.h"
+#include "os/DBObjectMap.h"
+#include "os/HashIndex.h"
+#include "global/global_init.h"
+#include "common/ceph_argparse.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+#include "common/Clock.h"
+
+using namespace std;
+
+/// KeyValueDBMemory isn't thread safe; the workload only uses get and submit
+class LockedKeyValueDBMemory : public KeyValueDBMemory {
+  Mutex lock;
+  int latency_us;
+public:
+  uint64_t gets;
+  LockedKeyValueDBMemory(int latency_us)
+    : lock("LockedKeyValueDBMemory::lock"), latency_us(latency_us), gets(0) {}
+
+  int get(const string &prefix, const std::set<string> &key,
+	  std::map<string, bufferlist> *out) {
+    if (latency_us)
+      usleep(latency_us);
+    Mutex::Locker l(lock);
+    gets++;
+    return KeyValueDBMemory::get(prefix, key, out);
+  }
+  int submit_transaction(Transaction t) {
+    Mutex::Locker l(lock);
+    return KeyValueDBMemory::submit_transaction(t);
+  }
+};
+
+struct bench_config {
+  int threads;
+  int objects;
+  int ops;		// per thread
+  int write_percent;
+  unsigned cache_size;
+  int db_latency_us;
+  bench_config()
+    : threads(8), objects(1000), ops(100000), write_percent(20),
+      cache_size(1024), db_latency_us(0) {}
+};
+
+hobject_t bench_oid(int i)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "obj_%d", i);
+  return hobject_t(sobject_t(buf, CEPH_NOSNAP));
+}
+
+class BenchThread : public Thread {
+  ObjectMap *omap;
+  Index index;
+  const bench_config &conf;
+public:
+  BenchThread(ObjectMap *omap, Index index, const bench_config &conf)
+    : omap(omap), index(index), conf(conf) {}
+
+  void *entry() {
+    unsigned seed = (unsigned)pthread_self();
+    bufferlist val;
+    val.append("value");
+    for (int i = 0; i < conf.ops; i++) {
+      hobject_t oid = bench_oid(rand_r(&seed) % conf.objects);
+      if ((int)(rand_r(&seed) % 100) < conf.write_percent) {
+	map<string, bufferlist> to_set;
+	char k[32];
+	snprintf(k, sizeof(k), "key_%d", rand_r(&seed) % 64);
+	to_set[k] = val;
+	omap->set_keys(oid, index, to_set);
+      } else if (rand_r(&seed) % 2) {
+	bufferlist header;
+	omap->get_header(oid, index, &header);
+      } else {
+	set<string> to_get;
+	to_get.insert("_");
+	map<string, bufferlist> got;
+	omap->get_xattrs(oid, index, to_get, &got);
+      }
+    }
+    return 0;
+  }
+};
+
+void usage()
+{
+  cout << "usage: bench_object_map [--threads N] [--objects N] [--ops N per thread]\n"
+       << "                        [--write-percent P] [--cache-size N]\n"
+       << "                        [--db-latency-us US]" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+
+  bench_config conf;
+  for (std::vector<const char*>::iterator i = args.begin(); i != args.end();) {
+    string val;
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "--threads", (char*)NULL)) {
+      conf.threads = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)NULL)) {
+      conf.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--ops", (char*)NULL)) {
+      conf.ops = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--write-percent", (char*)NULL)) {
+      conf.write_percent = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--cache-size", (char*)NULL)) {
+      conf.cache_size = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--db-latency-us", (char*)NULL)) {
+      conf.db_latency_us = atoi(val.c_str());
+    } else {
+      cerr << "unrecognized argument " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (conf.threads < 1 || conf.objects < 1) {
+    usage();
+    return 1;
+  }
+
+  LockedKeyValueDBMemory *store = new LockedKeyValueDBMemory(conf.db_latency_us);
+  DBObjectMap omap(store, conf.cache_size);
+  Index index = Index(new HashIndex(coll_t("bench_coll"),
+				    string("/bench").c_str(),
+				    2,
+				    2,
+				    CollectionIndex::HASH_INDEX_TAG_2));
+
+  // every object gets a header up front so the threads never race to
+  // create one
+  for (int i = 0; i < conf.objects; i++) {
+    map<string, bufferlist> to_set;
+    to_set["key_0"].append("value");
+    omap.set_keys(bench_oid(i), index, to_set);
+  }
+  uint64_t gets_before = store->gets;
+
+  utime_t start = ceph_clock_now(g_ceph_context);
+  vector<BenchThread*> threads;
+  for (int i = 0; i < conf.threads; i++) {
+    threads.push_back(new BenchThread(&omap, index, conf));
+    threads.back()->create();
+  }
+  for (vector<BenchThread*>::iterator p = threads.begin(); p != threads.end(); ++p) {
+    (*p)->join();
+    delete *p;
+  }
+  double elapsed = ceph_clock_now(g_ceph_context) - start;
+
+  uint64_t total = (uint64_t)conf.threads * conf.ops;
+  cout << "threads        " << conf.threads << std::endl
+       << "objects        " << conf.objects << std::endl
+       << "cache size     " << conf.cache_size << std::endl
+       << "ops            " << total << std::endl
+       << "elapsed        " << elapsed << std::endl
+       << "ops/sec        " << (double)total / elapsed << std::endl
+       << "db gets/op     " << (double)(store->gets - gets_before) / total << std::endl;
+  return 0;
+}
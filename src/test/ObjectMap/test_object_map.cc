@@ -777,3 +777,93 @@ TEST_F(ObjectMapTest, RandomTest) {
     }
   }
 }
+
+TEST_F(ObjectMapTest, BatchedUpdates) {
+  hobject_t hoid(sobject_t("foo", CEPH_NOSNAP));
+  hobject_t hoid2(sobject_t("foo2", CEPH_NOSNAP));
+  Index path = Index(new HashIndex(coll_t("foo_coll"),
+				   string("/bar").c_str(),
+				   2,
+				   2,
+				   CollectionIndex::HASH_INDEX_TAG_2));
+  unsigned ops, writes;
+
+  // header created in the batch is found again by later ops in it
+  db->start_batch();
+  set_key(hoid, path, "foo", "bar");
+  set_header(hoid, path, "header");
+  set_xattr(hoid, path, "xattr", "val");
+  set_key(hoid2, path, "foo2", "bar2");
+  ASSERT_EQ(0, db->end_batch(&ops, &writes));
+  ASSERT_EQ(ops, (unsigned)4);
+  ASSERT_EQ(writes, (unsigned)3);  // plus one next_seq update per new header
+
+  string result;
+  ASSERT_EQ(get_key(hoid, path, "foo", &result), 1);
+  ASSERT_EQ(result, "bar");
+  ASSERT_EQ(get_key(hoid2, path, "foo2", &result), 1);
+  ASSERT_EQ(result, "bar2");
+  ASSERT_EQ(get_xattr(hoid, path, "xattr", &result), 1);
+  ASSERT_EQ(result, "val");
+  get_header(hoid, path, &result);
+  ASSERT_EQ(result, "header");
+
+  // reads and clones in the middle see what was batched before them
+  db->start_batch();
+  set_key(hoid, path, "foo", "bar3");
+  ASSERT_EQ(get_key(hoid, path, "foo", &result), 1);
+  ASSERT_EQ(result, "bar3");
+  set_key(hoid, path, "foo3", "bar4");
+  db->clone(hoid, path, hoid2, path);
+  set_key(hoid2, path, "foo4", "bar5");
+  ASSERT_EQ(0, db->end_batch(&ops, &writes));
+  ASSERT_EQ(ops, (unsigned)4);
+  ASSERT_EQ(writes, (unsigned)4);
+
+  ASSERT_EQ(get_key(hoid2, path, "foo", &result), 1);
+  ASSERT_EQ(result, "bar3");
+  ASSERT_EQ(get_key(hoid2, path, "foo3", &result), 1);
+  ASSERT_EQ(result, "bar4");
+  ASSERT_EQ(get_key(hoid2, path, "foo4", &result), 1);
+  ASSERT_EQ(result, "bar5");
+  ASSERT_EQ(get_key(hoid, path, "foo4", &result), 0);
+  db->clear(hoid, path);
+  db->clear(hoid2, path);
+}
+
+TEST_F(ObjectMapTest, HeaderCacheCoherence) {
+  // a tiny cache, so that eviction gets exercised too
+  db.reset(new DBObjectMap(new KeyValueDBMemory(), 2));
+  hobject_t hoid(sobject_t("foo", CEPH_NOSNAP));
+  hobject_t hoid2(sobject_t("foo2", CEPH_NOSNAP));
+  hobject_t hoid3(sobject_t("foo3", CEPH_NOSNAP));
+  Index path = Index(new HashIndex(coll_t("foo_coll"),
+				   string("/bar").c_str(),
+				   2,
+				   2,
+				   CollectionIndex::HASH_INDEX_TAG_2));
+  string result;
+
+  set_key(hoid, path, "foo", "bar");
+  set_key(hoid3, path, "foo", "baz");
+  ASSERT_EQ(get_key(hoid, path, "foo", &result), 1);
+  ASSERT_EQ(get_key(hoid3, path, "foo", &result), 1);
+
+  // clone moves hoid to a new header; the cached one must not be used
+  db->clone(hoid, path, hoid2, path);
+  set_key(hoid, path, "foo", "bar2");
+  ASSERT_EQ(get_key(hoid, path, "foo", &result), 1);
+  ASSERT_EQ(result, "bar2");
+  ASSERT_EQ(get_key(hoid2, path, "foo", &result), 1);
+  ASSERT_EQ(result, "bar");
+
+  // and removal forgets it
+  db->clear(hoid, path);
+  ASSERT_EQ(get_key(hoid, path, "foo", &result), 0);
+  ASSERT_EQ(get_key(hoid2, path, "foo", &result), 1);
+  ASSERT_EQ(result, "bar");
+  ASSERT_EQ(get_key(hoid3, path, "foo", &result), 1);
+  ASSERT_EQ(result, "baz");
+  db->clear(hoid2, path);
+  db->clear(hoid3, path);
+}
@@ -140,6 +140,8 @@ MESSAGE(MAuthReply)
 MESSAGE(MCacheExpire)
 #include "messages/MClientCapRelease.h"
 MESSAGE(MClientCapRelease)
+#include "messages/MClientCapsBatch.h"
+MESSAGE(MClientCapsBatch)
 #include "messages/MClientCaps.h"
 MESSAGE(MClientCaps)
 #include "messages/MClientLease.h"
@@ -306,6 +308,10 @@ MESSAGE(MOSDScrub)
 MESSAGE(MOSDSubOp)
 #include "messages/MOSDSubOpReply.h"
 MESSAGE(MOSDSubOpReply)
+#include "messages/MOSDSubOpReplyBatch.h"
+MESSAGE(MOSDSubOpReplyBatch)
+#include "messages/MOSDSubOpBatch.h"
+MESSAGE(MOSDSubOpBatch)
 #include "messages/MPGStats.h"
 MESSAGE(MPGStats)
 #include "messages/MPGStatsAck.h"
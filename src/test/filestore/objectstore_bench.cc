@@ -0,0 +1,538 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * Copyright (C) 2012 New Dream Network
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ */
+
+/*
+ * ceph_objectstore_bench: run one workload against an ObjectStore
+ * through many Sequencers at once and report throughput, journal
+ * (ondisk) and apply (onreadable) latency percentiles, and how many
+ * read/write syscalls the process made doing it.  the point is to be
+ * able to compare store changes without a cluster in the way.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include "os/FileStore.h"
+#include "common/ceph_argparse.h"
+#include "common/Cond.h"
+#include "global/global_init.h"
+#include "common/debug.h"
+#include "common/errno.h"
+#include "include/ceph_hash.h"
+
+enum {
+  W_OVERWRITE,	// small random overwrites within existing objects
+  W_APPEND,	// appends, like the pg log
+  W_XATTR,	// a handful of xattrs per op
+  W_OMAP,	// a handful of omap keys per op
+  W_CLONE,	// write, then clone to a new snap; trim old clones
+  W_SPLIT,	// collection_move objects between two collections
+};
+
+const char *workload_names[] = {
+  "overwrite", "append", "xattr", "omap", "clone", "split", 0
+};
+
+struct bench_config {
+  string type;
+  int workload;
+  int seconds;
+  int num_sequencers;
+  int queue_depth;	// in flight per sequencer
+  int objects;		// per sequencer
+  uint64_t object_size;
+  uint64_t op_size;
+  int keys_per_op;	// xattr/omap; objects moved per split op
+  int value_size;
+
+  bench_config()
+    : type("filestore"), workload(W_OVERWRITE), seconds(30),
+      num_sequencers(8), queue_depth(8), objects(100),
+      object_size(4 << 20), op_size(4096), keys_per_op(8),
+      value_size(128) {}
+};
+
+struct seq_state {
+  int id;
+  coll_t coll, other;
+  ObjectStore::Sequencer osr;
+  int in_flight;
+  uint64_t append_pos;	// W_APPEND: per-sequencer log offset
+  snapid_t snap;	// W_CLONE
+  vector<snapid_t> last_clone;	// W_CLONE: each object's live clone, or 0
+  vector<hobject_t> here, there;	// W_SPLIT: which side each object is on
+
+  seq_state(int i, const char *c, const char *o)
+    : id(i), coll(c), other(o), osr(c), in_flight(0), append_pos(0),
+      snap(1) {}
+};
+
+class ObjectStoreBench {
+  bench_config conf;
+  ObjectStore *store;
+  vector<seq_state*> seqs;
+
+  Mutex lock;
+  Cond cond;
+  uint64_t ops, bytes;
+  vector<double> commit_lat, apply_lat;
+
+  struct op_state {
+    ObjectStoreBench *bench;
+    seq_state *seq;
+    utime_t start;
+    uint64_t bytes;
+    int pending;
+    op_state(ObjectStoreBench *b, seq_state *s, uint64_t by)
+      : bench(b), seq(s), start(ceph_clock_now(g_ceph_context)),
+	bytes(by), pending(2) {}
+  };
+
+  struct C_OpDone : public Context {
+    op_state *op;
+    bool commit;
+    C_OpDone(op_state *o, bool c) : op(o), commit(c) {}
+    void finish(int r) {
+      op->bench->op_done(op, commit);
+    }
+  };
+
+  void op_done(op_state *op, bool commit) {
+    utime_t lat = ceph_clock_now(g_ceph_context) - op->start;
+    Mutex::Locker l(lock);
+    if (commit)
+      commit_lat.push_back(lat);
+    else
+      apply_lat.push_back(lat);
+    if (--op->pending)
+      return;
+    ops++;
+    bytes += op->bytes;
+    op->seq->in_flight--;
+    cond.Signal();
+    delete op;
+  }
+
+  hobject_t obj_name(seq_state *s, int i) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "bench_%d_%d", s->id, i);
+    object_t oid(buf);
+    return hobject_t(sobject_t(oid, CEPH_NOSNAP), string(), ceph_str_hash_linux(buf, strlen(buf)));
+  }
+
+  void fill(bufferlist& bl, uint64_t len) {
+    bufferptr bp(len);
+    for (uint64_t i = 0; i < len; i++)
+      bp[i] = 'a' + (rand() % 26);
+    bl.append(bp);
+  }
+
+  uint64_t prepare_op(seq_state *s, ObjectStore::Transaction *t);
+
+public:
+  ObjectStoreBench(const bench_config& c)
+    : conf(c), store(NULL), lock("ObjectStoreBench::lock"), ops(0), bytes(0) {}
+  ~ObjectStoreBench() {
+    for (vector<seq_state*>::iterator p = seqs.begin(); p != seqs.end(); ++p)
+      delete *p;
+    delete store;
+  }
+
+  int init();
+  void run();
+  void report(utime_t elapsed, const map<string,uint64_t>& io_before);
+  void shutdown() {
+    store->umount();
+  }
+};
+
+/*
+ * syscr/syscw are the read(2)/write(2)-family syscalls this process
+ * made; add context switches from getrusage so that sync-heavy paths
+ * show up as well.
+ */
+static void get_proc_io(map<string,uint64_t>& m)
+{
+  std::ifstream in("/proc/self/io");
+  string k;
+  uint64_t v;
+  while (in >> k >> v) {
+    if (k.length() && k[k.length() - 1] == ':')
+      k.resize(k.length() - 1);
+    m[k] = v;
+  }
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+    m["voluntary_ctxsw"] = ru.ru_nvcsw;
+    m["involuntary_ctxsw"] = ru.ru_nivcsw;
+  }
+}
+
+static double percentile(const vector<double>& v, double p)
+{
+  if (v.empty())
+    return 0;
+  size_t i = (size_t)(p * v.size());
+  if (i >= v.size())
+    i = v.size() - 1;
+  return v[i];
+}
+
+int ObjectStoreBench::init()
+{
+  if (conf.type != "filestore") {
+    cerr << "unknown objectstore type '" << conf.type << "'" << std::endl;
+    return -EINVAL;
+  }
+  ::mkdir(g_conf->osd_data.c_str(), 0755);
+  store = new FileStore(g_conf->osd_data, g_conf->osd_journal);
+  int r = store->mkfs();
+  if (r < 0) {
+    cerr << "mkfs failed: " << cpp_strerror(r) << std::endl;
+    return r;
+  }
+  r = store->mount();
+  if (r < 0) {
+    cerr << "mount failed: " << cpp_strerror(r) << std::endl;
+    return r;
+  }
+
+  // set up each sequencer's collections and objects, untimed
+  bufferlist data;
+  if (conf.workload == W_OVERWRITE || conf.workload == W_CLONE)
+    fill(data, conf.object_size);
+  for (int i = 0; i < conf.num_sequencers; i++) {
+    char c[32], o[32];
+    snprintf(c, sizeof(c), "0.%x_head", i);
+    snprintf(o, sizeof(o), "0.%x_head", i + conf.num_sequencers);
+    seq_state *s = new seq_state(i, c, o);
+    seqs.push_back(s);
+
+    ObjectStore::Transaction t;
+    t.create_collection(s->coll);
+    if (conf.workload == W_SPLIT)
+      t.create_collection(s->other);
+    store->apply_transaction(t);
+
+    for (int j = 0; j < conf.objects; j++) {
+      ObjectStore::Transaction t;
+      hobject_t oid = obj_name(s, j);
+      if (data.length())
+	t.write(s->coll, oid, 0, data.length(), data);
+      else
+	t.touch(s->coll, oid);
+      store->apply_transaction(t);
+      if (conf.workload == W_SPLIT)
+	s->here.push_back(oid);
+    }
+    if (conf.workload == W_CLONE)
+      s->last_clone.resize(conf.objects);
+  }
+  store->sync();
+  return 0;
+}
+
+uint64_t ObjectStoreBench::prepare_op(seq_state *s, ObjectStore::Transaction *t)
+{
+  int n = rand() % conf.objects;
+  hobject_t oid = obj_name(s, n);
+  uint64_t len = 0;
+
+  switch (conf.workload) {
+  case W_OVERWRITE:
+    {
+      bufferlist bl;
+      fill(bl, conf.op_size);
+      uint64_t off = 0;
+      if (conf.object_size > conf.op_size)
+	off = (rand() % (conf.object_size / conf.op_size)) * conf.op_size;
+      t->write(s->coll, oid, off, bl.length(), bl);
+      len = bl.length();
+    }
+    break;
+
+  case W_APPEND:
+    {
+      bufferlist bl;
+      fill(bl, conf.op_size);
+      oid = obj_name(s, 0);
+      t->write(s->coll, oid, s->append_pos, bl.length(), bl);
+      s->append_pos += bl.length();
+      if (s->append_pos >= conf.object_size) {
+	t->truncate(s->coll, oid, 0);
+	s->append_pos = 0;
+      }
+      len = bl.length();
+    }
+    break;
+
+  case W_XATTR:
+    {
+      map<string,bufferptr> attrs;
+      for (int i = 0; i < conf.keys_per_op; i++) {
+	char k[32];
+	snprintf(k, sizeof(k), "_bench_%d", i);
+	bufferlist bl;
+	fill(bl, conf.value_size);
+	attrs[k] = bufferptr(bl.c_str(), bl.length());
+	len += bl.length();
+      }
+      t->setattrs(s->coll, oid, attrs);
+    }
+    break;
+
+  case W_OMAP:
+    {
+      map<string,bufferlist> keys;
+      for (int i = 0; i < conf.keys_per_op; i++) {
+	char k[32];
+	snprintf(k, sizeof(k), "%08d", rand() % (conf.keys_per_op * 1024));
+	fill(keys[k], conf.value_size);
+	len += conf.value_size;
+      }
+      t->omap_setkeys(s->coll, oid, keys);
+    }
+    break;
+
+  case W_CLONE:
+    {
+      // clone the head to the next snap, then dirty the head, the way
+      // a write after a snapshot does; drop this object's previous
+      // clone so each object keeps at most one
+      bufferlist bl;
+      fill(bl, conf.op_size);
+      if (s->last_clone[n] != snapid_t()) {
+	hobject_t old = oid;
+	old.snap = s->last_clone[n];
+	t->remove(s->coll, old);
+      }
+      hobject_t clone = oid;
+      clone.snap = s->snap;
+      t->clone(s->coll, oid, clone);
+      s->last_clone[n] = s->snap;
+      uint64_t off = 0;
+      if (conf.object_size > conf.op_size)
+	off = (rand() % (conf.object_size / conf.op_size)) * conf.op_size;
+      t->write(s->coll, oid, off, bl.length(), bl);
+      s->snap = s->snap + 1;
+      len = bl.length();
+    }
+    break;
+
+  case W_SPLIT:
+    {
+      // move a batch from one collection to the other, as a pg split
+      // does; swap sides when this one runs dry
+      if (s->here.empty()) {
+	s->here.swap(s->there);
+	coll_t c = s->coll;
+	s->coll = s->other;
+	s->other = c;
+      }
+      for (int i = 0; i < conf.keys_per_op && !s->here.empty(); i++) {
+	t->collection_move(s->other, s->coll, s->here.back());
+	s->there.push_back(s->here.back());
+	s->here.pop_back();
+      }
+    }
+    break;
+  }
+  return len;
+}
+
+void ObjectStoreBench::run()
+{
+  map<string,uint64_t> io_before;
+  get_proc_io(io_before);
+  utime_t start = ceph_clock_now(g_ceph_context);
+  utime_t end = start;
+  end += conf.seconds;
+
+  lock.Lock();
+  while (ceph_clock_now(g_ceph_context) < end) {
+    bool queued = false;
+    for (vector<seq_state*>::iterator p = seqs.begin(); p != seqs.end(); ++p) {
+      seq_state *s = *p;
+      if (s->in_flight >= conf.queue_depth)
+	continue;
+      ObjectStore::Transaction *t = new ObjectStore::Transaction;
+      uint64_t len = prepare_op(s, t);
+      op_state *op = new op_state(this, s, len);
+      s->in_flight++;
+      lock.Unlock();
+      store->queue_transaction(&s->osr, t,
+			       new C_OpDone(op, false),
+			       new C_OpDone(op, true),
+			       new ObjectStore::C_DeleteTransaction(t));
+      lock.Lock();
+      queued = true;
+    }
+    if (!queued)
+      cond.Wait(lock);
+  }
+  for (vector<seq_state*>::iterator p = seqs.begin(); p != seqs.end(); ++p)
+    while ((*p)->in_flight)
+      cond.Wait(lock);
+  lock.Unlock();
+
+  report(ceph_clock_now(g_ceph_context) - start, io_before);
+}
+
+void ObjectStoreBench::report(utime_t elapsed, const map<string,uint64_t>& io_before)
+{
+  map<string,uint64_t> io_after;
+  get_proc_io(io_after);
+
+  double secs = elapsed;
+  cout << "workload        " << workload_names[conf.workload] << std::endl
+       << "sequencers      " << conf.num_sequencers << " x " << conf.queue_depth
+       << " in flight" << std::endl
+       << "elapsed         " << elapsed << std::endl
+       << "ops             " << ops << std::endl
+       << "ops/sec         " << (double)ops / secs << std::endl
+       << "bytes/sec       " << prettybyte_t((double)bytes / secs) << std::endl;
+
+  sort(commit_lat.begin(), commit_lat.end());
+  sort(apply_lat.begin(), apply_lat.end());
+  cout << "latency             p50\tp90\tp99\tp99.9\tmax" << std::endl;
+  cout << "  journal (ondisk)  "
+       << percentile(commit_lat, .5) << "\t" << percentile(commit_lat, .9) << "\t"
+       << percentile(commit_lat, .99) << "\t" << percentile(commit_lat, .999) << "\t"
+       << percentile(commit_lat, 1) << std::endl;
+  cout << "  apply (readable)  "
+       << percentile(apply_lat, .5) << "\t" << percentile(apply_lat, .9) << "\t"
+       << percentile(apply_lat, .99) << "\t" << percentile(apply_lat, .999) << "\t"
+       << percentile(apply_lat, 1) << std::endl;
+
+  const char *counters[] = { "syscr", "syscw", "voluntary_ctxsw", "involuntary_ctxsw", 0 };
+  for (int i = 0; counters[i]; i++) {
+    map<string,uint64_t>::const_iterator a = io_after.find(counters[i]);
+    map<string,uint64_t>::const_iterator b = io_before.find(counters[i]);
+    if (a == io_after.end() || b == io_before.end())
+      continue;
+    uint64_t d = a->second - b->second;
+    cout << counters[i] << "\t" << d;
+    if (ops)
+      cout << "\t(" << (double)d / ops << "/op)";
+    cout << std::endl;
+  }
+}
+
+void usage()
+{
+  cout << "\
+usage: ceph_objectstore_bench [options]\n\
+\n\
+Global Options:\n\
+  -c FILE                     Read configuration from FILE\n\
+  --osd-data PATH             Set OSD Data path\n\
+  --osd-journal PATH          Set OSD Journal path\n\
+  --osd-journal-size VAL      Set Journal size\n\
+  --help                      This message\n\
+\n\
+Bench Options:\n\
+  --type TYPE                 ObjectStore backend (filestore)\n\
+  --workload NAME             overwrite|append|xattr|omap|clone|split\n\
+  --seconds N                 how long to run (30)\n\
+  --sequencers N              number of Sequencers issuing in parallel (8)\n\
+  --queue-depth N             transactions in flight per Sequencer (8)\n\
+  --objects N                 objects per Sequencer (100)\n\
+  --object-size BYTES         object size for overwrite/clone; log size for append (4M)\n\
+  --op-size BYTES             bytes written per op (4096)\n\
+  --keys-per-op N             xattrs/omap keys per op, objects per split op (8)\n\
+  --value-size BYTES          xattr/omap value size (128)\n\
+" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> def_args;
+  vector<const char*> args;
+  def_args.push_back("--osd-journal-size");
+  def_args.push_back("400");
+  def_args.push_back("--osd-data");
+  def_args.push_back("objectstore_bench_dir");
+  def_args.push_back("--osd-journal");
+  def_args.push_back("objectstore_bench_journal");
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  global_init(&def_args, args,
+	      CEPH_ENTITY_TYPE_CLIENT, CODE_ENVIRONMENT_UTILITY, 0);
+  common_init_finish(g_ceph_context);
+  g_ceph_context->_conf->apply_changes(NULL);
+
+  bench_config conf;
+  for (std::vector<const char*>::iterator i = args.begin(); i != args.end();) {
+    string val;
+    if (ceph_argparse_double_dash(args, i)) {
+      break;
+    } else if (ceph_argparse_flag(args, i, "-h", "--help", (char*)NULL)) {
+      usage();
+      return 0;
+    } else if (ceph_argparse_witharg(args, i, &val, "--type", (char*)NULL)) {
+      conf.type = val;
+    } else if (ceph_argparse_witharg(args, i, &val, "--workload", (char*)NULL)) {
+      int w;
+      for (w = 0; workload_names[w]; w++)
+	if (val == workload_names[w])
+	  break;
+      if (!workload_names[w]) {
+	cerr << "unknown workload '" << val << "'" << std::endl;
+	usage();
+	return 1;
+      }
+      conf.workload = w;
+    } else if (ceph_argparse_witharg(args, i, &val, "--seconds", (char*)NULL)) {
+      conf.seconds = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--sequencers", (char*)NULL)) {
+      conf.num_sequencers = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--queue-depth", (char*)NULL)) {
+      conf.queue_depth = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--objects", (char*)NULL)) {
+      conf.objects = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--object-size", (char*)NULL)) {
+      conf.object_size = strtoull(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--op-size", (char*)NULL)) {
+      conf.op_size = strtoull(val.c_str(), NULL, 10);
+    } else if (ceph_argparse_witharg(args, i, &val, "--keys-per-op", (char*)NULL)) {
+      conf.keys_per_op = atoi(val.c_str());
+    } else if (ceph_argparse_witharg(args, i, &val, "--value-size", (char*)NULL)) {
+      conf.value_size = atoi(val.c_str());
+    } else {
+      cerr << "unrecognized argument " << *i << std::endl;
+      usage();
+      return 1;
+    }
+  }
+  if (conf.num_sequencers < 1 || conf.queue_depth < 1 || conf.objects < 1 ||
+      conf.op_size < 1 || conf.object_size < conf.op_size) {
+    cerr << "bad arguments" << std::endl;
+    usage();
+    return 1;
+  }
+
+  ObjectStoreBench bench(conf);
+  int r = bench.init();
+  if (r < 0)
+    return 1;
+  bench.run();
+  bench.shutdown();
+  return 0;
+}
@@ -718,6 +718,224 @@ TEST_F(StoreTest, XattrTest) {
   ASSERT_TRUE(bl2 == attrs["attr3"]);
 }
 
+class C_RecordReadable : public Context {
+public:
+  Mutex *lock;
+  Cond *cond;
+  vector<int> *order;
+  ObjectStore::Transaction *t;
+  int n;
+  C_RecordReadable(Mutex *lock, Cond *cond, vector<int> *order,
+		   ObjectStore::Transaction *t, int n)
+    : lock(lock), cond(cond), order(order), t(t), n(n) {}
+  void finish(int r) {
+    delete t;
+    Mutex::Locker l(*lock);
+    order->push_back(n);
+    cond->Signal();
+  }
+};
+
+TEST_F(StoreTest, ParallelApplyOrder) {
+  coll_t cid("parallel");
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid);
+    r = store->apply_transaction(t);
+    ASSERT_EQ(r, 0);
+  }
+
+  // writes to a handful of objects, interleaved with an occasional
+  // collection attr update, all on one sequencer
+  const int num_objects = 4, num_ops = 200;
+  ObjectStore::Sequencer osr("parallel");
+  Mutex lock("ParallelApplyOrder::lock");
+  Cond cond;
+  vector<int> order;
+  map<int, string> last;
+  for (int i = 0; i < num_ops; ++i) {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "obj_%d", i % num_objects);
+    hobject_t hoid(sobject_t(buf, CEPH_NOSNAP));
+    snprintf(buf, sizeof(buf), "%08d", i);
+    bufferlist bl;
+    bl.append(buf);
+    last[i % num_objects] = buf;
+
+    ObjectStore::Transaction *t = new ObjectStore::Transaction;
+    t->write(cid, hoid, 0, bl.length(), bl);
+    if (i % 50 == 49)
+      t->collection_setattr(cid, "last", bl);
+    store->queue_transaction(&osr, t,
+			     new C_RecordReadable(&lock, &cond, &order, t, i));
+  }
+  {
+    Mutex::Locker l(lock);
+    while ((int)order.size() < num_ops)
+      cond.Wait(lock);
+  }
+
+  // readable callbacks fire in submission order...
+  for (int i = 0; i < num_ops; ++i)
+    ASSERT_EQ(i, order[i]);
+
+  // ...and each object holds its last write
+  for (int i = 0; i < num_objects; ++i) {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "obj_%d", i);
+    hobject_t hoid(sobject_t(buf, CEPH_NOSNAP));
+    bufferlist bl;
+    r = store->read(cid, hoid, 0, 8, bl);
+    ASSERT_EQ(r, 8);
+    ASSERT_EQ(last[i], string(bl.c_str(), bl.length()));
+  }
+}
+
+TEST_F(StoreTest, ReadvTest) {
+  coll_t cid("readv");
+  hobject_t hoid(sobject_t("readv_obj", CEPH_NOSNAP));
+  int r;
+
+  // three 4k extents, the first two close together, the third far off
+  bufferlist a, b, c;
+  a.append(string(4096, 'a'));
+  b.append(string(4096, 'b'));
+  c.append(string(4096, 'c'));
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid);
+    t.write(cid, hoid, 0, a.length(), a);
+    t.write(cid, hoid, 16384, b.length(), b);
+    t.write(cid, hoid, 8 << 20, c.length(), c);
+    r = store->apply_transaction(t);
+    ASSERT_EQ(r, 0);
+  }
+
+  map<uint64_t, uint64_t> extents;
+  extents[0] = 4096;
+  extents[16384] = 4096;
+  extents[8 << 20] = 8192;   // runs past eof
+  bufferlist bl;
+  r = store->readv(cid, hoid, extents, bl);
+  ASSERT_EQ(3 * 4096, r);
+  ASSERT_EQ(3u, extents.size());
+  ASSERT_EQ(4096u, extents[8 << 20]);
+
+  bufferlist expected;
+  expected.append(a);
+  expected.append(b);
+  expected.append(c);
+  ASSERT_TRUE(expected == bl);
+}
+
+// what an osd write looks like: the object, then the pg log append and
+// the "ondisklog" collection attr (see PG::append_log)
+static ObjectStore::Transaction *osd_write(coll_t cid, const hobject_t& hoid,
+					   coll_t meta, const hobject_t& log,
+					   uint64_t log_off, bufferlist& bl)
+{
+  ObjectStore::Transaction *t = new ObjectStore::Transaction;
+  t->write(cid, hoid, 0, bl.length(), bl);
+  t->write(meta, log, log_off, bl.length(), bl);
+  bufferlist head;
+  ::encode(log_off + bl.length(), head);
+  t->collection_setattr(cid, "ondisklog", head);
+  return t;
+}
+
+TEST(ObjectStoreTransaction, GetObjects) {
+  coll_t cid("0.0_head"), other("0.1_head"), meta("meta");
+  hobject_t a(sobject_t("a", CEPH_NOSNAP)), b(sobject_t("b", CEPH_NOSNAP));
+  hobject_t log(sobject_t("pglog_0.0", 0));
+  bufferlist bl;
+  bl.append("data");
+
+  // an osd write is not a barrier: its log and attr updates are ordered
+  // keys, and only its data object conflicts with other ops
+  ObjectStore::Transaction *t = osd_write(cid, a, meta, log, 0, bl);
+  set<hobject_t> objects;
+  set<pair<coll_t, hobject_t> > ordered;
+  int first;
+  ASSERT_TRUE(t->get_objects(&objects, &ordered, &first));
+  ASSERT_EQ(1u, objects.size());
+  ASSERT_EQ(1u, objects.count(a));
+  ASSERT_EQ(2u, ordered.size());
+  ASSERT_EQ(1u, ordered.count(make_pair(meta, log)));
+  ASSERT_EQ(1u, ordered.count(make_pair(cid, hobject_t())));
+  ASSERT_EQ(1, first);
+  delete t;
+
+  // a collection_add aliases the object across collections
+  ObjectStore::Transaction add;
+  add.collection_add(other, cid, b);
+  objects.clear();
+  ordered.clear();
+  ASSERT_TRUE(add.get_objects(&objects, &ordered, &first));
+  ASSERT_EQ(1u, objects.size());
+  ASSERT_EQ(1u, objects.count(b));
+  ASSERT_EQ(-1, first);
+
+  ObjectStore::Transaction mk;
+  mk.create_collection(other);
+  ASSERT_FALSE(mk.get_objects(&objects, &ordered, &first));
+}
+
+TEST_F(StoreTest, ParallelApplyOsdWrites) {
+  coll_t cid("0.0_head"), meta("meta");
+  hobject_t log(sobject_t("pglog_0.0", 0));
+  int r;
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid);
+    t.create_collection(meta);
+    t.touch(meta, log);
+    r = store->apply_transaction(t);
+    ASSERT_EQ(r, 0);
+  }
+
+  // one pg: every op writes its own object and appends to the shared log
+  const int num_ops = 200;
+  ObjectStore::Sequencer osr("osd_writes");
+  Mutex lock("ParallelApplyOsdWrites::lock");
+  Cond cond;
+  vector<int> order;
+  string expected;
+  for (int i = 0; i < num_ops; ++i) {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "obj_%d", i);
+    hobject_t hoid(sobject_t(buf, CEPH_NOSNAP));
+    snprintf(buf, sizeof(buf), "%08d", i);
+    bufferlist bl;
+    bl.append(buf);
+    ObjectStore::Transaction *t = osd_write(cid, hoid, meta, log,
+					    expected.length(), bl);
+    expected += buf;
+    store->queue_transaction(&osr, t,
+			     new C_RecordReadable(&lock, &cond, &order, t, i));
+  }
+  {
+    Mutex::Locker l(lock);
+    while ((int)order.size() < num_ops)
+      cond.Wait(lock);
+  }
+  for (int i = 0; i < num_ops; ++i)
+    ASSERT_EQ(i, order[i]);
+
+  // the log and its bounds match a one-at-a-time apply
+  bufferlist bl;
+  r = store->read(meta, log, 0, expected.length(), bl);
+  ASSERT_EQ((int)expected.length(), r);
+  ASSERT_EQ(expected, string(bl.c_str(), bl.length()));
+  bufferlist head;
+  r = store->collection_getattr(cid, "ondisklog", head);
+  ASSERT_GT(r, 0);
+  uint64_t h;
+  bufferlist::iterator p = head.begin();
+  ::decode(h, p);
+  ASSERT_EQ(expected.length(), h);
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
@@ -608,6 +608,41 @@ TEST(LibRadosAio, FlushPP) {
   delete my_completion2;
 }
 
+// a callback that waits on another aio to the same object must not
+// block the thread that completes it
+void write_and_wait_safe(rados_completion_t cb, void *arg)
+{
+  AioTestData *test = (AioTestData*)arg;
+  rados_completion_t c;
+  char buf[128];
+  memset(buf, 0xdd, sizeof(buf));
+  if (rados_aio_create_completion(NULL, NULL, NULL, &c) == 0) {
+    if (rados_aio_write(test->m_ioctx, "foo", c, buf, sizeof(buf), 0) == 0 &&
+	rados_aio_wait_for_safe(c) == 0)
+      test->m_complete = true;
+    rados_aio_release(c);
+  }
+  sem_post(&test->m_sem);
+}
+
+TEST(LibRadosAio, WaitInCallback) {
+  AioTestData test_data;
+  rados_completion_t my_completion;
+  ASSERT_EQ("", test_data.init());
+  ASSERT_EQ(0, rados_aio_create_completion((void*)&test_data,
+	      write_and_wait_safe, NULL, &my_completion));
+  char buf[128];
+  memset(buf, 0xcc, sizeof(buf));
+  ASSERT_EQ(0, rados_aio_write(test_data.m_ioctx, "foo",
+			       my_completion, buf, sizeof(buf), 0));
+  {
+    TestAlarm alarm;
+    sem_wait(&test_data.m_sem);
+  }
+  ASSERT_TRUE(test_data.m_complete);
+  rados_aio_release(my_completion);
+}
+
 TEST(LibRadosAio, RoundTripWriteFull) {
   AioTestData test_data;
   rados_completion_t my_completion, my_completion2, my_completion3;
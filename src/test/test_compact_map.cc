@@ -0,0 +1,114 @@
+#include "include/types.h"
+#include "include/compact_map.h"
+#include "include/compact_set.h"
+
+#include "gtest/gtest.h"
+
+TEST(CompactMap, Empty)
+{
+  compact_map<int,int> m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(0u, m.size());
+  ASSERT_EQ(0u, m.count(1));
+  ASSERT_TRUE(m.begin() == m.end());
+  ASSERT_TRUE(m.find(1) == m.end());
+  ASSERT_TRUE(m.lower_bound(1) == m.end());
+  ASSERT_EQ(0u, m.erase(1));
+}
+
+TEST(CompactMap, InsertErase)
+{
+  compact_map<int,int> m;
+  m[3] = 30;
+  m.insert(std::make_pair(1, 10));
+  m[2] = 20;
+  ASSERT_EQ(3u, m.size());
+  ASSERT_EQ(1, m.begin()->first);
+  ASSERT_EQ(3, m.rbegin()->first);
+  ASSERT_EQ(20, m.find(2)->second);
+  ASSERT_EQ(3, m.upper_bound(2)->first);
+
+  // erasing while iterating must not invalidate the iterator
+  compact_map<int,int>::iterator p = m.begin();
+  while (p != m.end())
+    m.erase(p++);
+  ASSERT_TRUE(m.empty());
+
+  m[5] = 50;
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_TRUE(m.begin() == m.end());
+}
+
+TEST(CompactMap, CopySwap)
+{
+  compact_map<int,int> a, b;
+  a[1] = 1;
+  b = a;
+  a[2] = 2;
+  ASSERT_EQ(1u, b.size());
+  ASSERT_EQ(2u, a.size());
+
+  std::map<int,int> s;
+  s[7] = 7;
+  b.swap(s);
+  ASSERT_EQ(1u, s.size());
+  ASSERT_EQ(1, s.begin()->first);
+  ASSERT_EQ(7, b.begin()->first);
+
+  a.swap(b);
+  ASSERT_EQ(1u, a.size());
+  ASSERT_EQ(2u, b.size());
+
+  compact_map<int,int> c(a);
+  ASSERT_EQ(a.get(), c.get());
+}
+
+TEST(CompactMap, Encode)
+{
+  compact_map<int,int> m;
+  m[1] = 2;
+  m[3] = 4;
+  std::map<int,int> s = m;
+
+  // same wire format as std::map
+  bufferlist mbl, sbl;
+  ::encode(m, mbl);
+  ::encode(s, sbl);
+  ASSERT_TRUE(mbl.contents_equal(sbl));
+
+  compact_map<int,int> d;
+  bufferlist::iterator p = sbl.begin();
+  ::decode(d, p);
+  ASSERT_EQ(s, d.get());
+
+  compact_map<int,int> e;
+  bufferlist ebl;
+  ::encode(e, ebl);
+  p = ebl.begin();
+  ::decode(d, p);
+  ASSERT_TRUE(d.empty());
+}
+
+TEST(CompactSet, Basic)
+{
+  compact_set<int> s;
+  ASSERT_TRUE(s.empty());
+  ASSERT_TRUE(s.begin() == s.end());
+  s.insert(2);
+  s.insert(1);
+  ASSERT_EQ(2u, s.size());
+  ASSERT_EQ(1, *s.begin());
+  ASSERT_EQ(1u, s.erase(1));
+  ASSERT_EQ(0u, s.count(1));
+
+  bufferlist bl;
+  ::encode(s, bl);
+  std::set<int> t;
+  bufferlist::iterator p = bl.begin();
+  ::decode(t, p);
+  ASSERT_EQ(s.get(), t);
+
+  s.clear();
+  ASSERT_TRUE(s.empty());
+}
@@ -0,0 +1,82 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+#include "include/types.h"
+#include "osd/OSDMap.h"
+#include "global/global_context.h"
+
+#include "test/unit.h"
+
+static void build_map(OSDMap& m, int num_osd)
+{
+  uuid_d fsid;
+  m.build_simple(g_ceph_context, 1, fsid, num_osd, 6, 6, 0);
+  OSDMap::Incremental inc(m.get_epoch() + 1);
+  inc.fsid = m.get_fsid();
+  for (int i = 0; i < num_osd; i++) {
+    entity_addr_t a;
+    a.set_nonce(i + 1);
+    inc.new_up_client[i] = a;
+    inc.new_weight[i] = CEPH_OSD_IN;
+  }
+  m.apply_incremental(inc);
+}
+
+TEST(OSDMap, CopyOnWrite)
+{
+  OSDMap a;
+  build_map(a, 4);
+
+  OSDMap b(a);
+  OSDMap::Incremental inc(b.get_epoch() + 1);
+  inc.fsid = b.get_fsid();
+  entity_addr_t moved;
+  moved.set_nonce(100);
+  inc.new_up_internal[2] = moved;
+  inc.new_pg_temp[pg_t(0, 0, -1)].push_back(3);
+  b.apply_incremental(inc);
+
+  // the source epoch is unchanged
+  ASSERT_EQ(a.get_addr(2), a.get_cluster_addr(2));
+  ASSERT_EQ(moved, b.get_cluster_addr(2));
+  vector<int> up, acting;
+  a.pg_to_up_acting_osds(pg_t(0, 0, -1), up, acting);
+  ASSERT_EQ(up, acting);
+  b.pg_to_acting_osds(pg_t(0, 0, -1), acting);
+  ASSERT_EQ(1u, acting.size());
+  ASSERT_EQ(3, acting[0]);
+
+  // nothing touched crush
+  ASSERT_EQ(a.crush.get(), b.crush.get());
+}
+
+TEST(OSDMap, DedupEncoding)
+{
+  OSDMap a;
+  build_map(a, 4);
+
+  bufferlist abl;
+  a.encode(abl);
+
+  OSDMap::Incremental inc(a.get_epoch() + 1);
+  inc.fsid = a.get_fsid();
+  inc.new_weight[1] = CEPH_OSD_OUT;
+  OSDMap *b = new OSDMap;
+  b->decode(abl);
+  b->apply_incremental(inc);
+
+  bufferlist before;
+  b->encode(before);
+  ASSERT_NE(a.crush.get(), b->crush.get());
+  OSDMap::dedup(&a, b);
+  ASSERT_EQ(a.crush.get(), b->crush.get());
+  bufferlist after;
+  b->encode(after);
+  ASSERT_TRUE(before.contents_equal(after));
+
+  delete b;
+
+  // a still encodes the same after b is gone
+  bufferlist abl2;
+  a.encode(abl2);
+  ASSERT_TRUE(abl.contents_equal(abl2));
+}